@@ -10,6 +10,8 @@
 
 #include <stdint.h>
 
+#include "config.h"
+
 #define FLAG_NUMERICAL  "--numerical"
 #define FLAG_NUMERICAL_TETRA  "--numerical-tetra"
 #define FLAG_SUBSTRATE  "--substrate"
@@ -20,17 +22,43 @@
 #define FLAG_TEMP       "--temp"
 #define FLAG_PRESSURE   "--pressure"
 #define FLAG_DENSITY    "--density"
+#define FLAG_SOLVENT_DENSITY "--solvent_density"
 #define FLAG_FRAMESKIP  "--frameskip"
 #define FLAG_REDUCEPOT  "--reduce_potential"
+#define FLAG_SOFTCORE   "--softcore"
+#define FLAG_RIGID      "--rigid"
+#define FLAG_PARALLEL_COARSE "--parallel_coarse"
 #define FLAG_SOLVENT    "--solvent"
 #define FLAG_MODEL      "--model"
 #define FLAG_SRAND_SEED "--srand"
+#define FLAG_CACHE      "--cache"
+#define FLAG_LANGEVIN   "--langevin"
+#define FLAG_NOSE_HOOVER "--nose_hoover"
+#define FLAG_BERENDSEN  "--berendsen"
+#define FLAG_RESPA      "--respa"
+#define FLAG_SHAKE      "--shake"
+#define FLAG_SETTLE     "--settle"
+#define FLAG_HMR        "--hmr"
+#define FLAG_ADAPTIVE   "--adaptive"
+#define FLAG_WATCHDOG   "--watchdog"
+#define FLAG_ROLLBACK   "--rollback"
+#define FLAG_DOUBLE     "--double"
+#define FLAG_PRECISION  "--precision"
+#define FLAG_ASYNC      "--async"
+#define FLAG_CHECKPOINT "--checkpoint"
+#define FLAG_CHECKPOINT_INTERVAL "--checkpoint_interval"
+#define FLAG_RESTART    "--restart"
+#define FLAG_RESUME     "--resume"
+#define FLAG_MAX_WALLTIME "--max_walltime"
+#define FLAG_LIVE       "--live"
+#define FLAG_STREAM     "--stream"
 
 /* t_args */
 #define ARGS_PATH_SUBSTRATE_DEFAULT    ((char*)NULL)      /* Path to the MDS substrate file */
 #define ARGS_PATH_OUT_DEFAULT          ((char*)NULL)      /* Path to the XYZ output file */
 #define ARGS_PATH_SOLVENT_DEFAULT      ((char*)NULL)      /* Path to the MDS solvent file */
 #define ARGS_PATH_MODEL_DEFAULT        ((char*)NULL)      /* Path to the MDM model file */
+#define ARGS_PATH_CACHE_DEFAULT        ((char*)NULL)      /* Path to the reduced universe cache directory */
 #define ARGS_NUMERICAL_DEFAULT         MODE_ANALYTICAL    /* MODE_ANALYTICAL | MODE_NUMERICAL */
 #define ARGS_TIMESTEP_DEFAULT          ((double)1E0)      /* Timestep for the numerical integration (fs) */
 #define ARGS_MAX_TIME_DEFAULT          ((double)1E0)      /* Time until the simulation ends (ns) */
@@ -38,8 +66,32 @@
 #define ARGS_COPIES_DEFAULT            ((uint64_t)1E0)    /* Unitless. Nb of substrates to simulate */
 #define ARGS_PRESSURE_DEFAULT          ((double)1E0)      /* Pressure (hPa) */
 #define ARGS_DENSITY_DEFAULT           ((double)1E0)      /* Density (g.cm-3) */
+#define ARGS_SOLVENT_DENSITY_DEFAULT   ((double)1E0)      /* Solvent density (g.cm-3) */
 #define ARGS_FRAMESKIP_DEFAULT         ((uint64_t)0)      /* Frames to skip (= render but not save) */
 #define ARGS_REDUCE_POTENTIAL_DEFAULT  ((double)1E1)      /* Pre-simulation target potential energy */
+#define ARGS_SOFTCORE_DEFAULT          ((uint8_t)0)       /* Soft-core warm-up before potential reduction */
+#define ARGS_RIGID_DEFAULT             ((uint8_t)0)       /* Rigid molecule stage before potential reduction */
+#define ARGS_PARALLEL_COARSE_DEFAULT   ((uint8_t)0)       /* Wiggle the atoms in parallel */
+#define ARGS_LANGEVIN_DEFAULT          ((double)0.0)      /* Langevin friction (ps-1), 0 for Velocity-Verlet */
+#define ARGS_NOSE_HOOVER_DEFAULT       ((double)0.0)      /* Nose-Hoover chain time constant (ps), 0 to disable */
+#define ARGS_BERENDSEN_DEFAULT         ((double)0.0)      /* Berendsen barostat time constant (ps), 0 to disable */
+#define ARGS_RESPA_DEFAULT             ((uint64_t)1)      /* Steps between nonbonded force updates (r-RESPA) */
+#define ARGS_SHAKE_DEFAULT             ((uint8_t)0)       /* Hold the bonds to hydrogens with SHAKE/RATTLE */
+#define ARGS_SETTLE_DEFAULT            ((uint8_t)0)       /* Hold the waters rigid with SETTLE */
+#define ARGS_HMR_DEFAULT               ((double)0.0)      /* Hydrogen mass after repartitioning (u), 0 to disable */
+#define ARGS_ADAPTIVE_DEFAULT          ((double)0.0)      /* Largest displacement per step (Å), 0 for a fixed timestep */
+#define ARGS_WATCHDOG_DEFAULT          ((uint64_t)0)      /* Steps between two samples of the watchdog, 0 to disable */
+#define ARGS_ROLLBACK_DEFAULT          ((uint8_t)0)       /* Roll back and halve the timestep instead of stopping */
+#define ARGS_DOUBLE_DEFAULT            ((uint8_t)0)       /* Save the binary trajectory in double precision */
+#define ARGS_PRECISION_DEFAULT         ((double)1E-3)     /* Precision of the compressed trajectory (Å) */
+#define ARGS_ASYNC_DEFAULT             ((uint8_t)0)       /* Save the frames from a thread of their own */
+#define ARGS_PATH_CHECKPOINT_DEFAULT   ((char*)NULL)      /* Path to the checkpoint file, NULL to disable */
+#define ARGS_CHECKPOINT_INTERVAL_DEFAULT ((uint64_t)1E4)  /* Steps between two checkpoints */
+#define ARGS_PATH_RESTART_DEFAULT      ((char*)NULL)      /* Path to the checkpoint to restart from, NULL to start anew */
+#define ARGS_RESUME_DEFAULT            ((uint8_t)0)       /* Restart from the checkpoint file, if there is one */
+#define ARGS_MAX_WALLTIME_DEFAULT      ((double)0.0)      /* Wall-clock time after which the simulation stops (s), 0 to disable */
+#define ARGS_STREAM_NB_DEFAULT         ((uint64_t)0)      /* Number of output streams */
+#define ARGS_PATH_LIVE_DEFAULT         ((char*)NULL)      /* Name of the shared memory object the frames are published to, NULL to disable */
 #define ARGS_SRAND_SEED_DEFAULT        ((unsigned int)time(NULL))  /* Seed for SRAND */
 
 typedef struct args_s args_t;
@@ -50,11 +102,36 @@ struct args_s
   char *path_out;            /* Path to output file */
   char *path_solvent;        /* Path to solvent file */
   char *path_model;          /* Path to the model file */
+  char *path_cache;          /* Path to the reduced universe cache directory */
   double timestep;           /* (s)        Simulation timestep */
   double max_time;           /* (s)        Simulation duration */
   double reduce_potential;   /* (pJ)       Maximum potential energy before simulating */
   uint64_t frameskip;        /* (unitless) Frameskip */
   uint8_t numerical;         /* (unitless) Force computation mode */
+  uint8_t softcore;          /* (unitless) Warm up with soft-core potentials before reducing the potential */
+  uint8_t rigid;             /* (unitless) Move whole molecules before reducing the potential atom by atom */
+  uint8_t parallel_coarse;   /* (unitless) Wiggle spatially independent atoms concurrently */
+  double langevin;           /* (s-1)      Langevin friction coefficient, 0 for Velocity-Verlet */
+  double nose_hoover;        /* (s)        Nose-Hoover chain time constant, 0 to disable */
+  double berendsen;          /* (s)        Berendsen barostat time constant, 0 to disable */
+  uint64_t respa;            /* (unitless) Steps between nonbonded force updates, 1 to disable r-RESPA */
+  uint8_t shake;             /* (unitless) Hold the bonds to hydrogens with SHAKE/RATTLE */
+  uint8_t settle;            /* (unitless) Hold the waters rigid with SETTLE */
+  double hmr;                /* (kg)       Hydrogen mass after repartitioning, 0 to disable */
+  double adaptive;           /* (m)        Largest displacement per step with an adaptive timestep, 0 to disable */
+  uint64_t watchdog;         /* (unitless) Steps between two samples of the watchdog, 0 to disable */
+  uint8_t rollback;          /* (unitless) Roll back to the last good sample when the watchdog goes off */
+  uint8_t traj_double;       /* (unitless) Save the binary trajectory in double precision */
+  double precision;          /* (m)        Precision of the compressed trajectory */
+  uint8_t async;             /* (unitless) Save the frames from a thread of their own */
+  char *path_checkpoint;     /* Path to the checkpoint file */
+  uint64_t checkpoint_interval; /* (unitless) Steps between two checkpoints */
+  char *path_restart;        /* Path to the checkpoint to restart from */
+  uint8_t resume;            /* (unitless) Restart from the checkpoint file, if there is one */
+  double max_walltime;       /* (s)        Wall-clock time after which the simulation stops, 0 to disable */
+  char *path_live;           /* Name of the shared memory object the frames are published to */
+  uint64_t stream_nb;        /* (unitless) Number of output streams */
+  char *stream[STREAM_NB_MAX]; /* Description of each output stream, as given */
   uint64_t srand_seed;        /* (unitless) Seed to give to srand for setting RNG seed */
 
   /* Chemical properties, thermodynamics */
@@ -62,6 +139,7 @@ struct args_s
   double temperature;        /* (K)        Universe thermodynamic temperature */
   double pressure;           /* (hPa)      Universe pressure */
   double density;            /* (g.cm-3)   Universe density */
+  double solvent_density;    /* (g.cm-3)   Density of the solvent filling the universe */
 };
 
 args_t *args_init(args_t *args);
@@ -0,0 +1,50 @@
+/*
+ * cell.h
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#ifndef CELL_H
+#define CELL_H
+
+#include <stdint.h>
+
+#include "universe.h"
+#include "vec3.h"
+
+/*
+ * A cell grid splits the (cubic, periodic) universe into cell_nb^3 cubic
+ * cells. Atoms are binned into the cells as linked lists (head/next), so that
+ * finding the neighbours of a point only requires scanning the 27 cells
+ * surrounding it instead of the whole universe.
+ *
+ */
+
+/* cell_grid_t */
+#define CELL_GRID_EMPTY             ((uint64_t) UINT64_MAX)
+#define CELL_GRID_CELL_NB_DEFAULT   ((uint64_t) 0)
+#define CELL_GRID_CELL_SIZE_DEFAULT ((double)   0.0)
+#define CELL_GRID_SIZE_DEFAULT      ((double)   0.0)
+#define CELL_GRID_HEAD_DEFAULT      ((uint64_t*) NULL)
+#define CELL_GRID_NEXT_DEFAULT      ((uint64_t*) NULL)
+#define CELL_GRID_ATOM_NB_DEFAULT   ((uint64_t) 0)
+
+typedef struct cell_grid_s cell_grid_t;
+struct cell_grid_s
+{
+  uint64_t cell_nb;  /* Number of cells along each side of the universe */
+  double cell_size;  /* (m) Length of a cell's side */
+  double size;       /* (m) Length of the universe's side */
+  uint64_t atom_nb;  /* Number of binned atoms */
+  uint64_t *head;    /* First atom in each cell (CELL_GRID_EMPTY if none) */
+  uint64_t *next;    /* Next atom in the same cell (CELL_GRID_EMPTY if last) */
+};
+
+cell_grid_t *cell_grid_init(cell_grid_t *grid, const double size, const double min_cell_size);
+cell_grid_t *cell_grid_fill(cell_grid_t *grid, const atom_t *atom, const uint64_t atom_nb);
+void         cell_grid_clean(cell_grid_t *grid);
+void         cell_grid_coord(const cell_grid_t *grid, const vec3_t *pos, uint64_t *cx, uint64_t *cy, uint64_t *cz);
+uint64_t     cell_grid_index(const cell_grid_t *grid, const uint64_t cx, const uint64_t cy, const uint64_t cz);
+
+#endif
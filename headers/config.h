@@ -39,6 +39,7 @@
  *   C_COULOMB:    Coulomb constant
  *   C_ELEMCHARGE: Elementary charge
  *   C_AHO:        Angular Harmonic Oscillator - used for torsion computations
+ *   C_DALTON:     Unified atomic mass unit
  */
  #define C_BOLTZMANN  ((double)1.380649E-23)
  #define C_AVOGADRO   ((double)6.02214076E23)
@@ -47,6 +48,7 @@
  #define C_COULOMB    ((double)8.98755E9)
  #define C_ELEMCHARGE ((double)1.60217646E-19)
  #define C_AHO        ((double)5E-18)
+ #define C_DALTON     ((double)1.66053906660E-27)
 
 /* UNIVERSE GENERATION
  *
@@ -54,8 +56,19 @@
  * through the universe. This generation mechanism can be tuned here.
  *  UNIVERSE_POPULATE_MIN_DIST: Fraction of the universe size. Particles cannot
  *                              be inserted this close or closer from the origin
+ *
+ * Once the substrate copies are inserted, the remaining volume is filled with
+ * copies of the solvent laid out on a cubic lattice. Solvent molecules
+ * overlapping the substrate are discarded.
+ *  UNIVERSE_SOLVATE_OVERLAP_FACTOR: Two atoms overlap if they are closer than
+ *                                   this fraction of the sum of their Van der
+ *                                   Waals radii
+ *  CELL_GRID_MAX_CELL_NB: Maximum number of cells along each side of the
+ *                         universe when binning atoms into a cell grid
  */
-#define UNIVERSE_POPULATE_MIN_DIST ((double)4E-1)
+#define UNIVERSE_POPULATE_MIN_DIST      ((double)4E-1)
+#define UNIVERSE_SOLVATE_OVERLAP_FACTOR ((double)8E-1)
+#define CELL_GRID_MAX_CELL_NB           ((uint64_t)128)
 
 /* SIMULATION MODE
  *
@@ -105,6 +118,10 @@
  *                                           magnitude.
  *   UNIVERSE_REDUCEPOT_COARSE_MAGNITUDE_MULTIPLIER: Reduce the magnitude by
  *                                                   multiplying it.
+ * With --parallel_coarse, atoms far enough from each other are wiggled
+ * concurrently, each move being judged on the potential felt by the moving atom
+ * alone. The start magnitude is then limited by the room left between them.
+ *   UNIVERSE_REDUCEPOT_COARSE_PARALLEL_MIN_STEP: Smallest start magnitude
  *
  * STAGE 2: FINE (fine)
  * The second stage consists of tuning the coordinates of each atom so as to
@@ -117,13 +134,249 @@
  *   UNIVERSE_REDUCEPOT_CUTOFF: If a step decreases the potential energy
  *                              by less than this value, potential reduction
  *                              stops and the simulation starts. (J)
+ *
+ * STAGE 0A: SOFT-CORE WARM-UP (optional, --softcore)
+ * Randomly populated universes start with nearly overlapping atoms, for which
+ * the r^-12 and r^-2 terms explode. The nonbonded forces are first capped at
+ * the value they take at a capping distance, below which the potentials are
+ * extended linearly. The capping distance shrinks to 0 as the coupling
+ * parameter lambda is ramped up to 1 (the real potentials), while all the atoms
+ * are moved at once down the capped potential gradient.
+ *   SOFTCORE_LENNARDJONES_RADIUS: Lennard-Jones capping distance at lambda=0,
+ *                                 as a multiple of the sigma parameter
+ *   SOFTCORE_COULOMB_RADIUS: Electrostatic capping distance at lambda=0
+ *   UNIVERSE_REDUCEPOT_SOFTCORE_LAMBDA_START: First value of lambda
+ *   UNIVERSE_REDUCEPOT_SOFTCORE_LAMBDA_STEP: Increment of lambda
+ *   UNIVERSE_REDUCEPOT_SOFTCORE_CYCLES: Gradient descent cycles per lambda
+ *   UNIVERSE_REDUCEPOT_SOFTCORE_STEP: Initial displacement of the most
+ *                                     strained atom
+ *   UNIVERSE_REDUCEPOT_SOFTCORE_STEP_GROWTH: Step multiplier after a success
+ *   UNIVERSE_REDUCEPOT_SOFTCORE_STEP_SHRINK: Step multiplier after a failure
+ *
+ * STAGE 0B: RIGID MOLECULES (optional, --rigid)
+ * Most of the potential energy of a freshly populated universe comes from
+ * clashes between molecules, not from their internal strain. Each substrate
+ * and solvent copy is moved as a rigid body (translation along the net force,
+ * rotation about the net torque), one molecule at a time, and the move is
+ * discarded if it raises the potential felt by the molecule's atoms.
+ *   UNIVERSE_REDUCEPOT_RIGID_STEP: Initial displacement of the farthest atom
+ *   UNIVERSE_REDUCEPOT_RIGID_MIN_STEP: The stage ends below this step
+ *   UNIVERSE_REDUCEPOT_RIGID_MAX_CYCLES: The stage ends after this many cycles
+ *   UNIVERSE_REDUCEPOT_RIGID_STEP_GROWTH: Step multiplier after a cycle in
+ *                                         which most molecules moved
+ *   UNIVERSE_REDUCEPOT_RIGID_STEP_SHRINK: Step multiplier otherwise
  */
 #define UNIVERSE_REDUCEPOT_COARSE_STEP_MAGNITUDE       ((double)1E-9)
 #define UNIVERSE_REDUCEPOT_COARSE_MAX_ATTEMPTS         ((size_t)1E2)
 #define UNIVERSE_REDUCEPOT_COARSE_MAGNITUDE_MULTIPLIER ((double)1E-1)
+#define UNIVERSE_REDUCEPOT_COARSE_PARALLEL_MIN_STEP    ((double)1E-10)
 #define UNIVERSE_REDUCEPOT_FINE_MAX_STEP               ((double)1E-10)
 #define UNIVERSE_REDUCEPOT_FINE_TIMESTEP               ((double)1E-15)
 #define UNIVERSE_REDUCEPOT_END_WIGGLING                ((double)0.5)
 #define UNIVERSE_REDUCEPOT_CUTOFF                      ((double)1E-6 * 1E-12)
+#define SOFTCORE_LENNARDJONES_RADIUS                   ((double)1E0)
+#define SOFTCORE_COULOMB_RADIUS                        ((double)1E-10)
+#define UNIVERSE_REDUCEPOT_SOFTCORE_LAMBDA_START       ((double)2E-1)
+#define UNIVERSE_REDUCEPOT_SOFTCORE_LAMBDA_STEP        ((double)2E-1)
+#define UNIVERSE_REDUCEPOT_SOFTCORE_CYCLES             ((size_t)4)
+#define UNIVERSE_REDUCEPOT_SOFTCORE_STEP               ((double)1E-11)
+#define UNIVERSE_REDUCEPOT_SOFTCORE_STEP_GROWTH        ((double)1.2E0)
+#define UNIVERSE_REDUCEPOT_SOFTCORE_STEP_SHRINK        ((double)2E-1)
+#define UNIVERSE_REDUCEPOT_RIGID_STEP                  ((double)1E-10)
+#define UNIVERSE_REDUCEPOT_RIGID_MIN_STEP              ((double)1E-13)
+#define UNIVERSE_REDUCEPOT_RIGID_MAX_CYCLES            ((uint64_t)1E2)
+#define UNIVERSE_REDUCEPOT_RIGID_STEP_GROWTH           ((double)1.2E0)
+#define UNIVERSE_REDUCEPOT_RIGID_STEP_SHRINK           ((double)5E-1)
+
+/* REDUCED UNIVERSE CACHE
+ *
+ * With --cache, the state of the universe after potential reduction is stored
+ * in the given directory, and loaded instead of reducing the potential again
+ * when SENPAI is run with the same inputs. The files are named after a hash of
+ * the model, substrate and solvent files, and of every parameter the reduced
+ * state depends on.
+ *   CACHE_MAGIC: Identifies a cache file
+ *   CACHE_VERSION: Bumped whenever the layout or the reduction changes
+ *   CACHE_EXTENSION: Extension of the cache files
+ */
+#define CACHE_MAGIC     "SENPAIC"
+#define CACHE_VERSION   ((uint64_t)2)
+#define CACHE_EXTENSION ".suc"
+
+/* COMPILED SYSTEM CACHE
+ *
+ * With --cache, the model, substrate and solvent are also stored as loaded in
+ * the given directory, and mapped back instead of parsing the files again when
+ * SENPAI is run with the same ones. The files are named after a hash of the
+ * model, substrate and solvent files.
+ *   SYSTEM_MAGIC: Identifies a compiled system
+ *   SYSTEM_VERSION: Bumped whenever the layout or the loaders change
+ *   SYSTEM_EXTENSION: Extension of the compiled systems
+ */
+#define SYSTEM_MAGIC     "SENPAIS"
+#define SYSTEM_VERSION   ((uint64_t)1)
+#define SYSTEM_EXTENSION ".sys"
+
+/* CHECKPOINTS
+ *
+ * With --checkpoint, everything a step changes is saved to the given file every
+ * --checkpoint_interval steps, so that a run can be restarted from there with
+ * --restart instead of starting anew. The file only fits the model, substrate
+ * and solvent files it was saved with, and the output file of the same run.
+ *   CHECKPOINT_MAGIC: Identifies a checkpoint
+ *   CHECKPOINT_VERSION: Bumped whenever the layout changes
+ */
+#define CHECKPOINT_MAGIC   "SENPAIR"
+#define CHECKPOINT_VERSION ((uint64_t)2)
+
+/* BINARY TRAJECTORY
+ *
+ * When the output file's name ends with TRAJ_EXTENSION, the frames are saved
+ * as raw coordinates instead of text (see Documentation/sxb-format.txt).
+ *   TRAJ_MAGIC: Identifies a binary trajectory
+ *   TRAJ_VERSION: Bumped whenever the layout changes
+ *   TRAJ_EXTENSION: Extension of the binary trajectories
+ *   TRAJ_SYMBOL_LEN: Bytes given to each symbol of the element table
+ *   TRAJ_BUFFER_SIZE: Size of the output file's buffer (bytes)
+ *   TRAJ_BUFFER_ALIGNMENT: Alignment of the output file's buffer (bytes)
+ */
+#define TRAJ_MAGIC            "SENPAIT"
+#define TRAJ_VERSION          ((uint64_t)1)
+#define TRAJ_EXTENSION        ".sxb"
+#define TRAJ_SYMBOL_LEN       ((size_t)4)
+#define TRAJ_BUFFER_SIZE      ((size_t)1 << 22)
+#define TRAJ_BUFFER_ALIGNMENT ((size_t)4096)
+
+/* COMPRESSED TRAJECTORY
+ *
+ * When the output file's name ends with TRAJC_EXTENSION, the coordinates are
+ * rounded to multiples of --precision, and saved as variable-length deltas
+ * (see Documentation/sxc-format.txt).
+ *   TRAJC_MAGIC: Identifies a compressed trajectory
+ *   TRAJC_VERSION: Bumped whenever the layout changes
+ *   TRAJC_EXTENSION: Extension of the compressed trajectories
+ *   TRAJC_KEYFRAME_INTERVAL: Frames between two frames that can be decoded on
+ *                            their own
+ *   TRAJC_VARINT_MAX: Largest size of an encoded delta (bytes)
+ */
+#define TRAJC_MAGIC             "SENPAIZ"
+#define TRAJC_VERSION           ((uint64_t)1)
+#define TRAJC_EXTENSION         ".sxc"
+#define TRAJC_KEYFRAME_INTERVAL ((uint64_t)100)
+#define TRAJC_VARINT_MAX        ((size_t)10)
+
+/* TEXT TRAJECTORY
+ *
+ * The frames of an .xyz file are formatted in parallel, printing each
+ * coordinate from integers as "%lf" would.
+ *   XYZ_COORD_MAX: Coordinates this large or larger are left to printf (Å)
+ *   XYZ_COORD_LEN_MAX: Length of the longest coordinate below XYZ_COORD_MAX
+ *   XYZ_HEADER_LEN_MAX: Room left for the two lines heading a frame
+ *   XYZ_CHUNK_ATOM_NB: Number of atoms formatted by a thread at once
+ */
+#define XYZ_COORD_MAX      ((double)1E9)
+#define XYZ_COORD_LEN_MAX  ((size_t)17)
+#define XYZ_HEADER_LEN_MAX ((size_t)64)
+#define XYZ_CHUNK_ATOM_NB  ((size_t)1024)
+
+/* INPUT FILES
+ *
+ * The input files are mapped in memory, and their numbers parsed by hand.
+ *   PARSE_TOKEN_MAX: Longest number left to strtod, terminator included
+ */
+#define PARSE_TOKEN_MAX ((size_t)128)
+
+/* ASYNCHRONOUS WRITER
+ *
+ * With --async, the frames are copied into a ring of buffers, and saved to
+ * the output file by a thread of their own while the simulation goes on. The
+ * simulation only waits for the writer when the ring is full.
+ *   WRITER_SLOT_NB: Number of frames the ring holds
+ */
+#define WRITER_SLOT_NB ((uint64_t)4)
+
+/* OUTPUT STREAMS
+ *
+ * Each --stream saves a selection of the atoms, or the energies, to a file of
+ * its own, at an interval of its own, on top of the output file.
+ *   STREAM_NB_MAX: Number of streams a run can have
+ *   STREAM_ENERGY_HEADER: First line of an energy stream
+ */
+#define STREAM_NB_MAX        ((uint64_t)16)
+#define STREAM_ENERGY_HEADER "# iterations\ttime (fs)\tkinetic (J)\tpotential (J)\ttotal (J)\ttemperature (K)\tside (A)\n"
+
+/* LIVE FRAMES
+ *
+ * With --live, every frame is also published to a POSIX shared memory object
+ * holding the last few ones, which other processes can read as the simulation
+ * goes on (see Documentation/sxl-format.txt).
+ *   LIVE_MAGIC: Identifies the shared memory object
+ *   LIVE_VERSION: Bumped whenever the layout changes
+ *   LIVE_SLOT_NB: Number of frames the object holds
+ */
+#define LIVE_MAGIC   "SENPAIL"
+#define LIVE_VERSION ((uint64_t)1)
+#define LIVE_SLOT_NB ((uint64_t)16)
+
+/* NOSE-HOOVER CHAIN THERMOSTAT
+ *
+ * With --nose_hoover, the atoms' velocities are coupled to a chain of
+ * thermostats integrated with the Martyna-Tuckerman-Klein scheme. The first
+ * thermostat acts on the atoms, each following one acts on the previous one.
+ *   NHC_CHAIN_LENGTH: Number of thermostats in the chain
+ */
+#define NHC_CHAIN_LENGTH 4
+
+/* BERENDSEN BAROSTAT
+ *
+ * With --berendsen, the universe and the atoms' positions are rescaled after
+ * each step so that the pressure computed from the virial relaxes towards the
+ * target pressure.
+ *   BAROSTAT_COMPRESSIBILITY: Isothermal compressibility (Pa-1), water's
+ *   BAROSTAT_MAX_SCALING: Largest relative change of the size in one step
+ */
+#define BAROSTAT_COMPRESSIBILITY ((double)4.5E-10)
+#define BAROSTAT_MAX_SCALING     ((double)1E-2)
+
+/* BOND CONSTRAINTS
+ *
+ * With --shake, the bonds to hydrogens are held at the sum of the covalent
+ * radii of their atoms, which lifts the limit their vibration puts on the
+ * timestep. With --settle, waters are held rigid, with the bond angle of their
+ * oxygen. SETTLE is solved exactly, SHAKE and RATTLE are iterated.
+ *   CONSTRAINT_TOLERANCE: Largest relative error left on a bond length
+ *   CONSTRAINT_MAX_ITERATIONS: SHAKE and RATTLE fail after this many iterations
+ */
+#define CONSTRAINT_TOLERANCE      ((double)1E-8)
+#define CONSTRAINT_MAX_ITERATIONS ((size_t)1E3)
+
+/* ADAPTIVE TIMESTEP
+ *
+ * With --adaptive, the timestep is picked before each step so that no atom
+ * moves further than the given displacement, from the largest velocity and
+ * acceleration in the universe. The timestep given with --dt is the largest
+ * one that can be picked.
+ *   ADAPTIVE_MIN_RATIO: Smallest timestep, as a fraction of the largest one
+ *   ADAPTIVE_MAX_GROWTH: Largest growth of the timestep in one step. It can
+ *                        shrink as fast as needed
+ */
+#define ADAPTIVE_MIN_RATIO  ((double)1E-3)
+#define ADAPTIVE_MAX_GROWTH ((double)1.05)
+
+/* WATCHDOG
+ *
+ * With --watchdog, the universe is sampled every few steps from the force
+ * update, and the run is stopped (or taken back to the last good sample with
+ * --rollback) as soon as it blows up.
+ *
+ *   WATCHDOG_FRC_MAX: Largest force an atom may feel (N)
+ *   WATCHDOG_DRIFT_MAX: Largest change of the total energy between two
+ *                       samples, as a fraction of the kinetic energy
+ *   WATCHDOG_ROLLBACK_MAX: Rollbacks before giving up, each of them halving
+ *                          the timestep, which can't get below --dt/2^this
+ */
+#define WATCHDOG_FRC_MAX      ((double)1E-6)
+#define WATCHDOG_DRIFT_MAX    ((double)2.0)
+#define WATCHDOG_ROLLBACK_MAX ((uint64_t)8)
 
 #endif
@@ -11,10 +11,17 @@
 #include "universe.h"
 #include "vec3.h"
 
+/* Terms summed by force_total() */
+#define FORCE_BONDED    ((uint8_t)1) /* Bonds and angles */
+#define FORCE_NONBONDED ((uint8_t)2) /* Electrostatics and Lennard-Jones */
+#define FORCE_ALL       (FORCE_BONDED | FORCE_NONBONDED)
+
 universe_t *force_bond(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2);
 universe_t *force_electrostatic(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2);
 universe_t *force_lennardjones(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2);
+universe_t *force_electrostatic_softcore(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2);
+universe_t *force_lennardjones_softcore(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2);
 universe_t *force_angle(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2);
-universe_t *force_total(vec3_t *frc, universe_t *universe, const uint64_t atom_id);
+universe_t *force_total(vec3_t *frc, double *pot, mat3_t *vir, universe_t *universe, const uint64_t atom_id, const uint8_t terms);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+/*
+ * live.h
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#ifndef LIVE_H
+#define LIVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * With --live, the frames are also published to a POSIX shared memory object,
+ * so that other processes can watch the simulation as it goes on (see
+ * Documentation/sxl-format.txt). The object holds a header, the element of
+ * each atom as in an .sxb file, then a ring of LIVE_SLOT_NB frames, frame n
+ * going to slot n % LIVE_SLOT_NB. Each slot holds a sequence number, odd while
+ * the frame is being copied and 2n+2 once frame n is whole, so that readers
+ * can tell a frame that was overwritten while they copied it. The simulation
+ * never waits for the readers, and publishing a frame takes no system call.
+ *
+ */
+
+typedef struct live_header_s live_header_t;
+struct live_header_s
+{
+  char magic[8];           /* LIVE_MAGIC, written last */
+  uint64_t version;        /* LIVE_VERSION */
+  uint64_t byte_order;     /* 0x0102030405060708, as written by the machine */
+  uint64_t atom_nb;        /* Number of atoms in each frame */
+  uint64_t entry_nb;       /* Number of entries in the element table */
+  uint64_t coord_size;     /* 4 if the coordinates are floats, 8 if doubles */
+  uint64_t slot_nb;        /* Number of slots in the ring */
+  uint64_t slot_size;      /* Length of a slot (bytes) */
+  uint64_t slot_offset;    /* Offset of the first slot from the header (bytes) */
+  double timestep;         /* (fs) Timestep given with --dt */
+  double frame_interval;   /* (fs) Simulated time between two frames */
+  uint64_t head;           /* Frames published so far */
+  uint64_t ended;          /* 1 once the simulation is over */
+};
+
+typedef struct live_slot_s live_slot_t;
+struct live_slot_s
+{
+  uint64_t sequence;       /* Odd while the frame is copied, 2n+2 once frame n is whole */
+  uint64_t iterations;     /* Iterations rendered before the frame */
+  double time;             /* (fs) Simulated time */
+  double size;             /* (Å) Side of the universe */
+};
+
+/* The object published by the simulation */
+typedef struct live_s live_t;
+struct live_s
+{
+  const char *name;        /* Name of the shared memory object */
+  live_header_t *header;   /* The object, mapped in memory */
+  size_t len;              /* Length of the object (bytes) */
+};
+
+#define LIVE_NAME_DEFAULT   ((const char*)    NULL)
+#define LIVE_HEADER_DEFAULT ((live_header_t*) NULL)
+#define LIVE_LEN_DEFAULT    ((size_t)         0)
+
+/* Returns the slot holding frame n */
+#define LIVE_SLOT(header, n) ((live_slot_t*)((char*)(header) + (header)->slot_offset + ((n) % (header)->slot_nb)*(header)->slot_size))
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * parse.h
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * The input files are mapped in memory rather than read. When they have to
+ * be parsed, their lines are indexed in a single pass, so that the lines can
+ * then be parsed in any order, by any thread, without copying or altering the
+ * file. As strtok would, the index leaves the empty lines out.
+ * The numbers are parsed by hand, as strtod would, and only the few it can't
+ * be sure to round as strtod does are left to it.
+ *
+ */
+
+typedef struct line_s line_t;
+struct line_s
+{
+  const char *start; /* First character of the line */
+  const char *end;   /* Character past the last one, '\n' or the end of the file */
+};
+
+typedef struct input_s input_t;
+struct input_s
+{
+  const char *data;  /* Contents of the file, mapped in memory */
+  size_t len;        /* Length of the file (bytes) */
+  uint64_t line_nb;  /* Number of lines, the empty ones left out */
+  line_t *line;      /* Bounds of each line */
+};
+
+#define INPUT_DATA_DEFAULT    ((const char*) NULL)
+#define INPUT_LEN_DEFAULT     ((size_t)      0)
+#define INPUT_LINE_NB_DEFAULT ((uint64_t)    0)
+#define INPUT_LINE_DEFAULT    ((line_t*)     NULL)
+
+input_t *input_map(input_t *input, FILE *file); /* Maps the file in memory */
+input_t *input_index(input_t *input);           /* Indexes the lines of a mapped file */
+void     input_unmap(input_t *input);
+
+/*
+ * Each of these skips the blanks at str, parses what follows up to end, and
+ * returns the character past it, or NULL if it isn't what was expected
+ */
+const char *parse_word(const char *str, const char *end, const char **word, size_t *len);
+const char *parse_double(const char *str, const char *end, double *value);
+const char *parse_uint64(const char *str, const char *end, uint64_t *value);
+
+#endif
@@ -12,10 +12,22 @@
 
 #include "universe.h"
 
-universe_t *potential_bond(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2);
-universe_t *potential_electrostatic(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2);
-universe_t *potential_lennardjones(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2);
-universe_t *potential_angle(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2);
+/*
+ * The pair potentials take the minimum image vector going from a1 to a2, so
+ * that the potential felt by an atom can be computed at a position it isn't at
+ * yet, against a snapshot of the others' positions (potential_total_at). The
+ * angle potential reads the node's ligands from pos, or from the universe if
+ * pos is NULL.
+ *
+ */
+
+universe_t *potential_bond(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec);
+universe_t *potential_electrostatic(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec);
+universe_t *potential_lennardjones(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec);
+universe_t *potential_electrostatic_softcore(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec);
+universe_t *potential_lennardjones_softcore(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec);
+universe_t *potential_angle(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec, const vec3_t *pos);
 universe_t *potential_total(double *pot, universe_t *universe, const uint64_t atom_id);
+universe_t *potential_total_at(double *pot, universe_t *universe, const uint64_t atom_id, const vec3_t *pos_id, const vec3_t *pos);
 
 #endif
@@ -0,0 +1,35 @@
+/*
+ * rng.h
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+#include "vec3.h"
+
+/*
+ * rand() shares a single hidden state between all the threads, so parallel
+ * algorithms draw their random numbers from one rng_t stream per thread
+ * instead. Each stream is a xoshiro256** generator, seeded through splitmix64
+ * so that neighbouring seeds give unrelated streams.
+ *
+ */
+
+typedef struct rng_s rng_t;
+struct rng_s
+{
+  uint64_t s[4]; /* Generator state */
+};
+
+rng_t   *rng_seed(rng_t *rng, const uint64_t seed);
+uint64_t rng_next(rng_t *rng);                 /* Returns a random 64-bit integer */
+double   rng_uniform(rng_t *rng);              /* Returns a random number in [0; 1[ */
+vec3_t  *rng_marsaglia(vec3_t *v, rng_t *rng); /* Generates a random unit vector as per the 1972 Marsaglia method */
+vec3_t  *rng_gaussian(vec3_t *v, rng_t *rng);  /* Generates a vector of three standard normal deviates */
+
+#endif
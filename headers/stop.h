@@ -0,0 +1,27 @@
+/*
+ * stop.h
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#ifndef STOP_H
+#define STOP_H
+
+#include "args.h"
+
+/*
+ * Batch schedulers send SIGTERM or SIGUSR1 a while before killing a job that
+ * ran out of time. Neither the signals nor --max_walltime stop the program
+ * right away: they only ask the simulation to stop once the current step is
+ * done, so that the frames saved so far, and a last checkpoint, are whole.
+ * The signals are only caught once the simulation starts: until then, there
+ * is nothing to save, and they end the program as usual.
+ *
+ */
+
+void stop_init(void);                    /* Starts the clock */
+void stop_catch(void);                   /* Catches the signals */
+int  stop_requested(const args_t *args); /* Returns whether the simulation should stop after this step */
+
+#endif
@@ -47,12 +47,31 @@
 #define TEXT_ARGS_TEMPERATURE_FAILURE          TEXT_FAILURE "args_check: The system temperature cannot be negative!"
 #define TEXT_ARGS_PRESSURE_FAILURE             TEXT_FAILURE "args_check: The system pressure must be positive!"
 #define TEXT_ARGS_DENSITY_FAILURE              TEXT_FAILURE "args_check: The system's density must be positive!"
+#define TEXT_ARGS_SOLVENT_DENSITY_FAILURE      TEXT_FAILURE "args_check: The solvent's density must be positive!"
 #define TEXT_ARGS_REDUCEPOT_FAILURE            TEXT_FAILURE "args_check: The target potential must be positive!"
+#define TEXT_ARGS_LANGEVIN_FAILURE             TEXT_FAILURE "args_check: The Langevin friction cannot be negative!"
+#define TEXT_ARGS_BERENDSEN_FAILURE            TEXT_FAILURE "args_check: The Berendsen time constant must be positive, and requires analytical forces!"
+#define TEXT_ARGS_RESPA_FAILURE                TEXT_FAILURE "args_check: The r-RESPA step ratio must be at least 1, and above 1 requires analytical forces!"
+#define TEXT_ARGS_HMR_FAILURE                  TEXT_FAILURE "args_check: The repartitioned hydrogen mass cannot be negative!"
+#define TEXT_ARGS_WATCHDOG_FAILURE             TEXT_FAILURE "args_check: The watchdog's interval must be a multiple of the r-RESPA step ratio, and --rollback requires --watchdog!"
+#define TEXT_ARGS_RESUME_FAILURE               TEXT_FAILURE "args_check: --resume requires --checkpoint, and the walltime cannot be negative!"
+#define TEXT_ARGS_STREAM_FAILURE               TEXT_FAILURE "args_check: Too many output streams were given!"
+#define TEXT_ARGS_LIVE_FAILURE                 TEXT_FAILURE "args_check: The name given with --live has to be a slash followed by a file name!"
+#define TEXT_ARGS_CHECKPOINT_FAILURE           TEXT_FAILURE "args_check: The checkpoint interval must be a positive multiple of the r-RESPA step ratio!"
+#define TEXT_ARGS_PRECISION_FAILURE            TEXT_FAILURE "args_check: The precision of the compressed trajectory must be positive!"
+#define TEXT_ARGS_ADAPTIVE_FAILURE             TEXT_FAILURE "args_check: The adaptive timestep's displacement cannot be negative!"
+#define TEXT_ARGS_NOSE_HOOVER_FAILURE          TEXT_FAILURE "args_check: The Nose-Hoover time constant must be positive, and cannot be used with --langevin!"
+
+/* cell.c */
+#define TEXT_CELL_GRID_INIT_FAILURE            TEXT_FAILURE "cell_grid_init: Failed to initialize the cell grid"
+#define TEXT_CELL_GRID_FILL_FAILURE            TEXT_FAILURE "cell_grid_fill: Failed to bin the atoms into the cell grid"
 
 /* force.c */
 #define TEXT_FORCE_BOND_FAILURE                TEXT_FAILURE "force_bond: Failed to compute the bond force"
 #define TEXT_FORCE_ELECTROSTATIC_FAILURE       TEXT_FAILURE "force_electrostatic: Failed to compute the electrostatic force"
 #define TEXT_FORCE_LENNARDJONES_FAILURE        TEXT_FAILURE "force_lennardjones: Failed to compute the Lennard-Jones force"
+#define TEXT_FORCE_ELECTROSTATIC_SOFTCORE_FAILURE TEXT_FAILURE "force_electrostatic_softcore: Failed to compute the soft-core electrostatic force"
+#define TEXT_FORCE_LENNARDJONES_SOFTCORE_FAILURE  TEXT_FAILURE "force_lennardjones_softcore: Failed to compute the soft-core Lennard-Jones force"
 #define TEXT_FORCE_ANGLE_FAILURE               TEXT_FAILURE "force_angle: Failed to compute bond angle force"
 #define TEXT_FORCE_TOTAL_FAILURE               TEXT_FAILURE "force_total: Failed to compute the force vector"
 
@@ -63,10 +82,12 @@
 #define TEXT_MODEL_ENTRY_INIT_FAILURE          TEXT_FAILURE "model_entry_init: Failed to initialize a model entry"
 
 /* atom.c */
+#define TEXT_ATOM_DUPLICATE_FAILURE            TEXT_FAILURE "atom_duplicate: Failed to duplicate an atom"
 #define TEXT_ATOM_UPDATE_FRC_FAILURE           TEXT_FAILURE "atom_update_frc: Failed to update an atom's force"
 #define TEXT_ATOM_UPDATE_ACC_FAILURE           TEXT_FAILURE "atom_update_acc: Failed to update an atom's acceleration"
 #define TEXT_ATOM_UPDATE_VEL_FAILURE           TEXT_FAILURE "atom_update_vel: Failed to update an atom's velocity"
 #define TEXT_ATOM_UPDATE_POS_FAILURE           TEXT_FAILURE "atom_update_pos: Failed to update an atom's position"
+#define TEXT_ATOM_UPDATE_LANGEVIN_FAILURE      TEXT_FAILURE "atom_update_langevin: Failed to apply the Langevin thermostat"
 
 /* potential.c */
 #define TEXT_POTENTIAL_BOND_FAILURE            TEXT_FAILURE "potential_bond: Failed to compute bond potential"
@@ -89,20 +110,38 @@
 #define TEXT_INFO_SUBSTRATE_ATOM_NB                         "Atoms..................%ld\n"
 #define TEXT_INFO_SUBSTRATE_BOND_NB                         "Bonds..................%ld\n"
 #define TEXT_INFO_SUBSTRATE_COPIES                          "Duplicates to simulate.%ld\n"
+#define TEXT_INFO_SOLVENT_COPIES                            "Solvent copies.........%ld\n"
 #define TEXT_INFO_ATOM_NB                                   "Atoms..................%ld\n"
 #define TEXT_INFO_TEMPERATURE                               "Temperature............%lf K\n"
+#define TEXT_INFO_LANGEVIN                                  "Langevin friction......%lf ps-1\n"
+#define TEXT_INFO_BERENDSEN                                 "Berendsen constant.....%lf ps\n"
+#define TEXT_INFO_RESPA                                     "r-RESPA step ratio.....%ld\n"
+#define TEXT_INFO_HMR                                       "Hydrogen mass..........%lf u\n"
+#define TEXT_INFO_NOSE_HOOVER                               "Nose-Hoover constant...%lf ps\n"
 #define TEXT_INFO_PRESSURE                                  "Pressure...............%.2E hPa\n"
 #define TEXT_INFO_DENSITY                                   "Density................%.2E g.cm-3\n"
+#define TEXT_INFO_SOLVENT_DENSITY                           "Solvent density........%.2E g.cm-3\n"
 #define TEXT_INFO_UNIVERSE_SIZE                             "Universe size  ........%.2E m\n"
 #define TEXT_INFO_SIMULATION_TIME                           "Simulation time........%.2E s\n"
+#define TEXT_INFO_ADAPTIVE                                  "Adaptive displacement..%lf Å\n"
 #define TEXT_INFO_TIMESTEP                                  "Timestep...............%.2E s\n"
+#define TEXT_INFO_WATCHDOG                                  "Watchdog interval......%ld\n"
+#define TEXT_INFO_CHECKPOINT                                "Checkpoint interval....%ld\n"
+#define TEXT_INFO_STREAMS                                   "Output streams.........%ld\n"
+#define TEXT_INFO_MAX_WALLTIME                              "Max. walltime..........%.2E s\n"
 #define TEXT_INFO_FRAMESKIP                                 "Frameskip..............%ld\n"
 #define TEXT_INFO_ITERATIONS                                "Iterations.............%ld\n\n"
 
 #define TEXT_UNIVERSE_SIMULATE_SUCCESS         LINE_RESET TEXT_SUCCESS "Rendered frame %ld/%ld (%.2lf%%)"
 
+#define TEXT_UNIVERSE_SOLVATE_SUCCESS                     TEXT_SUCCESS "Inserted %ld solvent molecules (%ld discarded due to overlaps)\n"
+
 #define TEXT_UNIVERSE_REDUCEPOT_CURRENT_POT               TEXT_INFO    "Current potential is %.2E pJ (Target: %.2E pJ)\n"
 #define TEXT_UNIVERSE_REDUCEPOT_START                     TEXT_INFO    "Starting potential reduction\n"
+#define TEXT_UNIVERSE_REDUCEPOT_SOFTCORE_START            TEXT_INFO    "Starting stage 0a algorithm (Soft-core warm-up)\n"
+#define TEXT_UNIVERSE_REDUCEPOT_SOFTCORE_SUCCESS LINE_RESET TEXT_SUCCESS "Capped potential is %.2E pJ (lambda = %.2lf, %ld cycles)"
+#define TEXT_UNIVERSE_REDUCEPOT_RIGID_START               TEXT_INFO    "Starting stage 0b algorithm (Rigid molecules)\n"
+#define TEXT_UNIVERSE_REDUCEPOT_RIGID_SUCCESS  LINE_RESET TEXT_SUCCESS "Reduced potential by %.2E pJ to %.2E pJ (%ld cycles, %.2lf%% complete)"
 #define TEXT_UNIVERSE_REDUCEPOT_COARSE_START              TEXT_INFO    "Starting stage 1 algorithm (wiggling)\n"
 #define TEXT_UNIVERSE_REDUCEPOT_COARSE_SUCCESS LINE_RESET TEXT_SUCCESS "Reduced potential by %.2E pJ to %.2E pJ (%ld cycles, %.2lf%% complete)"
 #define TEXT_UNIVERSE_REDUCEPOT_FINE_START                TEXT_INFO    "Starting stage 2 algorithm (Gradient descent)\n"
@@ -111,16 +150,70 @@
 #define TEXT_UNIVERSE_REDUCEPOT_SUCCESS                   TEXT_SUCCESS "Potential reduction completed\n"
 #define TEXT_UNIVERSE_REDUCEPOT_FAILURE                   TEXT_FAILURE "universe_reducepot: Failed to lower the system's potential"
 #define TEXT_UNIVERSE_REDUCEPOT_COARSE_FAILURE            TEXT_FAILURE "universe_reducepot_coarse: Failed to lower the system's potential"
+#define TEXT_UNIVERSE_REDUCEPOT_SOFTCORE_FAILURE          TEXT_FAILURE "universe_reducepot_softcore: Failed to lower the system's potential"
+#define TEXT_UNIVERSE_REDUCEPOT_RIGID_FAILURE             TEXT_FAILURE "universe_reducepot_rigid: Failed to lower the system's potential"
 #define TEXT_UNIVERSE_REDUCEPOT_FINE_FAILURE              TEXT_FAILURE "universe_reducepot_fine: Failed to lower the system's potential"
 
+#define TEXT_UNIVERSE_CONSTRAINT_INIT_SUCCESS  TEXT_SUCCESS "Holding %ld bonds with SHAKE/RATTLE, and %ld waters with SETTLE\n"
+
+#define TEXT_UNIVERSE_WATCHDOG_TRIGGERED       TEXT_FAILURE "Watchdog: iteration %ld (%.2E s): %ld non-finite atoms, largest force %.2E N, energy drift %.2E J for a kinetic energy of %.2E J\n"
+#define TEXT_UNIVERSE_WATCHDOG_ROLLBACK        TEXT_INFO    "Watchdog: rolling back to iteration %ld (%.2E s) with a timestep of %.2E s\n"
+
+#define TEXT_UNIVERSE_STREAMS_INVALID          TEXT_FAILURE "universe_streams_init: Invalid output stream (\"%s\")\n"
+#define TEXT_UNIVERSE_STREAMS_INIT_FAILURE     TEXT_FAILURE "universe_streams_init: Failed to set up the output streams"
+#define TEXT_UNIVERSE_STREAMS_WRITE_FAILURE    TEXT_FAILURE "universe_streams_write: Failed to save to an output stream"
+#define TEXT_UNIVERSE_STREAMS_MARK_FAILURE     TEXT_FAILURE "universe_streams_mark: Failed to find where an output stream stands"
+#define TEXT_UNIVERSE_STREAMS_REWIND_FAILURE   TEXT_FAILURE "universe_streams_rewind: Failed to cut an output stream"
+#define TEXT_UNIVERSE_TRAJ_STREAM_FAILURE      TEXT_FAILURE "universe_traj_stream: Failed to save to a binary output stream"
+#define TEXT_UNIVERSE_LIVE_INIT                TEXT_SUCCESS "Publishing the frames to the shared memory object %s\n"
+#define TEXT_UNIVERSE_LIVE_INIT_FAILURE        TEXT_FAILURE "universe_live_init: Failed to create the shared memory object"
+#define TEXT_UNIVERSE_CHECKPOINT_RESTART       TEXT_SUCCESS "Restarting from iteration %ld (%.2E s) of the checkpoint (%s)\n"
+#define TEXT_UNIVERSE_SIMULATE_STOP            TEXT_INFO    "Stopping at iteration %ld (%.2E s), as asked by a signal or the walltime\n"
+#define TEXT_UNIVERSE_CHECKPOINT_BUSY          TEXT_INFO    "Checkpoint: skipped iteration %ld, the previous checkpoint is still being saved\n"
+
+#define TEXT_UNIVERSE_TRAJ_INIT_FAILURE        TEXT_FAILURE "universe_traj_init: Failed to set up the output file"
+#define TEXT_UNIVERSE_TRAJ_HEADER_FAILURE      TEXT_FAILURE "universe_traj_header: Failed to write the trajectory's header"
+#define TEXT_UNIVERSE_TRAJ_RESUME_FAILURE      TEXT_FAILURE "universe_traj_resume: Failed to find the frames saved before the checkpoint"
+#define TEXT_UNIVERSE_TRAJ_WRITE_FAILURE       TEXT_FAILURE "universe_traj_write: Failed to write the frame"
+#define TEXT_UNIVERSE_XYZ_INIT_FAILURE         TEXT_FAILURE "universe_xyz_init: Failed to allocate the frame buffer"
+#define TEXT_UNIVERSE_XYZ_WRITE_FAILURE        TEXT_FAILURE "universe_xyz_write: Failed to write the frame"
+#define TEXT_UNIVERSE_WRITER_INIT_FAILURE      TEXT_FAILURE "universe_writer_init: Failed to start the writer"
+#define TEXT_UNIVERSE_WRITER_PUSH_FAILURE      TEXT_FAILURE "universe_writer_push: Failed to save the frame"
+#define TEXT_UNIVERSE_WRITER_SYNC_FAILURE      TEXT_FAILURE "universe_writer_sync: Failed to save the pending frames"
+#define TEXT_UNIVERSE_PRINTSTATE_FAILURE       TEXT_FAILURE "universe_printstate: Failed to save the frame"
+
+#define TEXT_UNIVERSE_CACHE_HIT                TEXT_SUCCESS "Loaded the reduced universe from the cache (%s)\n"
+#define TEXT_UNIVERSE_CACHE_MISS               TEXT_INFO    "No reduced universe in the cache (%s)\n"
+#define TEXT_UNIVERSE_CACHE_STORE_SUCCESS      TEXT_SUCCESS "Saved the reduced universe to the cache (%s)\n"
+#define TEXT_UNIVERSE_CACHE_LOAD_FAILURE       TEXT_FAILURE "universe_cache_load: Failed to load the reduced universe from the cache"
+#define TEXT_UNIVERSE_CACHE_STORE_FAILURE      TEXT_FAILURE "universe_cache_store: Failed to save the reduced universe to the cache"
 #define TEXT_UNIVERSE_INIT_FAILURE             TEXT_FAILURE "universe_init: Failed to initialize the universe"
+#define TEXT_UNIVERSE_SYSTEM_HIT               TEXT_SUCCESS "Loaded the compiled system from the cache (%s)\n"
+#define TEXT_UNIVERSE_SYSTEM_MISS              TEXT_INFO    "No compiled system in the cache (%s)\n"
+#define TEXT_UNIVERSE_SYSTEM_STORE_SUCCESS     TEXT_SUCCESS "Saved the compiled system to the cache (%s)\n"
+#define TEXT_UNIVERSE_SYSTEM_LOAD_FAILURE      TEXT_FAILURE "universe_system_load: Failed to load the compiled system from the cache"
+#define TEXT_UNIVERSE_SYSTEM_STORE_FAILURE     TEXT_FAILURE "universe_system_store: Failed to save the compiled system to the cache"
 #define TEXT_UNIVERSE_LOAD_MODEL_FAILURE       TEXT_FAILURE "universe_load_model: Failed to load initial state"
 #define TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE   TEXT_FAILURE "universe_load_substrate: Failed to load initial state"
 #define TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE     TEXT_FAILURE "universe_load_solvent: Failed to load initial state"
 #define TEXT_UNIVERSE_POPULATE_FAILURE         TEXT_FAILURE "universe_populate: Failed to populate universe"
+#define TEXT_UNIVERSE_SOLVATE_FAILURE          TEXT_FAILURE "universe_solvate: Failed to solvate the universe"
 #define TEXT_UNIVERSE_SETVELOCITY_FAILURE      TEXT_FAILURE "universe_setvelocity: Failed to set initial velocities"
 #define TEXT_UNIVERSE_SIMULATE_FAILURE         TEXT_FAILURE "universe_simulate: Simulation failed"
 #define TEXT_UNIVERSE_ITERATE_FAILURE          TEXT_FAILURE "universe_iterate: Iteration failed"
+#define TEXT_UNIVERSE_UPDATE_FRC_FAILURE       TEXT_FAILURE "universe_update_frc: Failed to update the forces"
+#define TEXT_UNIVERSE_BAROSTAT_FAILURE         TEXT_FAILURE "universe_barostat: Failed to rescale the universe"
+#define TEXT_UNIVERSE_HMR_FAILURE              TEXT_FAILURE "universe_hmr: Failed to repartition the hydrogen masses"
+#define TEXT_UNIVERSE_CONSTRAINT_INIT_FAILURE  TEXT_FAILURE "universe_constraint_init: Failed to find the constraints"
+#define TEXT_UNIVERSE_CONSTRAIN_POS_FAILURE    TEXT_FAILURE "universe_constrain_pos: Failed to satisfy the constraints"
+#define TEXT_UNIVERSE_CONSTRAIN_VEL_FAILURE    TEXT_FAILURE "universe_constrain_vel: Failed to satisfy the constraints"
+#define TEXT_UNIVERSE_WATCHDOG_INIT_FAILURE    TEXT_FAILURE "universe_watchdog_init: Failed to take the first snapshot"
+#define TEXT_UNIVERSE_WATCHDOG_CHECK_FAILURE   TEXT_FAILURE "universe_watchdog_check: The simulation blew up"
+#define TEXT_UNIVERSE_CHECKPOINT_INIT_FAILURE  TEXT_FAILURE "universe_checkpoint_init: Failed to allocate the checkpoint"
+#define TEXT_UNIVERSE_CHECKPOINT_SAVE_FAILURE  TEXT_FAILURE "universe_checkpoint_save: Failed to save the checkpoint"
+#define TEXT_UNIVERSE_CHECKPOINT_SYNC_FAILURE  TEXT_FAILURE "universe_checkpoint_sync: Failed to save the last checkpoint"
+#define TEXT_UNIVERSE_CHECKPOINT_LOAD_FAILURE  TEXT_FAILURE "universe_checkpoint_load: Failed to load the checkpoint"
+#define TEXT_UNIVERSE_NHC_INIT_FAILURE         TEXT_FAILURE "universe_nhc_init: Failed to initialise the Nose-Hoover chain"
 #define TEXT_UNIVERSE_ENERGY_KINETIC_FAILURE   TEXT_FAILURE "universe_energy_kinetic: Failed to compute kinetic system energy"
 #define TEXT_UNIVERSE_ENERGY_POTENTIAL_FAILURE TEXT_FAILURE "universe_energy_potential: Failed to compute potential system energy"
 #define TEXT_UNIVERSE_ENERGY_TOTAL_FAILURE     TEXT_FAILURE "universe_energy_total: Failed to compute total system energy"
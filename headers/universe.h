@@ -10,14 +10,21 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <pthread.h>
 
+#include "config.h"
 #include "model.h"
 #include "vec3.h"
 #include "text.h"
 #include "args.h"
+#include "util.h"
+#include "rng.h"
+#include "parse.h"
+#include "live.h"
 
 /* t_atom */
 #define ATOM_ELEMENT_DEFAULT       ((uint64_t)   0)
+#define ATOM_MASS_DEFAULT          ((double)     0.0)
 #define ATOM_CHARGE_DEFAULT        ((double)     0.0)
 #define ATOM_EPSILON_DEFAULT       ((double)     0.0)
 #define ATOM_SIGMA_DEFAULT         ((double)     0.0)
@@ -36,12 +43,35 @@
 #define ATOM_FRC_X_DEFAULT         ((double)     0.0)
 #define ATOM_FRC_Y_DEFAULT         ((double)     0.0)
 #define ATOM_FRC_Z_DEFAULT         ((double)     0.0)
+#define ATOM_POT_DEFAULT           ((double)     0.0)
+
+/* Optional results of the force updates */
+#define UPDATE_FRC_POTENTIAL ((uint8_t)1) /* Sum the potential energy */
+#define UPDATE_FRC_VIRIAL    ((uint8_t)2) /* Sum the virial tensor */
+#define UPDATE_FRC_FAST      ((uint8_t)4) /* Only update the bonded forces */
+#define UPDATE_FRC_SLOW      ((uint8_t)8) /* Update the bonded forces, and the nonbonded ones apart in frc_slow */
+#define UPDATE_FRC_WATCHDOG  ((uint8_t)16) /* Find the largest force, and count the atoms that aren't finite */
+
+/* Formats of the output file */
+#define OUTPUT_FORMAT_XYZ ((uint8_t)0) /* Text, one line per atom */
+#define OUTPUT_FORMAT_SXB ((uint8_t)1) /* Raw coordinates, see Documentation/sxb-format.txt */
+#define OUTPUT_FORMAT_SXC ((uint8_t)2) /* Rounded and delta-coded coordinates, see Documentation/sxc-format.txt */
+#define OUTPUT_FORMAT_ENERGY ((uint8_t)3) /* Text, one line of energies per frame, for the output streams only */
 
 /* t_universe */
 #define UNIVERSE_FILE_MODEL_DEFAULT             ((FILE*)    NULL)
 #define UNIVERSE_FILE_OUTPUT_DEFAULT            ((FILE*)    NULL)
+#define UNIVERSE_OUTPUT_FORMAT_DEFAULT          OUTPUT_FORMAT_XYZ
+#define UNIVERSE_OUTPUT_BUFFER_DEFAULT          ((char*)    NULL)
+#define UNIVERSE_OUTPUT_FRAME_DEFAULT           ((void*)    NULL)
+#define UNIVERSE_OUTPUT_REF_DEFAULT             ((int64_t*) NULL)
+#define UNIVERSE_OUTPUT_QUANT_DEFAULT           ((int64_t*) NULL)
+#define UNIVERSE_OUTPUT_FRAME_NB_DEFAULT        ((uint64_t) 0   )
+#define UNIVERSE_OUTPUT_COUNT_DEFAULT           ((uint64_t) 0   )
+#define UNIVERSE_OUTPUT_CHUNK_LEN_DEFAULT       ((size_t*)  NULL)
 #define UNIVERSE_FILE_SUBSTRATE_DEFAULT         ((FILE*)    NULL)
 #define UNIVERSE_FILE_SOLVENT_DEFAULT           ((FILE*)    NULL)
+#define UNIVERSE_INPUT_HASH_DEFAULT             FNV1A_OFFSET
 #define UNIVERSE_META_MODEL_NAME_DEFAULT        ((char*)    NULL)
 #define UNIVERSE_META_MODEL_AUTHOR_DEFAULT      ((char*)    NULL)
 #define UNIVERSE_META_MODEL_COMMENT_DEFAULT     ((char*)    NULL)
@@ -58,20 +88,77 @@
 #define UNIVERSE_SOLVENT_ATOM_NB_DEFAULT        ((uint64_t) 0   )
 #define UNIVERSE_SOLVENT_BOND_NB_DEFAULT        ((uint64_t) 0   )
 #define UNIVERSE_SOLVENT_ATOM_DEFAULT           ((atom_t*)  NULL)
+#define UNIVERSE_SOLVENT_COPY_NB_DEFAULT        ((uint64_t) 0   )
 #define UNIVERSE_ATOM_DEFAULT                   ((atom_t*)  NULL)
 #define UNIVERSE_COPY_NB_DEFAULT                ((uint64_t) 0   )
 #define UNIVERSE_ATOM_NB_DEFAULT                ((uint64_t) 0   )
 #define UNIVERSE_ITERATIONS_DEFAULT             ((uint64_t) 0   )
 #define UNIVERSE_SIZE_DEFAULT                   ((double)   0.0 )
 #define UNIVERSE_TIME_DEFAULT                   ((double)   0.0 )
+#define UNIVERSE_TIMESTEP_DEFAULT               ((double)   0.0 )
+#define UNIVERSE_FRAME_TIME_DEFAULT             ((double)   0.0 )
 #define UNIVERSE_TEMPERATURE_DEFAULT            ((double)   0.0 )
 #define UNIVERSE_PRESSURE_DEFAULT               ((double)   0.0 )
+#define UNIVERSE_LAMBDA_DEFAULT                 ((double)   1.0 )
+#define UNIVERSE_POTENTIAL_DEFAULT              ((double)   0.0 )
+#define UNIVERSE_POTENTIAL_FRESH_DEFAULT        ((uint8_t)  0   )
+#define UNIVERSE_STREAM_NB_DEFAULT              ((uint64_t) 0   )
+#define UNIVERSE_STREAM_DEFAULT                 ((stream_t*) NULL)
+#define UNIVERSE_RNG_DEFAULT                    ((rng_t*)   NULL)
+#define UNIVERSE_CONSTRAINT_NB_DEFAULT          ((uint64_t) 0   )
+#define UNIVERSE_CONSTRAINT_DEFAULT             ((constraint_t*) NULL)
+#define UNIVERSE_CLUSTER_NB_DEFAULT             ((uint64_t) 0   )
+#define UNIVERSE_CLUSTER_DEFAULT                ((uint64_t*) NULL)
+#define UNIVERSE_SETTLE_NB_DEFAULT              ((uint64_t) 0   )
+#define UNIVERSE_SETTLE_DEFAULT                 ((settle_t*) NULL)
+#define UNIVERSE_CONSTRAINT_REF_DEFAULT         ((vec3_t*)  NULL)
+
+/* t_nhc */
+#define NHC_POS_DEFAULT   ((double)0.0)
+#define NHC_VEL_DEFAULT   ((double)0.0)
+#define NHC_MASS_DEFAULT  ((double)0.0)
+#define NHC_DOF_DEFAULT   ((double)0.0)
+#define NHC_SCALE_DEFAULT ((double)1.0)
+
+/* t_writer */
+#define WRITER_SLOT_NB_DEFAULT ((uint64_t) 0)
+#define WRITER_SLOT_DEFAULT    ((frame_t*) NULL)
+#define WRITER_HEAD_DEFAULT    ((uint64_t) 0)
+#define WRITER_TAIL_DEFAULT    ((uint64_t) 0)
+#define WRITER_RUNNING_DEFAULT ((uint8_t)  0)
+#define WRITER_STOP_DEFAULT    ((uint8_t)  0)
+#define WRITER_ERR_DEFAULT     ((uint8_t)  0)
+
+/* t_watchdog */
+#define WATCHDOG_SAMPLED_DEFAULT      ((uint8_t)  0)
+#define WATCHDOG_FRC_MAX_DEFAULT      ((double)   0.0)
+#define WATCHDOG_NONFINITE_NB_DEFAULT ((uint64_t) 0)
+#define WATCHDOG_ENERGY_DEFAULT       ((double)   0.0)
+#define WATCHDOG_EK_DEFAULT           ((double)   0.0)
+#define WATCHDOG_ATOM_DEFAULT         ((atom_t*)  NULL)
+#define WATCHDOG_RNG_DEFAULT          ((rng_t*)   NULL)
+#define WATCHDOG_OUTPUT_POS_DEFAULT   ((long)     0)
+#define WATCHDOG_OUTPUT_COUNT_DEFAULT ((uint64_t) 0)
+#define WATCHDOG_STREAM_DEFAULT       ((stream_mark_t*) NULL)
+
+/* t_checkpoint */
+#define CHECKPOINT_PATH_DEFAULT        ((char*)    NULL)
+#define CHECKPOINT_RUNNING_DEFAULT     ((uint8_t)  0)
+#define CHECKPOINT_DONE_DEFAULT        ((uint8_t)  0)
+#define CHECKPOINT_ERR_DEFAULT         ((uint8_t)  0)
+#define CHECKPOINT_WRITER_HEAD_DEFAULT ((uint64_t) 0)
+#define CHECKPOINT_ATOM_DEFAULT        ((atom_t*)  NULL)
+#define CHECKPOINT_RNG_NB_DEFAULT      ((uint64_t) 0)
+#define CHECKPOINT_RNG_DEFAULT         ((rng_t*)   NULL)
+#define CHECKPOINT_STREAM_NB_DEFAULT   ((uint64_t) 0)
+#define CHECKPOINT_STREAM_DEFAULT      ((stream_mark_t*) NULL)
 
 typedef struct atom_s atom_t;
 struct atom_s
 {
   /* MISC. INFORMATION */
   uint64_t element;      /* Chemical element (as defined in model.h) */
+  double mass;           /* (kg) Mass, the element's unless repartitioned */
 
   /* BONDS */
   uint8_t bond_nb;       /* Number of covalent bonds */
@@ -88,6 +175,184 @@ struct atom_s
   vec3_t vel;            /* Velocity */
   vec3_t acc;            /* Acceleration */
   vec3_t frc;            /* Force */
+  vec3_t acc_slow;       /* Acceleration from the nonbonded forces, with r-RESPA */
+  vec3_t frc_slow;       /* Nonbonded force, with r-RESPA */
+  double pot;            /* (J) Potential energy, as of the last force update that asked for it */
+  mat3_t vir;            /* (J) Share of the virial tensor, as of the last force update that asked for it */
+};
+
+/*
+ * The state of a Nose-Hoover chain is a handful of doubles, and holds no
+ * pointers so that it can be saved and restored with a plain copy.
+ *
+ */
+typedef struct nhc_s nhc_t;
+struct nhc_s
+{
+  double pos[NHC_CHAIN_LENGTH];  /* (unitless) Thermostat positions */
+  double vel[NHC_CHAIN_LENGTH];  /* (s-1)      Thermostat velocities */
+  double mass[NHC_CHAIN_LENGTH]; /* (J.s2)     Thermostat masses */
+  double dof;                    /* (unitless) Degrees of freedom coupled to the first thermostat */
+  double scale;                  /* (unitless) Velocity scaling left for the next half kick */
+};
+
+/* A frame, as it is saved to the output file */
+typedef struct frame_s frame_t;
+struct frame_s
+{
+  uint64_t iterations; /* Iterations rendered before the frame */
+  double time;         /* (s) Simulated time */
+  double size;         /* (m) Length of the universe's side */
+  vec3_t *pos;         /* Position of each atom */
+};
+
+/*
+ * The frames are copied into a ring of slots, from which they are saved in
+ * order. With --async, a thread of its own saves them, and the simulation only
+ * waits for it when the ring is full. Otherwise, the ring has a single slot,
+ * which is saved at once.
+ *
+ */
+typedef struct writer_s writer_t;
+struct writer_s
+{
+  uint64_t slot_nb;      /* Number of slots in the ring */
+  frame_t *slot;         /* The ring */
+  uint64_t head;         /* Frames copied into the ring so far */
+  uint64_t tail;         /* Frames saved so far */
+  uint8_t running;       /* Whether the thread was started */
+  uint8_t stop;          /* Tells the thread to stop once the ring is empty */
+  uint8_t err;           /* Whether the thread failed to save a frame */
+  const args_t *args;    /* Arguments the thread saves the frames with */
+  pthread_t thread;      /* The thread saving the frames */
+  pthread_mutex_t mutex; /* Guards head, tail, stop and err */
+  pthread_cond_t filled; /* Signalled when a frame is copied into the ring */
+  pthread_cond_t freed;  /* Signalled when a frame is saved, or the thread fails */
+};
+
+/* Where an output stream stood, for the frames saved after to be cut off */
+typedef struct stream_mark_s stream_mark_t;
+struct stream_mark_s
+{
+  int64_t pos;           /* Length of the stream's file */
+  double frame_time;     /* (s) Time of the stream's next frame */
+};
+
+/*
+ * The watchdog's samples come from the force update that closes a step, and
+ * its snapshot holds everything a step changes, so that the universe can be
+ * taken back to the last good sample. The atoms' bond arrays never change
+ * during the simulation, so the snapshot shares them with the universe.
+ *
+ */
+typedef struct watchdog_s watchdog_t;
+struct watchdog_s
+{
+  uint8_t sampled;       /* Whether the last force update sampled the universe */
+  double frc_max;        /* (N) Largest force, as of the last sample */
+  uint64_t nonfinite_nb; /* Atoms whose position or force isn't finite, as of the last sample */
+  double energy;         /* (J) Total energy at the last good sample */
+  double ek;             /* (J) Kinetic energy at the last good sample */
+
+  /* SNAPSHOT OF THE LAST GOOD SAMPLE */
+  atom_t *atom;          /* The atoms */
+  rng_t *rng;            /* The Langevin random streams */
+  nhc_t nhc;             /* The Nose-Hoover chain */
+  uint64_t iterations;   /* Iterations rendered so far */
+  double size;           /* (m) Side of the universe */
+  double time;           /* (s) Simulated time */
+  double timestep;       /* (s) Timestep */
+  double frame_time;     /* (s) Time of the next frame to save */
+  double potential;      /* (J) Potential energy */
+  mat3_t virial;         /* (J) Virial tensor */
+  long output_pos;       /* Length of the .xyz file */
+  uint64_t output_count; /* Frames saved to the output file */
+  stream_mark_t *stream; /* Where the output streams stood */
+};
+
+/*
+ * A checkpoint is a copy of everything a step changes, taken between two steps
+ * and saved by a thread of its own while the simulation goes on. When a run
+ * is restarted, the checkpoint is loaded into the same copy, which is handed
+ * back to the universe once the simulation is set up.
+ *
+ */
+typedef struct checkpoint_s checkpoint_t;
+struct checkpoint_s
+{
+  const char *path;      /* Where the copy is saved */
+  uint8_t running;       /* Whether the thread was started, and not joined yet */
+  uint8_t done;          /* Whether the thread is done saving the copy */
+  uint8_t err;           /* Whether the thread failed to save the copy */
+  pthread_t thread;      /* The thread saving the copy */
+  pthread_mutex_t mutex; /* Guards done and err */
+  uint64_t writer_head;  /* Frames the writer has to save before the copy is */
+
+  /* COPY OF THE UNIVERSE */
+  atom_t *atom;          /* The atoms */
+  uint64_t rng_nb;       /* Number of Langevin random streams */
+  rng_t *rng;            /* The Langevin random streams */
+  nhc_t nhc;             /* The Nose-Hoover chain */
+  uint64_t iterations;   /* Iterations rendered so far */
+  double size;           /* (m) Side of the universe */
+  double time;           /* (s) Simulated time */
+  double timestep;       /* (s) Timestep */
+  double frame_time;     /* (s) Time of the next frame to save */
+  uint64_t output_count; /* Frames saved to the output file */
+  uint64_t stream_nb;    /* Number of output streams */
+  stream_mark_t *stream; /* Where the output streams stood */
+};
+
+/*
+ * An output stream saves the atoms it selected, or the energies, to a file of
+ * its own, every few steps or every so much simulated time. The energies are
+ * only saved when an outer r-RESPA step closes, as the potential energy needs
+ * every force; the force update that closes the step sums it when a stream is
+ * about to need it.
+ *
+ */
+typedef struct stream_s stream_t;
+struct stream_s
+{
+  char *path;            /* Path to the stream's file */
+  FILE *file;            /* The stream's file */
+  uint8_t format;        /* OUTPUT_FORMAT_XYZ, OUTPUT_FORMAT_SXB or OUTPUT_FORMAT_ENERGY */
+  uint64_t every;        /* (unitless) Steps between two frames, 0 if the interval is a time */
+  double interval;       /* (s) Simulated time between two frames, 0 if the interval is in steps */
+  double frame_time;     /* (s) Time of the next frame, if the interval is a time */
+  uint64_t atom_nb;      /* Number of atoms selected */
+  uint64_t *atom;        /* The atoms selected, in the universe's order */
+  void *frame;           /* Coordinates of a binary frame, as written */
+};
+
+#define STREAM_PATH_DEFAULT       ((char*)       NULL)
+#define STREAM_FILE_DEFAULT       ((FILE*)       NULL)
+#define STREAM_FORMAT_DEFAULT     OUTPUT_FORMAT_XYZ
+#define STREAM_EVERY_DEFAULT      ((uint64_t)    0)
+#define STREAM_INTERVAL_DEFAULT   ((double)      0.0)
+#define STREAM_FRAME_TIME_DEFAULT ((double)      0.0)
+#define STREAM_ATOM_NB_DEFAULT    ((uint64_t)    0)
+#define STREAM_ATOM_DEFAULT       ((uint64_t*)   NULL)
+#define STREAM_FRAME_DEFAULT      ((void*)       NULL)
+
+/* A bond whose length is held constant by SHAKE/RATTLE */
+typedef struct constraint_s constraint_t;
+struct constraint_s
+{
+  uint64_t a1;   /* The atom the hydrogen is bound to */
+  uint64_t a2;   /* The hydrogen */
+  double length; /* (m) Length of the bond */
+};
+
+/* A water held rigid by SETTLE */
+typedef struct settle_s settle_t;
+struct settle_s
+{
+  uint64_t o;    /* The oxygen */
+  uint64_t h1;   /* The first hydrogen */
+  uint64_t h2;   /* The second hydrogen */
+  double dst_oh; /* (m) Length of the O-H bonds */
+  double dst_hh; /* (m) Distance between the hydrogens */
 };
 
 typedef struct universe_s universe_t;
@@ -95,9 +360,22 @@ struct universe_s
 {
   /* MISC. INFORMATION */
   FILE *file_model;             /* The model file (.mdm) */
-  FILE *file_output;            /* The output file (.xyz) */
+  FILE *file_output;            /* The output file (.xyz or .sxb) */
+  uint8_t output_format;        /* OUTPUT_FORMAT_* */
+  char *output_buffer;          /* Buffer of the output file */
+  void *output_frame;           /* Coordinates of a binary frame, or text of an .xyz frame, as written */
+  int64_t *output_ref;          /* Rounded coordinates of the last compressed frame */
+  int64_t *output_quant;        /* Rounded coordinates of the current compressed frame */
+  uint64_t output_frame_nb;     /* Compressed frames since the last keyframe, 0 for a keyframe next */
+  uint64_t output_count;        /* Frames saved to the output file so far */
+  size_t *output_chunk_len;     /* Length of each chunk of an .xyz frame */
+  writer_t writer;              /* Saves the frames to the output file */
+  uint64_t stream_nb;           /* Number of output streams */
+  stream_t *stream;             /* Save selections of the atoms, or the energies, to files of their own */
+  live_t live;                  /* Publishes the frames to other processes */
   FILE *file_substrate;         /* The substrate file (.mds) */
   FILE *file_solvent;           /* The solvent file (.mds) */
+  uint64_t input_hash;          /* Hash of the contents of the model, substrate and solvent files */
 
   /* MODEL METADATA */
   char *meta_model_name;        /* The name of the model */
@@ -127,7 +405,8 @@ struct universe_s
   uint64_t solvent_atom_nb;     /* The number of atom in the solvent */
   uint64_t solvent_bond_nb;     /* The number of covalent bonds in the solvent */
   atom_t *solvent_atom;         /* The solvent atoms as loaded from the file */
-  
+  uint64_t solvent_copy_nb;     /* Number of copies of the solvent inserted around the substrate */
+
   /* UNIVERSE */
   atom_t *atom;                 /* The universe (set of all atoms) to simulate */
   uint64_t copy_nb;             /* Number of copies of the substrate to simulate */
@@ -137,8 +416,28 @@ struct universe_s
   /* PARAMETERS & THERMODYNAMICS */
   double size;                  /* (m) The universe is a cube, that's how long a side is */
   double time;                  /* (s) Current time */
+  double timestep;              /* (s) Current timestep */
+  double frame_time;            /* (s) Time of the next frame to save */
   double temperature;           /* (K) Initial thermodynamic temperature */
   double pressure;              /* (Pa) Initial pressure */
+  double lambda;                /* Soft-core coupling of the nonbonded potentials (1.0 = real potentials) */
+  double potential;             /* (J) Potential energy, as of the last force update that asked for it */
+  uint8_t potential_fresh;      /* Whether the potential energy is the one at the current positions */
+  mat3_t virial;                /* (J) Virial tensor, as of the last force update that asked for it */
+  rng_t *rng;                   /* One random stream per thread, for the Langevin thermostat */
+  nhc_t nhc;                    /* Nose-Hoover chain thermostat */
+  watchdog_t watchdog;          /* Blow-up detection */
+  checkpoint_t checkpoint;      /* Copy of the universe to save, or restarted from */
+
+  /* CONSTRAINTS */
+  uint64_t constraint_nb;       /* Number of bonds held by SHAKE/RATTLE */
+  constraint_t *constraint;     /* The bonds held by SHAKE/RATTLE, grouped by cluster */
+  uint64_t cluster_nb;          /* Number of independent clusters of constraints */
+  uint64_t *cluster;            /* Index of the first constraint of each cluster, then of the end of the last one */
+  uint64_t settle_nb;           /* Number of waters held rigid by SETTLE */
+  settle_t *settle;             /* The waters held rigid by SETTLE */
+  vec3_t *constraint_ref;       /* The atoms' positions before the last drift */
+  mat3_t constraint_virial;     /* (J) Virial of the constraint forces, as of the last drift */
 };
 
 /* ################## */
@@ -147,14 +446,19 @@ struct universe_s
 /* The following functions operate on the atom_s structure */
 void        atom_init(atom_t *atom);
 void        atom_clean(atom_t *atom);
+atom_t     *atom_duplicate(atom_t *dest, const atom_t *reference, const uint64_t id_offset);
 int         atom_is_bonded(universe_t *universe, const uint64_t a1, const uint64_t a2);
 universe_t *atom_update_frc_numerical(universe_t *universe, const uint64_t atom_id);
 universe_t *atom_update_frc_numerical_tetrahedron(universe_t *universe, const uint64_t atom_id);
-universe_t *atom_update_frc_analytical(universe_t *universe, const uint64_t atom_id);
+universe_t *atom_update_frc_analytical(universe_t *universe, const uint64_t atom_id, const uint8_t request);
 universe_t *atom_update_acc(universe_t *universe, const uint64_t atom_id);
-universe_t *atom_update_vel(universe_t *universe, const args_t *args, const uint64_t atom_id);
-universe_t *atom_update_pos(universe_t *universe, const args_t *args, uint64_t atom_id);
+universe_t *atom_update_vel(universe_t *universe, const uint64_t atom_id, const double scale, double *ek);
+universe_t *atom_update_vel_slow(universe_t *universe, const args_t *args, const uint64_t atom_id);
+universe_t *atom_update_pos(universe_t *universe, uint64_t atom_id);
+universe_t *atom_update_langevin(universe_t *universe, const args_t *args, const uint64_t atom_id, rng_t *rng);
 universe_t *atom_enforce_pbc(universe_t *universe, const uint64_t atom_id);
+vec3_t     *atom_pbc_vector(vec3_t *dest, const universe_t *universe, const uint64_t from, const uint64_t to);
+vec3_t     *atom_pbc_vector_pos(vec3_t *dest, const universe_t *universe, const vec3_t *from, const vec3_t *to);
 
 /* ###################### */
 /* # UNIVERSE FUNCTIONS # */
@@ -163,19 +467,67 @@ universe_t *atom_enforce_pbc(universe_t *universe, const uint64_t atom_id);
 universe_t *universe_init(universe_t *universe, const args_t *args);
 void        universe_clean(universe_t *universe);
 universe_t *universe_populate(universe_t *universe);
+universe_t *universe_solvate(universe_t *universe, const args_t *args);
 universe_t *universe_setvelocity(universe_t *universe);
-universe_t *universe_load_model(universe_t *universe, char *model_file_buffer);
-universe_t *universe_load_substrate(universe_t *universe, char *substrate_file_buffer);
-universe_t *universe_load_solvent(universe_t *universe, char *solvent_file_buffer);
-universe_t *universe_printstate(universe_t *universe);
+universe_t *universe_load_model(universe_t *universe, const input_t *input);
+universe_t *universe_load_substrate(universe_t *universe, const input_t *input);
+universe_t *universe_load_solvent(universe_t *universe, const input_t *input);
+universe_t *universe_hmr(universe_t *universe, const args_t *args);
+universe_t *universe_printstate(universe_t *universe, const args_t *args);
 int         universe_simulate(universe_t *universe, const args_t *args);
 universe_t *universe_iterate(universe_t *universe, const args_t *args);
+universe_t *universe_update_frc(universe_t *universe, const args_t *args, const uint8_t request);
 universe_t *universe_energy_kinetic(universe_t *universe, double *energy);
 universe_t *universe_energy_potential(universe_t *universe, double *energy);
 universe_t *universe_energy_total(universe_t *universe, double *energy);
 universe_t *universe_reducepot(universe_t *universe, args_t *args);
+universe_t *universe_reducepot_softcore(universe_t *universe, double *step);
+universe_t *universe_reducepot_rigid(universe_t *universe, double *step);
 universe_t *universe_reducepot_coarse(universe_t *universe);
+universe_t *universe_reducepot_coarse_parallel(universe_t *universe);
 universe_t *universe_reducepot_fine(universe_t *universe);
 universe_t *universe_parameters_print(universe_t *universe, const args_t *args);
+universe_t *universe_traj_init(universe_t *universe, const args_t *args);
+universe_t *universe_traj_header(universe_t *universe, const args_t *args);
+universe_t *universe_traj_resume(universe_t *universe, const args_t *args);
+universe_t *universe_traj_write(universe_t *universe, const args_t *args, const frame_t *state);
+universe_t *universe_xyz_init(universe_t *universe);
+universe_t *universe_xyz_write(universe_t *universe, const frame_t *state);
+universe_t *universe_writer_init(universe_t *universe, const args_t *args);
+universe_t *universe_writer_push(universe_t *universe, const args_t *args);
+universe_t *universe_writer_sync(universe_t *universe);
+universe_t *universe_writer_clean(universe_t *universe);
+universe_t *universe_frame_write(universe_t *universe, const args_t *args, const frame_t *state);
+universe_t *universe_cache_load(universe_t *universe, const args_t *args, int *hit);
+universe_t *universe_cache_store(universe_t *universe, const args_t *args);
+universe_t *universe_system_load(universe_t *universe, const args_t *args, int *hit);
+universe_t *universe_system_store(universe_t *universe, const args_t *args);
+universe_t *universe_nhc_init(universe_t *universe, const args_t *args);
+universe_t *universe_nhc_propagate(universe_t *universe, const args_t *args, double ek);
+universe_t *universe_barostat(universe_t *universe, const args_t *args, const double ek, const double dt);
+universe_t *universe_timestep_init(universe_t *universe, const args_t *args);
+universe_t *universe_timestep_adapt(universe_t *universe, const args_t *args, const double vel_max, const double acc_max);
+universe_t *universe_watchdog_init(universe_t *universe, const args_t *args);
+universe_t *universe_watchdog_check(universe_t *universe, const args_t *args);
+universe_t *universe_checkpoint_init(universe_t *universe, const args_t *args);
+universe_t *universe_checkpoint_save(universe_t *universe, const args_t *args);
+universe_t *universe_checkpoint_sync(universe_t *universe);
+universe_t *universe_checkpoint_load(universe_t *universe, const args_t *args);
+universe_t *universe_checkpoint_resume(universe_t *universe, const args_t *args);
+void        universe_checkpoint_clean(universe_t *universe);
+universe_t *universe_streams_init(universe_t *universe, const args_t *args);
+int         universe_streams_due(const universe_t *universe, const args_t *args, const uint64_t iterations, const double time, const uint8_t format);
+universe_t *universe_streams_write(universe_t *universe, const args_t *args);
+universe_t *universe_streams_mark(universe_t *universe, stream_mark_t *mark);
+universe_t *universe_streams_rewind(universe_t *universe, const stream_mark_t *mark);
+void        universe_streams_clean(universe_t *universe);
+universe_t *universe_traj_stream_header(universe_t *universe, const args_t *args, const stream_t *stream);
+universe_t *universe_traj_stream_write(universe_t *universe, const args_t *args, const stream_t *stream);
+universe_t *universe_live_init(universe_t *universe, const args_t *args);
+universe_t *universe_live_publish(universe_t *universe, const args_t *args);
+void        universe_live_clean(universe_t *universe);
+universe_t *universe_constraint_init(universe_t *universe, const args_t *args);
+universe_t *universe_constrain_pos(universe_t *universe);
+universe_t *universe_constrain_vel(universe_t *universe);
 
 #endif
@@ -9,6 +9,8 @@
 #define UTIL_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
 
 /* Useful constants for chemists */
 
@@ -20,6 +22,13 @@
 #define POW12(x) (POW6(x)*POW6(x))
 #define POW13(x) (x*POW12(x))
 
+/* Hashes data with the 64-bit FNV-1a function
+ * Start from FNV1A_OFFSET, and feed the result back in to hash several buffers
+ */
+#define FNV1A_OFFSET ((uint64_t) 0xCBF29CE484222325)
+#define FNV1A_PRIME  ((uint64_t) 0x00000100000001B3)
+uint64_t fnv1a(uint64_t hash, const void *data, const size_t len);
+
 /* Prints str, with extra info (__FILE__ and __LINE__) before returning ret */
 void *retstr(void *ret, const char *str, const char *file, const int line);
 int retstri(const int ret, const char *str, const char *file, const int line);
@@ -28,4 +37,10 @@ double retstrf(const double ret, const char *str, const char *file, const int li
 /* Returns the number of lines in str */
 uint64_t line_nb(const char *str);
 
+/* Writes path through fill(file, data), to path.<pid> first, then moves it
+ * in place once complete, so that path never holds a partial file.
+ * Returns 0, or -1 on failure
+ */
+int file_replace(const char *path, int (*fill)(FILE *file, const void *data), const void *data);
+
 #endif
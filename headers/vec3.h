@@ -62,6 +62,9 @@ double vec3_dot(const vec3_t *v1, const vec3_t *v2); /* Returns the dot product
 double vec3_ang(const vec3_t *v1, const vec3_t *v2); /* Returns the angle between v1 and v2 */
 double vec3_mag(const vec3_t *v);                    /* Returns the vector's magnitude */
 
+mat3_t *mat3_zero(mat3_t *m);                                     /* m = 0 */
+mat3_t *mat3_add(mat3_t *dest, const mat3_t *m1, const mat3_t *m2); /* dest = m1 + m2 */
+mat3_t *mat3_add_outer(mat3_t *dest, const vec3_t *u, const vec3_t *v, const double weight); /* dest += weight * u.v^T */
 mat3_t *mat3_transform_apply(mat3_t *m, vec3_t *v); /* Apply a transform matrix to a vector */
 mat3_t *mat3_transform_gen_rot(mat3_t *m, vec3_t *axis, const double angle); /* Generates a random rotation transform matrix */
 
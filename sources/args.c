@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "config.h"
 #include "args.h"
@@ -27,6 +28,7 @@ args_t *args_init(args_t *args)
   args->path_out = ARGS_PATH_OUT_DEFAULT;
   args->path_solvent = ARGS_PATH_SOLVENT_DEFAULT;
   args->path_model = ARGS_PATH_MODEL_DEFAULT;
+  args->path_cache = ARGS_PATH_CACHE_DEFAULT;
   args->numerical = ARGS_NUMERICAL_DEFAULT;
   args->timestep = ARGS_TIMESTEP_DEFAULT;
   args->max_time = ARGS_MAX_TIME_DEFAULT;
@@ -34,8 +36,32 @@ args_t *args_init(args_t *args)
   args->copies = ARGS_COPIES_DEFAULT;
   args->pressure = ARGS_PRESSURE_DEFAULT;
   args->density = ARGS_DENSITY_DEFAULT;
+  args->solvent_density = ARGS_SOLVENT_DENSITY_DEFAULT;
   args->frameskip = ARGS_FRAMESKIP_DEFAULT;
   args->reduce_potential = ARGS_REDUCE_POTENTIAL_DEFAULT;
+  args->softcore = ARGS_SOFTCORE_DEFAULT;
+  args->rigid = ARGS_RIGID_DEFAULT;
+  args->parallel_coarse = ARGS_PARALLEL_COARSE_DEFAULT;
+  args->langevin = ARGS_LANGEVIN_DEFAULT;
+  args->nose_hoover = ARGS_NOSE_HOOVER_DEFAULT;
+  args->berendsen = ARGS_BERENDSEN_DEFAULT;
+  args->respa = ARGS_RESPA_DEFAULT;
+  args->shake = ARGS_SHAKE_DEFAULT;
+  args->settle = ARGS_SETTLE_DEFAULT;
+  args->hmr = ARGS_HMR_DEFAULT;
+  args->adaptive = ARGS_ADAPTIVE_DEFAULT;
+  args->watchdog = ARGS_WATCHDOG_DEFAULT;
+  args->rollback = ARGS_ROLLBACK_DEFAULT;
+  args->traj_double = ARGS_DOUBLE_DEFAULT;
+  args->precision = ARGS_PRECISION_DEFAULT;
+  args->async = ARGS_ASYNC_DEFAULT;
+  args->path_checkpoint = ARGS_PATH_CHECKPOINT_DEFAULT;
+  args->checkpoint_interval = ARGS_CHECKPOINT_INTERVAL_DEFAULT;
+  args->path_restart = ARGS_PATH_RESTART_DEFAULT;
+  args->resume = ARGS_RESUME_DEFAULT;
+  args->max_walltime = ARGS_MAX_WALLTIME_DEFAULT;
+  args->path_live = ARGS_PATH_LIVE_DEFAULT;
+  args->stream_nb = ARGS_STREAM_NB_DEFAULT;
   args->srand_seed = time(NULL);
   return (args);
 }
@@ -103,12 +129,91 @@ args_t *args_check(args_t *args)
     return (retstr(NULL, TEXT_ARGS_DENSITY_FAILURE, __FILE__, __LINE__));
   }
 
+  /* Same goes for the solvent */
+  if (args->solvent_density <= 0.0)
+  {
+    return (retstr(NULL, TEXT_ARGS_SOLVENT_DENSITY_FAILURE, __FILE__, __LINE__));
+  }
+
   /* A negative potential has no meaning here */
   if (args->reduce_potential <= 0.0)
   {
     return (retstr(NULL, TEXT_ARGS_REDUCEPOT_FAILURE, __FILE__, __LINE__));
   }
 
+  /* Friction can only take energy away */
+  if (args->langevin < 0.0)
+  {
+    return (retstr(NULL, TEXT_ARGS_LANGEVIN_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* A thermostat's time constant must be positive, and only one thermostat can be used */
+  if (args->nose_hoover < 0.0 || (args->nose_hoover > 0.0 && args->langevin > 0.0))
+  {
+    return (retstr(NULL, TEXT_ARGS_NOSE_HOOVER_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The barostat needs the virial, which only the analytical forces provide */
+  if (args->berendsen < 0.0 || (args->berendsen > 0.0 && args->numerical != MODE_ANALYTICAL))
+  {
+    return (retstr(NULL, TEXT_ARGS_BERENDSEN_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Splitting the forces requires them to be analytical */
+  if (args->respa < 1 || (args->respa > 1 && args->numerical != MODE_ANALYTICAL))
+  {
+    return (retstr(NULL, TEXT_ARGS_RESPA_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The hydrogens can only be made heavier */
+  if (args->hmr < 0.0)
+  {
+    return (retstr(NULL, TEXT_ARGS_HMR_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The adaptive timestep is bounded by a displacement */
+  if (args->adaptive < 0.0)
+  {
+    return (retstr(NULL, TEXT_ARGS_ADAPTIVE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The coordinates are rounded to multiples of the precision */
+  if (args->precision <= 0.0)
+  {
+    return (retstr(NULL, TEXT_ARGS_PRECISION_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The watchdog samples the universe when every force is up to date, and can only roll back to its samples */
+  if ((args->watchdog % args->respa) != 0 || (args->rollback && args->watchdog == 0))
+  {
+    return (retstr(NULL, TEXT_ARGS_WATCHDOG_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* A checkpoint is taken when every force is up to date, as the restarted run expects them */
+  if (args->checkpoint_interval < 1 || (args->checkpoint_interval % args->respa) != 0)
+  {
+    return (retstr(NULL, TEXT_ARGS_CHECKPOINT_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* A run can only be resumed from its checkpoint file */
+  if (args->max_walltime < 0.0 || (args->resume && args->path_checkpoint == ARGS_PATH_CHECKPOINT_DEFAULT))
+  {
+    return (retstr(NULL, TEXT_ARGS_RESUME_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The streams are only read once the universe is built, which they select atoms from */
+  if (args->stream_nb > STREAM_NB_MAX)
+  {
+    return (retstr(NULL, TEXT_ARGS_STREAM_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The portable names of shared memory objects are a slash followed by a file name */
+  if (args->path_live != ARGS_PATH_LIVE_DEFAULT
+      && (args->path_live[0] != '/' || args->path_live[1] == '\0' || strchr(args->path_live + 1, '/') != NULL))
+  {
+    return (retstr(NULL, TEXT_ARGS_LIVE_FAILURE, __FILE__, __LINE__));
+  }
+
   return (args);
 }
 
@@ -171,6 +276,11 @@ args_t *args_parse(args_t *args, int argc, char **argv)
       args->density = atof(argv[++i]);
     }
 
+    else if (!strcmp(argv[i], FLAG_SOLVENT_DENSITY) && (i+1)<argc)
+    {
+      args->solvent_density = atof(argv[++i]);
+    }
+
     else if (!strcmp(argv[i], FLAG_FRAMESKIP) && (i+1)<argc)
     {
       args->frameskip = strtoul(argv[++i], NULL, 10);
@@ -181,6 +291,131 @@ args_t *args_parse(args_t *args, int argc, char **argv)
       args->reduce_potential = atof(argv[++i]);
     }
 
+    else if (!strcmp(argv[i], FLAG_SOFTCORE))
+    {
+      args->softcore = 1;
+    }
+
+    else if (!strcmp(argv[i], FLAG_RIGID))
+    {
+      args->rigid = 1;
+    }
+
+    else if (!strcmp(argv[i], FLAG_PARALLEL_COARSE))
+    {
+      args->parallel_coarse = 1;
+    }
+
+    else if (!strcmp(argv[i], FLAG_CACHE) && (i+1)<argc)
+    {
+      args->path_cache = argv[++i];
+    }
+
+    else if (!strcmp(argv[i], FLAG_LANGEVIN) && (i+1)<argc)
+    {
+      args->langevin = atof(argv[++i]);
+    }
+
+    else if (!strcmp(argv[i], FLAG_NOSE_HOOVER) && (i+1)<argc)
+    {
+      args->nose_hoover = atof(argv[++i]);
+    }
+
+    else if (!strcmp(argv[i], FLAG_BERENDSEN) && (i+1)<argc)
+    {
+      args->berendsen = atof(argv[++i]);
+    }
+
+    else if (!strcmp(argv[i], FLAG_RESPA) && (i+1)<argc)
+    {
+      args->respa = strtoul(argv[++i], NULL, 10);
+    }
+
+    else if (!strcmp(argv[i], FLAG_SHAKE))
+    {
+      args->shake = 1;
+    }
+
+    else if (!strcmp(argv[i], FLAG_SETTLE))
+    {
+      args->settle = 1;
+    }
+
+    else if (!strcmp(argv[i], FLAG_HMR) && (i+1)<argc)
+    {
+      args->hmr = atof(argv[++i]);
+    }
+
+    else if (!strcmp(argv[i], FLAG_ADAPTIVE) && (i+1)<argc)
+    {
+      args->adaptive = atof(argv[++i]);
+    }
+
+    else if (!strcmp(argv[i], FLAG_WATCHDOG) && (i+1)<argc)
+    {
+      args->watchdog = strtoul(argv[++i], NULL, 10);
+    }
+
+    else if (!strcmp(argv[i], FLAG_ROLLBACK))
+    {
+      args->rollback = 1;
+    }
+
+    else if (!strcmp(argv[i], FLAG_DOUBLE))
+    {
+      args->traj_double = 1;
+    }
+
+    else if (!strcmp(argv[i], FLAG_PRECISION) && (i+1)<argc)
+    {
+      args->precision = atof(argv[++i]);
+    }
+
+    else if (!strcmp(argv[i], FLAG_ASYNC))
+    {
+      args->async = 1;
+    }
+
+    else if (!strcmp(argv[i], FLAG_CHECKPOINT) && (i+1)<argc)
+    {
+      args->path_checkpoint = argv[++i];
+    }
+
+    else if (!strcmp(argv[i], FLAG_CHECKPOINT_INTERVAL) && (i+1)<argc)
+    {
+      args->checkpoint_interval = strtoul(argv[++i], NULL, 10);
+    }
+
+    else if (!strcmp(argv[i], FLAG_RESTART) && (i+1)<argc)
+    {
+      args->path_restart = argv[++i];
+    }
+
+    else if (!strcmp(argv[i], FLAG_RESUME))
+    {
+      args->resume = 1;
+    }
+
+    else if (!strcmp(argv[i], FLAG_MAX_WALLTIME) && (i+1)<argc)
+    {
+      args->max_walltime = atof(argv[++i]);
+    }
+
+    else if (!strcmp(argv[i], FLAG_LIVE) && (i+1)<argc)
+    {
+      args->path_live = argv[++i];
+    }
+
+    else if (!strcmp(argv[i], FLAG_STREAM) && (i+1)<argc)
+    {
+      if (args->stream_nb < STREAM_NB_MAX)
+      {
+        args->stream[args->stream_nb] = argv[i+1];
+      }
+      ++(args->stream_nb);
+      ++i;
+    }
+
     else if (!strcmp(argv[i], FLAG_MODEL) && (i+1)<argc)
     {
       args->path_model = argv[++i];
@@ -202,7 +437,14 @@ args_t *args_parse(args_t *args, int argc, char **argv)
   args->max_time *= 1E-9;          /* Scale from ns to s */
   args->timestep *= 1E-15;         /* Scale from fs to s */
   args->pressure *= 1E2;           /* Scale from mbar to Pa */
+  args->langevin *= 1E12;          /* Scale from ps-1 to s-1 */
+  args->nose_hoover *= 1E-12;      /* Scale from ps to s */
+  args->berendsen *= 1E-12;        /* Scale from ps to s */
+  args->hmr *= C_DALTON;           /* Scale from u to kg */
+  args->adaptive *= 1E-10;         /* Scale from Å to m */
+  args->precision *= 1E-10;        /* Scale from Å to m */
   args->density  *= 1E3;           /* Scale from g.cm-1 to kg.m-1 */
+  args->solvent_density *= 1E3;    /* Scale from g.cm-1 to kg.m-1 */
   args->reduce_potential *= 1E-12; /* Scale from pJ to J */
 
   if (args_check(args) == NULL)
@@ -210,5 +452,11 @@ args_t *args_parse(args_t *args, int argc, char **argv)
     return (retstr(NULL, TEXT_ARGS_PARSE_FAILURE, __FILE__, __LINE__));
   }
 
+  /* A job run again with the same arguments carries on from its checkpoint, once there is one */
+  if (args->resume && args->path_restart == ARGS_PATH_RESTART_DEFAULT && access(args->path_checkpoint, F_OK) == 0)
+  {
+    args->path_restart = args->path_checkpoint;
+  }
+
   return (args);
 }
@@ -7,11 +7,13 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "config.h"
 #include "force.h"
 #include "model.h"
 #include "potential.h"
+#include "rng.h"
 #include "universe.h"
 #include "util.h"
 #include "vec3.h"
@@ -20,6 +22,7 @@
 void atom_init(atom_t *atom)
 {
   atom->element=ATOM_ELEMENT_DEFAULT;
+  atom->mass=ATOM_MASS_DEFAULT;
 
   atom->charge=ATOM_CHARGE_DEFAULT;
   atom->epsilon=ATOM_EPSILON_DEFAULT;
@@ -44,6 +47,17 @@ void atom_init(atom_t *atom)
   atom->frc.x=ATOM_FRC_X_DEFAULT;
   atom->frc.y=ATOM_FRC_Y_DEFAULT;
   atom->frc.z=ATOM_FRC_Z_DEFAULT;
+
+  atom->acc_slow.x=ATOM_ACC_X_DEFAULT;
+  atom->acc_slow.y=ATOM_ACC_Y_DEFAULT;
+  atom->acc_slow.z=ATOM_ACC_Z_DEFAULT;
+
+  atom->frc_slow.x=ATOM_FRC_X_DEFAULT;
+  atom->frc_slow.y=ATOM_FRC_Y_DEFAULT;
+  atom->frc_slow.z=ATOM_FRC_Z_DEFAULT;
+
+  atom->pot=ATOM_POT_DEFAULT;
+  mat3_zero(&(atom->vir));
 }
 
 /* Cleans an atom structure */
@@ -53,6 +67,48 @@ void atom_clean(atom_t *atom)
   free(atom->bond_strength);
 }
 
+/* Copy a reference atom into dest, shifting its bond IDs by id_offset */
+atom_t *atom_duplicate(atom_t *dest, const atom_t *reference, const uint64_t id_offset)
+{
+  size_t i;
+
+  dest->element = reference->element;
+  dest->mass = reference->mass;
+  dest->charge = reference->charge;
+  dest->epsilon = reference->epsilon;
+  dest->sigma = reference->sigma;
+
+  dest->bond_nb = reference->bond_nb;
+
+  dest->pos = reference->pos;
+  dest->vel = reference->vel;
+  dest->acc = reference->acc;
+  dest->frc = reference->frc;
+  dest->acc_slow = reference->acc_slow;
+  dest->frc_slow = reference->frc_slow;
+  dest->pot = reference->pot;
+  dest->vir = reference->vir;
+
+  /* Allocate memory for the bond information */
+  if ((dest->bond = malloc(sizeof(uint64_t)*(reference->bond_nb))) == NULL)
+  {
+    return (retstr(NULL, TEXT_ATOM_DUPLICATE_FAILURE, __FILE__, __LINE__));
+  }
+  if ((dest->bond_strength = malloc(sizeof(double)*(reference->bond_nb))) == NULL)
+  {
+    return (retstr(NULL, TEXT_ATOM_DUPLICATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Load the bond information */
+  for (i=0; i<(dest->bond_nb); ++i)
+  {
+    dest->bond[i] = reference->bond[i] + id_offset;
+    dest->bond_strength[i] = reference->bond_strength[i];
+  }
+
+  return (dest);
+}
+
 /* Get the force through numerical differentiation */
 universe_t *atom_update_frc_numerical(universe_t *universe, const uint64_t atom_id)
 {
@@ -191,14 +247,53 @@ universe_t *atom_update_frc_numerical_tetrahedron(universe_t *universe, const ui
 }
 
 /* Get the force through analytical solving */
-universe_t *atom_update_frc_analytical(universe_t *universe, const uint64_t atom_id)
+universe_t *atom_update_frc_analytical(universe_t *universe, const uint64_t atom_id, const uint8_t request)
 {
-  /* Reset the force vector */
-  universe->atom[atom_id].frc.x = ATOM_FRC_X_DEFAULT;
-  universe->atom[atom_id].frc.y = ATOM_FRC_Y_DEFAULT;
-  universe->atom[atom_id].frc.z = ATOM_FRC_Z_DEFAULT;
+  atom_t *atom;
+
+  atom = &(universe->atom[atom_id]);
+
+  /* Reset the force vectors, and whatever else was requested */
+  atom->frc.x = ATOM_FRC_X_DEFAULT;
+  atom->frc.y = ATOM_FRC_Y_DEFAULT;
+  atom->frc.z = ATOM_FRC_Z_DEFAULT;
+  atom->pot = ATOM_POT_DEFAULT;
+  mat3_zero(&(atom->vir));
+
+  if (request & UPDATE_FRC_SLOW)
+  {
+    atom->frc_slow.x = ATOM_FRC_X_DEFAULT;
+    atom->frc_slow.y = ATOM_FRC_Y_DEFAULT;
+    atom->frc_slow.z = ATOM_FRC_Z_DEFAULT;
+  }
+
+  /* Without r-RESPA, every term goes into the same force vector */
+  if (!(request & (UPDATE_FRC_FAST | UPDATE_FRC_SLOW)))
+  {
+    if (force_total(&(atom->frc),
+                    (request & UPDATE_FRC_POTENTIAL) ? &(atom->pot) : NULL,
+                    (request & UPDATE_FRC_VIRIAL) ? &(atom->vir) : NULL,
+                    universe, atom_id, FORCE_ALL) == NULL)
+    {
+      return (retstr(NULL, TEXT_ATOM_UPDATE_FRC_FAILURE, __FILE__, __LINE__));
+    }
+
+    return (universe);
+  }
+
+  /* With r-RESPA, the bonded forces go into frc, and the nonbonded ones into frc_slow if requested */
+  if (force_total(&(atom->frc),
+                  (request & UPDATE_FRC_POTENTIAL) ? &(atom->pot) : NULL,
+                  (request & UPDATE_FRC_VIRIAL) ? &(atom->vir) : NULL,
+                  universe, atom_id, FORCE_BONDED) == NULL)
+  {
+    return (retstr(NULL, TEXT_ATOM_UPDATE_FRC_FAILURE, __FILE__, __LINE__));
+  }
 
-  if (force_total(&(universe->atom[atom_id].frc), universe, atom_id) == NULL)
+  if ((request & UPDATE_FRC_SLOW) && force_total(&(atom->frc_slow),
+                                                 (request & UPDATE_FRC_POTENTIAL) ? &(atom->pot) : NULL,
+                                                 (request & UPDATE_FRC_VIRIAL) ? &(atom->vir) : NULL,
+                                                 universe, atom_id, FORCE_NONBONDED) == NULL)
   {
     return (retstr(NULL, TEXT_ATOM_UPDATE_FRC_FAILURE, __FILE__, __LINE__));
   }
@@ -209,7 +304,12 @@ universe_t *atom_update_frc_analytical(universe_t *universe, const uint64_t atom
 /* Velocity-Verlet integrator */
 universe_t *atom_update_acc(universe_t *universe, const uint64_t atom_id)
 {
-  if (vec3_div(&(universe->atom[atom_id].acc), &(universe->atom[atom_id].frc), universe->model.entry[universe->atom[atom_id].element].mass) == NULL)
+  if (vec3_div(&(universe->atom[atom_id].acc), &(universe->atom[atom_id].frc), universe->atom[atom_id].mass) == NULL)
+  {
+    return (retstr(NULL, TEXT_ATOM_UPDATE_ACC_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (vec3_div(&(universe->atom[atom_id].acc_slow), &(universe->atom[atom_id].frc_slow), universe->atom[atom_id].mass) == NULL)
   {
     return (retstr(NULL, TEXT_ATOM_UPDATE_ACC_FAILURE, __FILE__, __LINE__));
   }
@@ -217,42 +317,89 @@ universe_t *atom_update_acc(universe_t *universe, const uint64_t atom_id)
   return (universe);
 }
 
-/* Velocity-Verlet integrator */
-universe_t *atom_update_vel(universe_t *universe, const args_t *args, const uint64_t atom_id)
+/* Velocity-Verlet integrator (half kick), also returning the atom's kinetic energy */
+universe_t *atom_update_vel(universe_t *universe, const uint64_t atom_id, const double scale, double *ek)
 {
   vec3_t new_vel;
 
   /*
    * new_vel = acc*dt*0.5
+   * vel = vel*scale + new_vel
+   */
+
+  vec3_mul(&new_vel, &(universe->atom[atom_id].acc), 0.5 * universe->timestep);
+  vec3_mul(&(universe->atom[atom_id].vel), &(universe->atom[atom_id].vel), scale);
+  vec3_add(&(universe->atom[atom_id].vel), &(universe->atom[atom_id].vel), &new_vel);
+
+  *ek = 0.5 * universe->atom[atom_id].mass * vec3_dot(&(universe->atom[atom_id].vel), &(universe->atom[atom_id].vel));
+
+  return (universe);
+}
+
+/* r-RESPA outer half kick, with the nonbonded acceleration over the whole outer step */
+universe_t *atom_update_vel_slow(universe_t *universe, const args_t *args, const uint64_t atom_id)
+{
+  vec3_t new_vel;
+
+  /*
+   * new_vel = acc_slow*dt*k*0.5
    * vel += new_vel
    */
 
-  vec3_mul(&new_vel, &(universe->atom[atom_id].acc), 0.5 * args->timestep);
+  vec3_mul(&new_vel, &(universe->atom[atom_id].acc_slow), 0.5 * universe->timestep * args->respa);
   vec3_add(&(universe->atom[atom_id].vel), &(universe->atom[atom_id].vel), &new_vel);
 
   return (universe);
 }
 
-/* Velocity-Verlet integrator */
-universe_t *atom_update_pos(universe_t *universe, const args_t *args, const uint64_t atom_id)
+/* Velocity-Verlet integrator (drift, with the half-step velocity) */
+universe_t *atom_update_pos(universe_t *universe, const uint64_t atom_id)
 {
   vec3_t temp;
 
   /*
-   * new_pos = acc*dt*0.5
-   * new_pos += vel
-   * new_pos *= dt
+   * new_pos = vel*dt
    * pos += new_pos
    */
 
-  vec3_mul(&temp, &(universe->atom[atom_id].acc), args->timestep * 0.5);
-  vec3_add(&temp, &temp, &(universe->atom[atom_id].vel));
-  vec3_mul(&temp, &temp, args->timestep);
+  vec3_mul(&temp, &(universe->atom[atom_id].vel), universe->timestep);
   vec3_add(&(universe->atom[atom_id].pos), &(universe->atom[atom_id].pos), &temp);
 
   return (universe);
 }
 
+/* BAOAB Langevin integrator (drift, thermostat, drift, with the half-step velocity) */
+universe_t *atom_update_langevin(universe_t *universe, const args_t *args, const uint64_t atom_id, rng_t *rng)
+{
+  atom_t *atom;
+  double friction; /* Velocity damping over one timestep */
+  double noise;    /* Standard deviation of the velocity kick */
+  vec3_t temp;
+
+  /*
+   * pos += vel*dt/2
+   * vel = vel*exp(-gamma*dt) + sqrt((1 - exp(-2*gamma*dt))*kT/m)*R
+   * pos += vel*dt/2
+   */
+
+  atom = &(universe->atom[atom_id]);
+  friction = exp(-(args->langevin)*(universe->timestep));
+  noise = sqrt((1 - POW2(friction))*C_BOLTZMANN*(args->temperature)/atom->mass);
+
+  vec3_mul(&temp, &(atom->vel), 0.5 * universe->timestep);
+  vec3_add(&(atom->pos), &(atom->pos), &temp);
+
+  rng_gaussian(&temp, rng);
+  vec3_mul(&temp, &temp, noise);
+  vec3_mul(&(atom->vel), &(atom->vel), friction);
+  vec3_add(&(atom->vel), &(atom->vel), &temp);
+
+  vec3_mul(&temp, &(atom->vel), 0.5 * universe->timestep);
+  vec3_add(&(atom->pos), &(atom->pos), &temp);
+
+  return (universe);
+}
+
 /* Enforce the periodic boundary conditions by relocating the atom, if required */
 universe_t *atom_enforce_pbc(universe_t *universe, const uint64_t atom_id)
 {
@@ -289,6 +436,50 @@ universe_t *atom_enforce_pbc(universe_t *universe, const uint64_t atom_id)
   return (universe);
 }
 
+/* Get the vector going from one atom to the closest image of another, through the periodic boundaries */
+vec3_t *atom_pbc_vector(vec3_t *dest, const universe_t *universe, const uint64_t from, const uint64_t to)
+{
+  return (atom_pbc_vector_pos(dest, universe, &(universe->atom[from].pos), &(universe->atom[to].pos)));
+}
+
+/* Same, between two positions */
+vec3_t *atom_pbc_vector_pos(vec3_t *dest, const universe_t *universe, const vec3_t *from, const vec3_t *to)
+{
+  vec3_sub(dest, to, from);
+
+  if (dest->x > 0.5*(universe->size))
+  {
+    dest->x -= universe->size;
+  }
+
+  else if (dest->x <= -0.5*(universe->size))
+  {
+    dest->x += universe->size;
+  }
+
+  if (dest->y > 0.5*(universe->size))
+  {
+    dest->y -= universe->size;
+  }
+
+  else if (dest->y <= -0.5*(universe->size))
+  {
+    dest->y += universe->size;
+  }
+
+  if (dest->z > 0.5*(universe->size))
+  {
+    dest->z -= universe->size;
+  }
+
+  else if (dest->z <= -0.5*(universe->size))
+  {
+    dest->z += universe->size;
+  }
+
+  return (dest);
+}
+
 /* Returns 0 if a1 is not bonded to a2, returns 1 if it is bonded to a2 */
 int atom_is_bonded(universe_t *universe, const uint64_t a1, const uint64_t a2)
 {
@@ -0,0 +1,76 @@
+/*
+ * barostat.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "config.h"
+#include "args.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+#include "vec3.h"
+
+/*
+ * Berendsen barostat (Berendsen et al., 1984)
+ *
+ * The pressure is taken from the kinetic energy reduced by the closing half
+ * kick, and from the trace of the virial tensor summed by the last force
+ * update, so it costs no extra pass over the pairs. The forces are computed
+ * from the minimum image in the current universe size, so nothing has to be
+ * rebuilt after a rescale.
+ * With r-RESPA, the barostat only acts once per outer step, and dt is the
+ * length of that step.
+ */
+universe_t *universe_barostat(universe_t *universe, const args_t *args, const double ek, const double dt)
+{
+  size_t i;        /* Iterator */
+  double volume;   /* (m3) Volume of the universe */
+  double pressure; /* (Pa) Current pressure */
+  double scale;    /* Scaling factor of the lengths */
+
+  volume = POW3(universe->size);
+  if (volume < DIV_THRESHOLD)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_BAROSTAT_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* P = (2*Ek + tr(W)) / 3V, the constraint forces being part of W */
+  pressure = (2*ek + universe->virial.x0 + universe->virial.y1 + universe->virial.z2
+              + universe->constraint_virial.x0 + universe->constraint_virial.y1 + universe->constraint_virial.z2)/(3*volume);
+  if (isnan(pressure))
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_BAROSTAT_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The volume is scaled by 1 - compressibility*dt/tau*(P0 - P) */
+  scale = cbrt(1 - BAROSTAT_COMPRESSIBILITY*(dt/args->berendsen)*(args->pressure - pressure));
+
+  /* Large pressure spikes would otherwise tear the universe apart */
+  if (scale > 1 + BAROSTAT_MAX_SCALING)
+  {
+    scale = 1 + BAROSTAT_MAX_SCALING;
+  }
+  else if (scale < 1 - BAROSTAT_MAX_SCALING)
+  {
+    scale = 1 - BAROSTAT_MAX_SCALING;
+  }
+
+  /* Scale the universe and every position with it */
+  universe->size *= scale;
+#pragma omp parallel for
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    vec3_mul(&(universe->atom[i].pos), &(universe->atom[i].pos), scale);
+  }
+
+  /* The potential energy summed by the last force update was the unscaled universe's */
+  universe->potential_fresh = 0;
+
+  return (universe);
+}
@@ -0,0 +1,248 @@
+/*
+ * cache.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "args.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+#include "vec3.h"
+
+/*
+ * A cache file is a header followed by one record per atom, all of them being
+ * plain doubles and 64-bit integers so that the file can be mapped in memory
+ * and read in place.
+ *
+ */
+typedef struct cache_header_s cache_header_t;
+struct cache_header_s
+{
+  char magic[8];            /* CACHE_MAGIC */
+  uint64_t version;         /* CACHE_VERSION */
+  uint64_t key;             /* Hash of everything the reduced state depends on */
+  uint64_t atom_nb;         /* Number of records following the header */
+  uint64_t solvent_copy_nb; /* Number of solvent copies in the universe */
+  double size;              /* (m) Length of the universe's side */
+};
+
+typedef struct cache_record_s cache_record_t;
+struct cache_record_s
+{
+  vec3_t pos;               /* Position after potential reduction */
+  vec3_t vel;               /* Initial velocity */
+};
+
+/* What cache_write needs, through file_replace */
+typedef struct cache_data_s cache_data_t;
+struct cache_data_s
+{
+  const universe_t *universe;
+  const args_t *args;
+};
+
+/* Hash the input files along with every parameter the reduced state depends on */
+static uint64_t cache_key(const universe_t *universe, const args_t *args)
+{
+  uint64_t key;
+
+  key = universe->input_hash;
+  key = fnv1a(key, &(args->copies), sizeof(args->copies));
+  key = fnv1a(key, &(args->density), sizeof(args->density));
+  key = fnv1a(key, &(args->solvent_density), sizeof(args->solvent_density));
+  key = fnv1a(key, &(args->temperature), sizeof(args->temperature));
+  key = fnv1a(key, &(args->srand_seed), sizeof(args->srand_seed));
+  key = fnv1a(key, &(args->reduce_potential), sizeof(args->reduce_potential));
+  key = fnv1a(key, &(args->softcore), sizeof(args->softcore));
+  key = fnv1a(key, &(args->rigid), sizeof(args->rigid));
+  key = fnv1a(key, &(args->parallel_coarse), sizeof(args->parallel_coarse));
+  key = fnv1a(key, &(args->hmr), sizeof(args->hmr));
+
+  return (key);
+}
+
+/* Get the path of the cache file matching the universe */
+static char *cache_path(const universe_t *universe, const args_t *args)
+{
+  char *path;
+  size_t len;
+
+  len = strlen(args->path_cache) + 1 + 16 + strlen(CACHE_EXTENSION) + 1;
+  if ((path = malloc(len)) == NULL)
+  {
+    return (NULL);
+  }
+
+  snprintf(path, len, "%s/%016llx%s", args->path_cache, (unsigned long long)cache_key(universe, args), CACHE_EXTENSION);
+  return (path);
+}
+
+/* Load the reduced state of the universe, if it was cached. *hit tells whether it was */
+universe_t *universe_cache_load(universe_t *universe, const args_t *args, int *hit)
+{
+  size_t i;
+  int fd;
+  char *path;
+  void *map;
+  struct stat st;
+  const cache_header_t *header;
+  const cache_record_t *record;
+
+  *hit = 0;
+
+  /* Nothing to do without a cache */
+  if (args->path_cache == ARGS_PATH_CACHE_DEFAULT)
+  {
+    return (universe);
+  }
+
+  if ((path = cache_path(universe, args)) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CACHE_LOAD_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* A missing file is a cache miss */
+  if ((fd = open(path, O_RDONLY)) == -1)
+  {
+    printf(TEXT_UNIVERSE_CACHE_MISS, path);
+    free(path);
+    return (universe);
+  }
+
+  if (fstat(fd, &st) == -1)
+  {
+    close(fd);
+    free(path);
+    return (retstr(NULL, TEXT_UNIVERSE_CACHE_LOAD_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* So is a file too short to hold a header, which the reduced universe then replaces */
+  if ((size_t)st.st_size < sizeof(cache_header_t))
+  {
+    close(fd);
+    printf(TEXT_UNIVERSE_CACHE_MISS, path);
+    free(path);
+    return (universe);
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    free(path);
+    return (retstr(NULL, TEXT_UNIVERSE_CACHE_LOAD_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Make sure the file really holds this universe, and is complete. If it isn't, it is replaced as missing */
+  header = map;
+  record = (const cache_record_t *)(header + 1);
+  if (memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC))
+      || header->version != CACHE_VERSION
+      || header->key != cache_key(universe, args)
+      || header->atom_nb != universe->atom_nb
+      || header->solvent_copy_nb != universe->solvent_copy_nb
+      || header->size != universe->size
+      || (size_t)st.st_size != sizeof(cache_header_t) + (header->atom_nb)*sizeof(cache_record_t))
+  {
+    munmap(map, st.st_size);
+    printf(TEXT_UNIVERSE_CACHE_MISS, path);
+    free(path);
+    return (universe);
+  }
+
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    universe->atom[i].pos = record[i].pos;
+    universe->atom[i].vel = record[i].vel;
+  }
+
+  munmap(map, st.st_size);
+  printf(TEXT_UNIVERSE_CACHE_HIT, path);
+  free(path);
+
+  *hit = 1;
+  return (universe);
+}
+
+/* Write the reduced state of the universe */
+static int cache_write(FILE *file, const void *data)
+{
+  size_t i;
+  const universe_t *universe;
+  const args_t *args;
+  cache_header_t header;
+  cache_record_t record;
+
+  universe = ((const cache_data_t*)data)->universe;
+  args = ((const cache_data_t*)data)->args;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version = CACHE_VERSION;
+  header.key = cache_key(universe, args);
+  header.atom_nb = universe->atom_nb;
+  header.solvent_copy_nb = universe->solvent_copy_nb;
+  header.size = universe->size;
+
+  if (fwrite(&header, sizeof(header), 1, file) != 1)
+  {
+    return (-1);
+  }
+
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    record.pos = universe->atom[i].pos;
+    record.vel = universe->atom[i].vel;
+
+    if (fwrite(&record, sizeof(record), 1, file) != 1)
+    {
+      return (-1);
+    }
+  }
+
+  return (0);
+}
+
+/* Save the reduced state of the universe */
+universe_t *universe_cache_store(universe_t *universe, const args_t *args)
+{
+  char *path;
+  cache_data_t data;
+
+  /* Nothing to do without a cache */
+  if (args->path_cache == ARGS_PATH_CACHE_DEFAULT)
+  {
+    return (universe);
+  }
+
+  if ((path = cache_path(universe, args)) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CACHE_STORE_FAILURE, __FILE__, __LINE__));
+  }
+
+  data.universe = universe;
+  data.args = args;
+
+  /* Jobs started from the same inputs may reduce them at the same time */
+  if (file_replace(path, cache_write, &data))
+  {
+    free(path);
+    return (retstr(NULL, TEXT_UNIVERSE_CACHE_STORE_FAILURE, __FILE__, __LINE__));
+  }
+
+  printf(TEXT_UNIVERSE_CACHE_STORE_SUCCESS, path);
+  free(path);
+  return (universe);
+}
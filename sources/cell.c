@@ -0,0 +1,139 @@
+/*
+ * cell.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "config.h"
+#include "cell.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+#include "vec3.h"
+
+/* Split the universe into cells at least min_cell_size long */
+cell_grid_t *cell_grid_init(cell_grid_t *grid, const double size, const double min_cell_size)
+{
+  uint64_t cell_total;
+
+  grid->cell_nb = CELL_GRID_CELL_NB_DEFAULT;
+  grid->cell_size = CELL_GRID_CELL_SIZE_DEFAULT;
+  grid->size = CELL_GRID_SIZE_DEFAULT;
+  grid->atom_nb = CELL_GRID_ATOM_NB_DEFAULT;
+  grid->head = CELL_GRID_HEAD_DEFAULT;
+  grid->next = CELL_GRID_NEXT_DEFAULT;
+
+  if (size <= 0.0)
+  {
+    return (retstr(NULL, TEXT_CELL_GRID_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Get as many cells as we can without going under the minimum size */
+  if (min_cell_size > 0.0)
+  {
+    grid->cell_nb = (uint64_t)floor(size/min_cell_size);
+  }
+  else
+  {
+    grid->cell_nb = CELL_GRID_MAX_CELL_NB;
+  }
+
+  if (grid->cell_nb > CELL_GRID_MAX_CELL_NB)
+  {
+    grid->cell_nb = CELL_GRID_MAX_CELL_NB;
+  }
+
+  if (grid->cell_nb < 1)
+  {
+    grid->cell_nb = 1;
+  }
+
+  grid->size = size;
+  grid->cell_size = size/(grid->cell_nb);
+
+  /* Allocate the cell heads, and mark all of them as empty */
+  cell_total = (grid->cell_nb)*(grid->cell_nb)*(grid->cell_nb);
+  if ((grid->head = malloc(sizeof(uint64_t)*cell_total)) == NULL)
+  {
+    return (retstr(NULL, TEXT_CELL_GRID_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  for (; cell_total > 0; --cell_total)
+  {
+    grid->head[cell_total - 1] = CELL_GRID_EMPTY;
+  }
+
+  return (grid);
+}
+
+/* Bin the atoms into the grid's cells */
+cell_grid_t *cell_grid_fill(cell_grid_t *grid, const atom_t *atom, const uint64_t atom_nb)
+{
+  size_t i;
+  uint64_t cx;
+  uint64_t cy;
+  uint64_t cz;
+  uint64_t cell;
+
+  /* Empty the cells, in case the grid is being refilled */
+  for (cell=0; cell<(grid->cell_nb)*(grid->cell_nb)*(grid->cell_nb); ++cell)
+  {
+    grid->head[cell] = CELL_GRID_EMPTY;
+  }
+
+  if ((grid->next = realloc(grid->next, sizeof(uint64_t)*(atom_nb+1))) == NULL)
+  {
+    return (retstr(NULL, TEXT_CELL_GRID_FILL_FAILURE, __FILE__, __LINE__));
+  }
+  grid->atom_nb = atom_nb;
+
+  /* Prepend each atom to its cell's list */
+  for (i=0; i<atom_nb; ++i)
+  {
+    cell_grid_coord(grid, &(atom[i].pos), &cx, &cy, &cz);
+    cell = cell_grid_index(grid, cx, cy, cz);
+
+    grid->next[i] = grid->head[cell];
+    grid->head[cell] = i;
+  }
+
+  return (grid);
+}
+
+void cell_grid_clean(cell_grid_t *grid)
+{
+  free(grid->head);
+  free(grid->next);
+}
+
+/* Get the coordinates of the cell containing pos, wrapping it inside the universe */
+void cell_grid_coord(const cell_grid_t *grid, const vec3_t *pos, uint64_t *cx, uint64_t *cy, uint64_t *cz)
+{
+  int64_t x;
+  int64_t y;
+  int64_t z;
+  int64_t n;
+
+  n = (int64_t)(grid->cell_nb);
+
+  /* The universe spans [-size/2; size/2[ on each axis */
+  x = (int64_t)floor((pos->x + 0.5*(grid->size)) / (grid->cell_size));
+  y = (int64_t)floor((pos->y + 0.5*(grid->size)) / (grid->cell_size));
+  z = (int64_t)floor((pos->z + 0.5*(grid->size)) / (grid->cell_size));
+
+  /* Wrap positions lying outside of the universe */
+  *cx = (uint64_t)(((x % n) + n) % n);
+  *cy = (uint64_t)(((y % n) + n) % n);
+  *cz = (uint64_t)(((z % n) + n) % n);
+}
+
+/* Get the index of a cell from its coordinates */
+uint64_t cell_grid_index(const cell_grid_t *grid, const uint64_t cx, const uint64_t cy, const uint64_t cz)
+{
+  return ((cz*(grid->cell_nb) + cy)*(grid->cell_nb) + cx);
+}
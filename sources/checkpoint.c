@@ -0,0 +1,532 @@
+/*
+ * checkpoint.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <omp.h>
+
+#include "config.h"
+#include "args.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+#include "vec3.h"
+
+/*
+ * A checkpoint is a header holding the universe's scalars, one record per
+ * atom, each atom's bonds following the previous atom's as in a compiled
+ * system, then the Langevin random streams, then where the output streams
+ * stood. Every part is a multiple of 8 bytes long, in the byte order of the
+ * machine that wrote it.
+ * Taking a checkpoint only copies the atoms: the copy is saved by a thread of
+ * its own, next to the previous checkpoint, and moved in its place once
+ * complete. A checkpoint coming while the previous one is still being saved
+ * is skipped.
+ * The checkpoint holds the number of frames saved before it rather than the
+ * length of the output file, so that it doesn't wait for the writer: the
+ * thread does, before the checkpoint is moved in place, and a restarted run
+ * cuts the output file after as many frames. The output streams are written
+ * by the simulation itself, so the lengths of their files are taken with the
+ * copy.
+ *
+ */
+typedef struct checkpoint_header_s checkpoint_header_t;
+struct checkpoint_header_s
+{
+  char magic[8];            /* CHECKPOINT_MAGIC */
+  uint64_t version;         /* CHECKPOINT_VERSION */
+  uint64_t byte_order;      /* 0x0102030405060708, as written by the machine */
+  uint64_t key;             /* Hash of the model, substrate and solvent files */
+  uint64_t atom_nb;         /* Number of atoms in the universe */
+  uint64_t copy_nb;         /* Number of copies of the substrate */
+  uint64_t solvent_copy_nb; /* Number of copies of the solvent */
+  uint64_t rng_nb;          /* Number of Langevin random streams */
+  uint64_t stream_nb;       /* Number of output streams */
+  uint64_t iterations;      /* Iterations rendered so far */
+  uint64_t output_count;    /* Frames saved to the output file */
+  double size;              /* (m) Side of the universe */
+  double time;              /* (s) Simulated time */
+  double timestep;          /* (s) Timestep */
+  double frame_time;        /* (s) Time of the next frame to save */
+  nhc_t nhc;                /* The Nose-Hoover chain */
+};
+
+typedef struct checkpoint_atom_s checkpoint_atom_t;
+struct checkpoint_atom_s
+{
+  vec3_t pos;       /* (m) */
+  vec3_t vel;       /* (m.s-1) */
+  vec3_t acc;       /* (m.s-2) */
+  vec3_t acc_slow;  /* (m.s-2) Nonbonded part, with r-RESPA */
+  uint64_t element; /* Entry of the model */
+  double mass;      /* (kg) */
+  double charge;    /* (C) */
+  double epsilon;   /* (J) */
+  double sigma;     /* (m) */
+  uint64_t bond_nb; /* Number of bonds following the previous atom's */
+};
+
+typedef struct checkpoint_bond_s checkpoint_bond_t;
+struct checkpoint_bond_s
+{
+  uint64_t atom;    /* Bonded atom */
+  double strength;  /* (N.m-1) */
+};
+
+/* Write the copy of the universe */
+static int checkpoint_write(FILE *file, const void *data)
+{
+  size_t i;
+  size_t ii;
+  const universe_t *universe;
+  const checkpoint_t *checkpoint;
+  checkpoint_header_t header;
+  checkpoint_atom_t record;
+  checkpoint_bond_t bond;
+
+  universe = data;
+  checkpoint = &(universe->checkpoint);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  header.version = CHECKPOINT_VERSION;
+  header.byte_order = 0x0102030405060708;
+  header.key = universe->input_hash;
+  header.atom_nb = universe->atom_nb;
+  header.copy_nb = universe->copy_nb;
+  header.solvent_copy_nb = universe->solvent_copy_nb;
+  header.rng_nb = checkpoint->rng_nb;
+  header.stream_nb = checkpoint->stream_nb;
+  header.iterations = checkpoint->iterations;
+  header.output_count = checkpoint->output_count;
+  header.size = checkpoint->size;
+  header.time = checkpoint->time;
+  header.timestep = checkpoint->timestep;
+  header.frame_time = checkpoint->frame_time;
+  header.nhc = checkpoint->nhc;
+
+  if (fwrite(&header, sizeof(header), 1, file) != 1)
+  {
+    return (-1);
+  }
+
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    memset(&record, 0, sizeof(record));
+    record.pos = checkpoint->atom[i].pos;
+    record.vel = checkpoint->atom[i].vel;
+    record.acc = checkpoint->atom[i].acc;
+    record.acc_slow = checkpoint->atom[i].acc_slow;
+    record.element = checkpoint->atom[i].element;
+    record.mass = checkpoint->atom[i].mass;
+    record.charge = checkpoint->atom[i].charge;
+    record.epsilon = checkpoint->atom[i].epsilon;
+    record.sigma = checkpoint->atom[i].sigma;
+    record.bond_nb = checkpoint->atom[i].bond_nb;
+
+    if (fwrite(&record, sizeof(record), 1, file) != 1)
+    {
+      return (-1);
+    }
+  }
+
+  /* The bonds never change, so the copy shares them with the universe */
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    for (ii=0; ii<(checkpoint->atom[i].bond_nb); ++ii)
+    {
+      bond.atom = checkpoint->atom[i].bond[ii];
+      bond.strength = checkpoint->atom[i].bond_strength[ii];
+
+      if (fwrite(&bond, sizeof(bond), 1, file) != 1)
+      {
+        return (-1);
+      }
+    }
+  }
+
+  if (checkpoint->rng_nb > 0 && fwrite(checkpoint->rng, sizeof(rng_t), checkpoint->rng_nb, file) != checkpoint->rng_nb)
+  {
+    return (-1);
+  }
+
+  if (checkpoint->stream_nb > 0 && fwrite(checkpoint->stream, sizeof(stream_mark_t), checkpoint->stream_nb, file) != checkpoint->stream_nb)
+  {
+    return (-1);
+  }
+
+  return (0);
+}
+
+/* Read a checkpoint into the universe, and into its copy what the simulation sets up */
+static int checkpoint_read(FILE *file, universe_t *universe)
+{
+  size_t i;
+  size_t ii;
+  checkpoint_t *checkpoint;
+  checkpoint_header_t header;
+  checkpoint_atom_t record;
+  checkpoint_bond_t bond;
+  atom_t *current;
+
+  checkpoint = &(universe->checkpoint);
+
+  /* The checkpoint has to come from the same inputs, and to fit its own header */
+  if (fread(&header, sizeof(header), 1, file) != 1
+      || memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC))
+      || header.version != CHECKPOINT_VERSION
+      || header.byte_order != 0x0102030405060708
+      || header.key != universe->input_hash
+      || header.atom_nb == 0
+      || header.atom_nb != (universe->substrate_atom_nb)*(header.copy_nb) + (universe->solvent_atom_nb)*(header.solvent_copy_nb))
+  {
+    return (-1);
+  }
+
+  universe->atom_nb = header.atom_nb;
+  universe->copy_nb = header.copy_nb;
+  universe->solvent_copy_nb = header.solvent_copy_nb;
+  universe->size = header.size;
+
+  if ((universe->atom = malloc(sizeof(atom_t)*(universe->atom_nb))) == NULL
+      || (checkpoint->atom = malloc(sizeof(atom_t)*(universe->atom_nb))) == NULL)
+  {
+    return (-1);
+  }
+
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    current = &(universe->atom[i]);
+    atom_init(current);
+
+    if (fread(&record, sizeof(record), 1, file) != 1
+        || record.element >= universe->model.entry_nb
+        || record.bond_nb > UINT8_MAX)
+    {
+      return (-1);
+    }
+
+    current->pos = record.pos;
+    current->vel = record.vel;
+    current->acc = record.acc;
+    current->acc_slow = record.acc_slow;
+    current->element = record.element;
+    current->mass = record.mass;
+    current->charge = record.charge;
+    current->epsilon = record.epsilon;
+    current->sigma = record.sigma;
+    current->bond_nb = (uint8_t)record.bond_nb;
+  }
+
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    current = &(universe->atom[i]);
+
+    if ((current->bond = malloc(sizeof(uint64_t)*(current->bond_nb))) == NULL
+        || (current->bond_strength = malloc(sizeof(double)*(current->bond_nb))) == NULL)
+    {
+      return (-1);
+    }
+
+    for (ii=0; ii<(current->bond_nb); ++ii)
+    {
+      if (fread(&bond, sizeof(bond), 1, file) != 1 || bond.atom >= universe->atom_nb)
+      {
+        return (-1);
+      }
+      current->bond[ii] = bond.atom;
+      current->bond_strength[ii] = bond.strength;
+    }
+  }
+
+  checkpoint->rng_nb = header.rng_nb;
+  if (checkpoint->rng_nb > 0
+      && ((checkpoint->rng = malloc(sizeof(rng_t)*(checkpoint->rng_nb))) == NULL
+          || fread(checkpoint->rng, sizeof(rng_t), checkpoint->rng_nb, file) != checkpoint->rng_nb))
+  {
+    return (-1);
+  }
+
+  checkpoint->stream_nb = header.stream_nb;
+  if (checkpoint->stream_nb > 0
+      && ((checkpoint->stream = malloc(sizeof(stream_mark_t)*(checkpoint->stream_nb))) == NULL
+          || fread(checkpoint->stream, sizeof(stream_mark_t), checkpoint->stream_nb, file) != checkpoint->stream_nb))
+  {
+    return (-1);
+  }
+
+  /* Nothing may follow */
+  if (fgetc(file) != EOF)
+  {
+    return (-1);
+  }
+
+  /* The simulation recomputes the forces and resets the thermostat, which the copy then overrides */
+  memcpy(checkpoint->atom, universe->atom, sizeof(atom_t)*(universe->atom_nb));
+  checkpoint->nhc = header.nhc;
+  checkpoint->iterations = header.iterations;
+  checkpoint->size = header.size;
+  checkpoint->time = header.time;
+  checkpoint->timestep = header.timestep;
+  checkpoint->frame_time = header.frame_time;
+  checkpoint->output_count = header.output_count;
+
+  return (0);
+}
+
+/* Save the copy to a file of its own, and move it where the checkpoint is expected */
+static universe_t *checkpoint_store(universe_t *universe)
+{
+  /* The previous checkpoint is only replaced by a complete one */
+  if (file_replace(universe->checkpoint.path, checkpoint_write, universe))
+  {
+    return (NULL);
+  }
+
+  return (universe);
+}
+
+/* Save the copy once the frames saved before it are in the output file */
+static void *checkpoint_main(void *data)
+{
+  universe_t *universe;
+  checkpoint_t *checkpoint;
+  writer_t *writer;
+  uint8_t err;
+
+  universe = (universe_t*)data;
+  checkpoint = &(universe->checkpoint);
+  writer = &(universe->writer);
+
+  err = 0;
+  if (writer->running)
+  {
+    pthread_mutex_lock(&(writer->mutex));
+    while (writer->tail < checkpoint->writer_head && !(writer->err))
+    {
+      pthread_cond_wait(&(writer->freed), &(writer->mutex));
+    }
+    err = writer->err;
+    pthread_mutex_unlock(&(writer->mutex));
+  }
+
+  if (err || fflush(universe->file_output) || checkpoint_store(universe) == NULL)
+  {
+    retstr(NULL, TEXT_UNIVERSE_CHECKPOINT_SAVE_FAILURE, __FILE__, __LINE__);
+    err = 1;
+  }
+
+  pthread_mutex_lock(&(checkpoint->mutex));
+  checkpoint->err = err;
+  checkpoint->done = 1;
+  pthread_mutex_unlock(&(checkpoint->mutex));
+
+  return (NULL);
+}
+
+/* Allocate the copy, unless it was loaded to restart from */
+universe_t *universe_checkpoint_init(universe_t *universe, const args_t *args)
+{
+  checkpoint_t *checkpoint;
+
+  checkpoint = &(universe->checkpoint);
+
+  if (checkpoint->atom == NULL && (checkpoint->atom = malloc(sizeof(atom_t)*(universe->atom_nb))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CHECKPOINT_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The streams are those of this run's threads, whatever the restarted one had */
+  free(checkpoint->rng);
+  checkpoint->rng = CHECKPOINT_RNG_DEFAULT;
+  checkpoint->rng_nb = (args->langevin > 0.0) ? (uint64_t)omp_get_max_threads() : 0;
+  if (checkpoint->rng_nb > 0 && (checkpoint->rng = malloc(sizeof(rng_t)*(checkpoint->rng_nb))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CHECKPOINT_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The streams are this run's too, and a restarted run is done with the checkpoint's */
+  free(checkpoint->stream);
+  checkpoint->stream = CHECKPOINT_STREAM_DEFAULT;
+  checkpoint->stream_nb = universe->stream_nb;
+  if (checkpoint->stream_nb > 0 && (checkpoint->stream = malloc(sizeof(stream_mark_t)*(checkpoint->stream_nb))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CHECKPOINT_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (pthread_mutex_init(&(checkpoint->mutex), NULL))
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CHECKPOINT_INIT_FAILURE, __FILE__, __LINE__));
+  }
+  checkpoint->path = args->path_checkpoint;
+
+  return (universe);
+}
+
+/* Copy everything a step changes, and have it saved while the simulation goes on */
+universe_t *universe_checkpoint_save(universe_t *universe, const args_t *args)
+{
+  checkpoint_t *checkpoint;
+  uint8_t done;
+
+  checkpoint = &(universe->checkpoint);
+
+  /* The copy can't be taken while it is being saved */
+  if (checkpoint->running)
+  {
+    pthread_mutex_lock(&(checkpoint->mutex));
+    done = checkpoint->done;
+    pthread_mutex_unlock(&(checkpoint->mutex));
+
+    if (!done)
+    {
+      printf("\n");
+      printf(TEXT_UNIVERSE_CHECKPOINT_BUSY, universe->iterations);
+      return (universe);
+    }
+
+    pthread_join(checkpoint->thread, NULL);
+    checkpoint->running = 0;
+  }
+
+  memcpy(checkpoint->atom, universe->atom, sizeof(atom_t)*(universe->atom_nb));
+  if (args->langevin > 0.0)
+  {
+    memcpy(checkpoint->rng, universe->rng, sizeof(rng_t)*(checkpoint->rng_nb));
+  }
+
+  /* The streams' files are only ever cut after the frames they hold at this point */
+  if (checkpoint->stream_nb > 0 && universe_streams_mark(universe, checkpoint->stream) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CHECKPOINT_SAVE_FAILURE, __FILE__, __LINE__));
+  }
+
+  checkpoint->nhc = universe->nhc;
+  checkpoint->iterations = universe->iterations;
+  checkpoint->size = universe->size;
+  checkpoint->time = universe->time;
+  checkpoint->timestep = universe->timestep;
+  checkpoint->frame_time = universe->frame_time;
+  checkpoint->output_count = universe->output_count;
+  checkpoint->writer_head = universe->writer.head;
+  checkpoint->done = 0;
+
+  if (pthread_create(&(checkpoint->thread), NULL, checkpoint_main, universe))
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CHECKPOINT_SAVE_FAILURE, __FILE__, __LINE__));
+  }
+  checkpoint->running = 1;
+
+  return (universe);
+}
+
+/* Wait for the checkpoint being saved, if any */
+universe_t *universe_checkpoint_sync(universe_t *universe)
+{
+  checkpoint_t *checkpoint;
+
+  checkpoint = &(universe->checkpoint);
+
+  if (!(checkpoint->running))
+  {
+    return (universe);
+  }
+
+  pthread_join(checkpoint->thread, NULL);
+  checkpoint->running = 0;
+
+  if (checkpoint->err)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CHECKPOINT_SYNC_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
+
+/* Build the universe from the checkpoint to restart from */
+universe_t *universe_checkpoint_load(universe_t *universe, const args_t *args)
+{
+  FILE *file;
+
+  if ((file = fopen(args->path_restart, "rb")) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CHECKPOINT_LOAD_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (checkpoint_read(file, universe))
+  {
+    fclose(file);
+    return (retstr(NULL, TEXT_UNIVERSE_CHECKPOINT_LOAD_FAILURE, __FILE__, __LINE__));
+  }
+  fclose(file);
+
+  printf(TEXT_UNIVERSE_CHECKPOINT_RESTART, universe->checkpoint.iterations, universe->checkpoint.time, args->path_restart);
+  return (universe);
+}
+
+/* Hand the state the simulation was set up with back to the checkpoint's */
+universe_t *universe_checkpoint_resume(universe_t *universe, const args_t *args)
+{
+  checkpoint_t *checkpoint;
+  uint64_t rng_nb; /* Number of random streams carried on */
+
+  checkpoint = &(universe->checkpoint);
+
+  memcpy(universe->atom, checkpoint->atom, sizeof(atom_t)*(universe->atom_nb));
+
+  /* With more threads than the checkpoint has streams, the others keep their own seeds */
+  if (args->langevin > 0.0)
+  {
+    rng_nb = (checkpoint->rng_nb < (uint64_t)omp_get_max_threads()) ? checkpoint->rng_nb : (uint64_t)omp_get_max_threads();
+    memcpy(universe->rng, checkpoint->rng, sizeof(rng_t)*rng_nb);
+  }
+
+  /* A chain that wasn't running when the checkpoint was taken starts anew */
+  if (args->nose_hoover > 0.0 && checkpoint->nhc.dof > 0.0)
+  {
+    universe->nhc = checkpoint->nhc;
+  }
+
+  universe->iterations = checkpoint->iterations;
+  universe->size = checkpoint->size;
+  universe->time = checkpoint->time;
+  universe->timestep = checkpoint->timestep;
+  universe->frame_time = checkpoint->frame_time;
+  universe->output_count = checkpoint->output_count;
+
+  return (universe);
+}
+
+/* Wait for the last checkpoint to be saved, and free the copy */
+void universe_checkpoint_clean(universe_t *universe)
+{
+  checkpoint_t *checkpoint;
+
+  checkpoint = &(universe->checkpoint);
+
+  if (checkpoint->running)
+  {
+    pthread_join(checkpoint->thread, NULL);
+    checkpoint->running = 0;
+  }
+
+  if (checkpoint->path != NULL)
+  {
+    pthread_mutex_destroy(&(checkpoint->mutex));
+    checkpoint->path = CHECKPOINT_PATH_DEFAULT;
+  }
+
+  free(checkpoint->atom);
+  free(checkpoint->rng);
+  free(checkpoint->stream);
+  checkpoint->atom = CHECKPOINT_ATOM_DEFAULT;
+  checkpoint->rng = CHECKPOINT_RNG_DEFAULT;
+  checkpoint->stream = CHECKPOINT_STREAM_DEFAULT;
+}
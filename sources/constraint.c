@@ -0,0 +1,607 @@
+/*
+ * constraint.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "config.h"
+#include "args.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+#include "vec3.h"
+
+/*
+ * The bonds to hydrogens vibrate faster than anything else in the universe,
+ * and set the largest timestep the integrator can take. With --shake, their
+ * lengths are held constant: SHAKE (Ryckaert, Ciccotti & Berendsen, 1977)
+ * corrects the positions after the drift, and RATTLE (Andersen, 1983) the
+ * velocities after the closing half kick. Each atom and the hydrogens bound to
+ * it form a cluster, which is solved independently of the others.
+ * With --settle, waters are held rigid instead, and solved analytically by
+ * SETTLE (Miyamoto & Kollman, 1992).
+ *
+ */
+
+/* Returns whether an atom is a hydrogen bound to a single atom */
+static int constraint_is_hydrogen(const universe_t *universe, const uint64_t atom_id)
+{
+  return (universe->atom[atom_id].bond_nb == 1 && !strcmp(universe->model.entry[universe->atom[atom_id].element].symbol, "H"));
+}
+
+/* Returns whether an atom is the oxygen of a water */
+static int constraint_is_water(const universe_t *universe, const uint64_t atom_id)
+{
+  const atom_t *atom;
+
+  atom = &(universe->atom[atom_id]);
+
+  return (atom->bond_nb == 2
+          && !strcmp(universe->model.entry[atom->element].symbol, "O")
+          && constraint_is_hydrogen(universe, atom->bond[0])
+          && constraint_is_hydrogen(universe, atom->bond[1])
+          && universe->atom[atom->bond[0]].element == universe->atom[atom->bond[1]].element);
+}
+
+/* Move an atom by the given displacement, and its velocity with it */
+static void constraint_displace(universe_t *universe, const uint64_t atom_id, const vec3_t *displacement)
+{
+  vec3_t vel;
+
+  vec3_add(&(universe->atom[atom_id].pos), &(universe->atom[atom_id].pos), displacement);
+  vec3_div(&vel, displacement, universe->timestep);
+  vec3_add(&(universe->atom[atom_id].vel), &(universe->atom[atom_id].vel), &vel);
+}
+
+/*
+ * SHAKE, on one cluster. The atoms are moved along the bonds as they were
+ * before the drift, until every bond has its length back. The constraint force
+ * that moved an atom by d over the drift is 2md/dt^2.
+ */
+static universe_t *constraint_shake(universe_t *universe, const uint64_t cluster_id, mat3_t *vir)
+{
+  size_t i;           /* Iterator */
+  size_t iteration;   /* Iterator */
+  int done;           /* Whether every bond of the cluster has its length */
+  const constraint_t *constraint;
+  double inv_mass_1;  /* (kg-1) */
+  double inv_mass_2;  /* (kg-1) */
+  double error;       /* (m2) Difference between the squared lengths */
+  double projection;  /* (m2) Projection of the bond onto the bond before the drift */
+  double multiplier;  /* (kg) Lagrange multiplier of the constraint */
+  vec3_t bond;        /* The bond, from a1 to a2 */
+  vec3_t bond_ref;    /* The bond before the drift */
+  vec3_t displacement;
+
+  for (iteration=0; iteration<CONSTRAINT_MAX_ITERATIONS; ++iteration)
+  {
+    done = 1;
+
+    for (i=universe->cluster[cluster_id]; i<universe->cluster[cluster_id+1]; ++i)
+    {
+      constraint = &(universe->constraint[i]);
+
+      atom_pbc_vector(&bond, universe, constraint->a1, constraint->a2);
+      error = POW2(constraint->length) - vec3_dot(&bond, &bond);
+      if (fabs(error) <= 2*CONSTRAINT_TOLERANCE*POW2(constraint->length))
+      {
+        continue;
+      }
+      done = 0;
+
+      atom_pbc_vector_pos(&bond_ref, universe, &(universe->constraint_ref[constraint->a1]), &(universe->constraint_ref[constraint->a2]));
+      inv_mass_1 = 1/universe->atom[constraint->a1].mass;
+      inv_mass_2 = 1/universe->atom[constraint->a2].mass;
+
+      /* The bond turned by a right angle or more over the drift */
+      projection = vec3_dot(&bond_ref, &bond);
+      if (projection < DIV_THRESHOLD)
+      {
+        return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_POS_FAILURE, __FILE__, __LINE__));
+      }
+      multiplier = error / (2*(inv_mass_1 + inv_mass_2)*projection);
+
+      vec3_mul(&displacement, &bond_ref, -multiplier*inv_mass_1);
+      constraint_displace(universe, constraint->a1, &displacement);
+      vec3_mul(&displacement, &bond_ref, multiplier*inv_mass_2);
+      constraint_displace(universe, constraint->a2, &displacement);
+
+      mat3_add_outer(vir, &bond_ref, &bond_ref, 2*multiplier/POW2(universe->timestep));
+    }
+
+    if (done)
+    {
+      for (i=universe->cluster[cluster_id]; i<universe->cluster[cluster_id+1]; ++i)
+      {
+        atom_enforce_pbc(universe, universe->constraint[i].a1);
+        atom_enforce_pbc(universe, universe->constraint[i].a2);
+      }
+
+      return (universe);
+    }
+  }
+
+  return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_POS_FAILURE, __FILE__, __LINE__));
+}
+
+/* RATTLE, on one cluster. The relative velocities along the bonds are removed */
+static universe_t *constraint_rattle(universe_t *universe, const uint64_t cluster_id)
+{
+  size_t i;          /* Iterator */
+  size_t iteration;  /* Iterator */
+  int done;          /* Whether no bond of the cluster is stretching */
+  const constraint_t *constraint;
+  double inv_mass_1; /* (kg-1) */
+  double inv_mass_2; /* (kg-1) */
+  double error;      /* (m2.s-1) Projection of the relative velocity onto the bond */
+  double multiplier; /* (kg.s-1) */
+  vec3_t bond;       /* The bond, from a1 to a2 */
+  vec3_t vel;        /* Velocity of a2 relative to a1 */
+
+  for (iteration=0; iteration<CONSTRAINT_MAX_ITERATIONS; ++iteration)
+  {
+    done = 1;
+
+    for (i=universe->cluster[cluster_id]; i<universe->cluster[cluster_id+1]; ++i)
+    {
+      constraint = &(universe->constraint[i]);
+
+      atom_pbc_vector(&bond, universe, constraint->a1, constraint->a2);
+      vec3_sub(&vel, &(universe->atom[constraint->a2].vel), &(universe->atom[constraint->a1].vel));
+      error = vec3_dot(&bond, &vel);
+      if (fabs(error) <= CONSTRAINT_TOLERANCE*POW2(constraint->length)/universe->timestep)
+      {
+        continue;
+      }
+      done = 0;
+
+      inv_mass_1 = 1/universe->atom[constraint->a1].mass;
+      inv_mass_2 = 1/universe->atom[constraint->a2].mass;
+      multiplier = error / ((inv_mass_1 + inv_mass_2)*vec3_dot(&bond, &bond));
+
+      vec3_mul(&vel, &bond, multiplier*inv_mass_1);
+      vec3_add(&(universe->atom[constraint->a1].vel), &(universe->atom[constraint->a1].vel), &vel);
+      vec3_mul(&vel, &bond, multiplier*inv_mass_2);
+      vec3_sub(&(universe->atom[constraint->a2].vel), &(universe->atom[constraint->a2].vel), &vel);
+    }
+
+    if (done)
+    {
+      return (universe);
+    }
+  }
+
+  return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_VEL_FAILURE, __FILE__, __LINE__));
+}
+
+/*
+ * SETTLE, on the positions of one water. The water is placed in a frame whose
+ * z axis is normal to its plane before the drift, and the rigid water with the
+ * same centre of mass is found by three rotations, as per Miyamoto & Kollman.
+ */
+static universe_t *constraint_settle_pos(universe_t *universe, const uint64_t settle_id, mat3_t *vir)
+{
+  const settle_t *settle;
+  double mass_o;  /* (kg) */
+  double mass_h;  /* (kg) */
+  double ra;      /* (m) Distance from the centre of mass to the oxygen */
+  double rb;      /* (m) Distance from the centre of mass to the hydrogens' axis */
+  double rc;      /* (m) Half the distance between the hydrogens */
+  double height;  /* (m) Distance from the oxygen to the hydrogens' axis */
+  double sin_phi, cos_phi;
+  double sin_psi, cos_psi;
+  double sin_theta, cos_theta;
+  double alpha, beta, gamma;
+  double tmp;
+  double xb0, yb0, xc0, yc0;      /* The hydrogens before the drift, in the frame */
+  double za1;                     /* The oxygen after the drift, in the frame */
+  double xb1, yb1, zb1;           /* The hydrogens after the drift, in the frame */
+  double xc1, yc1, zc1;
+  double ya2, xb2, yb2, yc2;      /* The rigid water, before its rotation in the plane */
+  vec3_t b0, c0;                  /* The O-H bonds before the drift */
+  vec3_t a1, b1, c1;              /* The atoms after the drift, from the centre of mass */
+  vec3_t com;                     /* The centre of mass, from the oxygen */
+  vec3_t axis_x, axis_y, axis_z;  /* The frame */
+  vec3_t a3, b3, c3;              /* The rigid water, in the frame */
+  vec3_t da, db, dc;              /* The displacements of the atoms */
+  vec3_t tmp_vec;
+
+  settle = &(universe->settle[settle_id]);
+  mass_o = universe->atom[settle->o].mass;
+  mass_h = universe->atom[settle->h1].mass;
+
+  /* The geometry of the rigid water */
+  rc = 0.5*settle->dst_hh;
+  height = sqrt(POW2(settle->dst_oh) - POW2(rc));
+  ra = 2*mass_h*height/(mass_o + 2*mass_h);
+  rb = height - ra;
+
+  /* The bonds before the drift */
+  atom_pbc_vector_pos(&b0, universe, &(universe->constraint_ref[settle->o]), &(universe->constraint_ref[settle->h1]));
+  atom_pbc_vector_pos(&c0, universe, &(universe->constraint_ref[settle->o]), &(universe->constraint_ref[settle->h2]));
+
+  /* The atoms after the drift, from their centre of mass */
+  atom_pbc_vector(&b1, universe, settle->o, settle->h1);
+  atom_pbc_vector(&c1, universe, settle->o, settle->h2);
+  vec3_add(&com, &b1, &c1);
+  vec3_mul(&com, &com, mass_h/(mass_o + 2*mass_h));
+  vec3_mul(&a1, &com, -1.0);
+  vec3_sub(&b1, &b1, &com);
+  vec3_sub(&c1, &c1, &com);
+
+  /* Build the frame, normalising as we go so that the products stay within range */
+  vec3_cross(&axis_z, &b0, &c0);
+  if (vec3_unit(&axis_z, &axis_z) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_POS_FAILURE, __FILE__, __LINE__));
+  }
+  vec3_cross(&axis_x, &a1, &axis_z);
+  if (vec3_unit(&axis_x, &axis_x) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_POS_FAILURE, __FILE__, __LINE__));
+  }
+  vec3_cross(&axis_y, &axis_z, &axis_x);
+
+  xb0 = vec3_dot(&b0, &axis_x);
+  yb0 = vec3_dot(&b0, &axis_y);
+  xc0 = vec3_dot(&c0, &axis_x);
+  yc0 = vec3_dot(&c0, &axis_y);
+  za1 = vec3_dot(&a1, &axis_z);
+  xb1 = vec3_dot(&b1, &axis_x);
+  yb1 = vec3_dot(&b1, &axis_y);
+  zb1 = vec3_dot(&b1, &axis_z);
+  xc1 = vec3_dot(&c1, &axis_x);
+  yc1 = vec3_dot(&c1, &axis_y);
+  zc1 = vec3_dot(&c1, &axis_z);
+
+  /* Tilt the water out of the plane, as the oxygen did */
+  sin_phi = za1/ra;
+  tmp = 1 - POW2(sin_phi);
+  if (tmp < DIV_THRESHOLD)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_POS_FAILURE, __FILE__, __LINE__));
+  }
+  cos_phi = sqrt(tmp);
+
+  /* Then about the bisector, as the hydrogens did */
+  sin_psi = (zb1 - zc1)/(2*rc*cos_phi);
+  tmp = 1 - POW2(sin_psi);
+  if (tmp < DIV_THRESHOLD)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_POS_FAILURE, __FILE__, __LINE__));
+  }
+  cos_psi = sqrt(tmp);
+
+  ya2 = ra*cos_phi;
+  xb2 = -rc*cos_psi;
+  yb2 = -rb*cos_phi - rc*sin_psi*sin_phi;
+  yc2 = -rb*cos_phi + rc*sin_psi*sin_phi;
+
+  /* And finally in the plane, so that the water has no angular momentum about the normal */
+  alpha = xb2*(xb0 - xc0) + yb0*yb2 + yc0*yc2;
+  beta = xb2*(yc0 - yb0) + xb0*yb2 + xc0*yc2;
+  gamma = xb0*yb1 - xb1*yb0 + xc0*yc1 - xc1*yc0;
+  tmp = POW2(alpha) + POW2(beta);
+  if (tmp < DIV_THRESHOLD || tmp < POW2(gamma))
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_POS_FAILURE, __FILE__, __LINE__));
+  }
+  sin_theta = (alpha*gamma - beta*sqrt(tmp - POW2(gamma)))/tmp;
+  cos_theta = sqrt(1 - POW2(sin_theta));
+
+  a3.x = -ya2*sin_theta;
+  a3.y = ya2*cos_theta;
+  a3.z = za1;
+  b3.x = xb2*cos_theta - yb2*sin_theta;
+  b3.y = xb2*sin_theta + yb2*cos_theta;
+  b3.z = zb1;
+  c3.x = -xb2*cos_theta - yc2*sin_theta;
+  c3.y = -xb2*sin_theta + yc2*cos_theta;
+  c3.z = zc1;
+
+  /* Back from the frame, the displacements are what is left to move */
+  vec3_mul(&da, &axis_x, a3.x);
+  vec3_mul(&tmp_vec, &axis_y, a3.y);
+  vec3_add(&da, &da, &tmp_vec);
+  vec3_mul(&tmp_vec, &axis_z, a3.z);
+  vec3_add(&da, &da, &tmp_vec);
+  vec3_sub(&da, &da, &a1);
+
+  vec3_mul(&db, &axis_x, b3.x);
+  vec3_mul(&tmp_vec, &axis_y, b3.y);
+  vec3_add(&db, &db, &tmp_vec);
+  vec3_mul(&tmp_vec, &axis_z, b3.z);
+  vec3_add(&db, &db, &tmp_vec);
+  vec3_sub(&db, &db, &b1);
+
+  vec3_mul(&dc, &axis_x, c3.x);
+  vec3_mul(&tmp_vec, &axis_y, c3.y);
+  vec3_add(&dc, &dc, &tmp_vec);
+  vec3_mul(&tmp_vec, &axis_z, c3.z);
+  vec3_add(&dc, &dc, &tmp_vec);
+  vec3_sub(&dc, &dc, &c1);
+
+  constraint_displace(universe, settle->o, &da);
+  constraint_displace(universe, settle->h1, &db);
+  constraint_displace(universe, settle->h2, &dc);
+
+  /* The constraint forces add up to nothing, so they're taken from the oxygen */
+  mat3_add_outer(vir, &b0, &db, 2*mass_h/POW2(universe->timestep));
+  mat3_add_outer(vir, &c0, &dc, 2*mass_h/POW2(universe->timestep));
+
+  atom_enforce_pbc(universe, settle->o);
+  atom_enforce_pbc(universe, settle->h1);
+  atom_enforce_pbc(universe, settle->h2);
+
+  return (universe);
+}
+
+/* Returns the determinant of a 3x3 matrix */
+static double constraint_det3(double m[3][3])
+{
+  return (m[0][0]*(m[1][1]*m[2][2] - m[1][2]*m[2][1])
+        - m[0][1]*(m[1][0]*m[2][2] - m[1][2]*m[2][0])
+        + m[0][2]*(m[1][0]*m[2][1] - m[1][1]*m[2][0]));
+}
+
+/*
+ * SETTLE, on the velocities of one water. An impulse along each of the three
+ * sides of the triangle cancels the relative velocities along them, which
+ * leaves a 3x3 linear system solved by Cramer's rule.
+ */
+static universe_t *constraint_settle_vel(universe_t *universe, const uint64_t settle_id)
+{
+  size_t i;           /* Iterator */
+  size_t j;           /* Iterator */
+  const settle_t *settle;
+  uint64_t atom[3];   /* The oxygen, then the hydrogens */
+  double inv_mass[3]; /* (kg-1) */
+  double m[3][3];     /* The system */
+  double rhs[3];      /* Its right hand side */
+  double tau[3];      /* (kg.m.s-1) The impulses along the sides */
+  double m_i[3][3];   /* The system, for Cramer's rule */
+  double det;
+  vec3_t side[3];     /* Unit vectors of the sides, from atom[i] to atom[(i+1)%3] */
+  vec3_t vel;
+  vec3_t impulse;
+
+  settle = &(universe->settle[settle_id]);
+  atom[0] = settle->o;
+  atom[1] = settle->h1;
+  atom[2] = settle->h2;
+
+  for (i=0; i<3; ++i)
+  {
+    inv_mass[i] = 1/universe->atom[atom[i]].mass;
+    atom_pbc_vector(&(side[i]), universe, atom[i], atom[(i+1)%3]);
+    if (vec3_unit(&(side[i]), &(side[i])) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_VEL_FAILURE, __FILE__, __LINE__));
+    }
+  }
+
+  /*
+   * The impulse along side i pulls atom[i] and atom[i+1] together:
+   * dv[i] = (tau[i]*side[i] - tau[i-1]*side[i-1]) / m[i]
+   */
+  for (i=0; i<3; ++i)
+  {
+    vec3_sub(&vel, &(universe->atom[atom[(i+1)%3]].vel), &(universe->atom[atom[i]].vel));
+    rhs[i] = -vec3_dot(&(side[i]), &vel);
+    m[i][i] = -(inv_mass[i] + inv_mass[(i+1)%3]);
+    m[i][(i+1)%3] = vec3_dot(&(side[i]), &(side[(i+1)%3]))*inv_mass[(i+1)%3];
+    m[i][(i+2)%3] = vec3_dot(&(side[i]), &(side[(i+2)%3]))*inv_mass[i];
+  }
+
+  det = constraint_det3(m);
+  if (fabs(det) < DIV_THRESHOLD)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_VEL_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Each impulse comes from the system with its column replaced by the right hand side */
+  for (i=0; i<3; ++i)
+  {
+    memcpy(m_i, m, sizeof(m));
+    for (j=0; j<3; ++j)
+    {
+      m_i[j][i] = rhs[j];
+    }
+    tau[i] = constraint_det3(m_i)/det;
+  }
+
+  for (i=0; i<3; ++i)
+  {
+    vec3_mul(&impulse, &(side[i]), tau[i]*inv_mass[i]);
+    vec3_add(&(universe->atom[atom[i]].vel), &(universe->atom[atom[i]].vel), &impulse);
+    vec3_mul(&impulse, &(side[i]), tau[i]*inv_mass[(i+1)%3]);
+    vec3_sub(&(universe->atom[atom[(i+1)%3]].vel), &(universe->atom[atom[(i+1)%3]].vel), &impulse);
+  }
+
+  return (universe);
+}
+
+/* Find the bonds to hold with SHAKE/RATTLE, and the waters to hold with SETTLE */
+universe_t *universe_constraint_init(universe_t *universe, const args_t *args)
+{
+  size_t i;        /* Iterator */
+  size_t j;        /* Iterator */
+  uint64_t ligand; /* The atom at the other end of a bond */
+  settle_t *settle;
+  constraint_t *constraint;
+  vec3_t *vel;     /* The velocities, while the positions are constrained */
+
+  /* Every hydrogen is in one constraint at most, and every cluster has one at least */
+  if ((universe->constraint_ref = malloc(sizeof(vec3_t)*(universe->atom_nb))) == NULL
+      || (universe->constraint = malloc(sizeof(constraint_t)*(universe->atom_nb))) == NULL
+      || (universe->cluster = malloc(sizeof(uint64_t)*(universe->atom_nb + 1))) == NULL
+      || (universe->settle = malloc(sizeof(settle_t)*(universe->atom_nb/3 + 1))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CONSTRAINT_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    /* Waters are held as a whole */
+    if (args->settle && constraint_is_water(universe, i))
+    {
+      settle = &(universe->settle[universe->settle_nb++]);
+      settle->o = i;
+      settle->h1 = universe->atom[i].bond[0];
+      settle->h2 = universe->atom[i].bond[1];
+      settle->dst_oh = universe->model.entry[universe->atom[i].element].radius_covalent
+                     + universe->model.entry[universe->atom[settle->h1].element].radius_covalent;
+      settle->dst_hh = 2*(settle->dst_oh)*sin(0.5*universe->model.entry[universe->atom[i].element].bond_angle);
+      continue;
+    }
+
+    if (!(args->shake))
+    {
+      continue;
+    }
+
+    /* The hydrogens bound to the atom form its cluster */
+    universe->cluster[universe->cluster_nb] = universe->constraint_nb;
+    for (j=0; j<(universe->atom[i].bond_nb); ++j)
+    {
+      ligand = universe->atom[i].bond[j];
+
+      /* Of two hydrogens bound together, the first one holds the bond */
+      if (constraint_is_hydrogen(universe, ligand) && !(constraint_is_hydrogen(universe, i) && ligand < i))
+      {
+        constraint = &(universe->constraint[universe->constraint_nb++]);
+        constraint->a1 = i;
+        constraint->a2 = ligand;
+        constraint->length = universe->model.entry[universe->atom[i].element].radius_covalent
+                           + universe->model.entry[universe->atom[ligand].element].radius_covalent;
+      }
+    }
+
+    if (universe->constraint_nb > universe->cluster[universe->cluster_nb])
+    {
+      ++(universe->cluster_nb);
+    }
+  }
+  universe->cluster[universe->cluster_nb] = universe->constraint_nb;
+
+  /* The potential reduction moved the atoms freely, so the constraints are brought back without touching the velocities */
+  if ((vel = malloc(sizeof(vec3_t)*(universe->atom_nb))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CONSTRAINT_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    universe->constraint_ref[i] = universe->atom[i].pos;
+    vel[i] = universe->atom[i].vel;
+  }
+
+  if (universe_constrain_pos(universe) == NULL)
+  {
+    free(vel);
+    return (retstr(NULL, TEXT_UNIVERSE_CONSTRAINT_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    universe->atom[i].vel = vel[i];
+  }
+  mat3_zero(&(universe->constraint_virial));
+  free(vel);
+
+  printf(TEXT_UNIVERSE_CONSTRAINT_INIT_SUCCESS, universe->constraint_nb, universe->settle_nb);
+
+  return (universe);
+}
+
+/*
+ * Bring the positions back onto the constraints after the drift, and sum the
+ * virial of the constraint forces. The drift must have started from the
+ * positions saved in constraint_ref.
+ */
+universe_t *universe_constrain_pos(universe_t *universe)
+{
+  int err = 0;
+
+  mat3_zero(&(universe->constraint_virial));
+
+#pragma omp parallel
+  {
+    size_t i;    /* Iterator */
+    mat3_t vir;  /* This thread's share of the virial */
+
+    mat3_zero(&vir);
+
+#pragma omp for schedule(static) nowait
+    for (i=0; i<(universe->cluster_nb); ++i)
+    {
+      if (constraint_shake(universe, i, &vir) == NULL)
+      {
+#pragma omp atomic write
+        err = 1;
+      }
+    }
+
+#pragma omp for schedule(static) nowait
+    for (i=0; i<(universe->settle_nb); ++i)
+    {
+      if (constraint_settle_pos(universe, i, &vir) == NULL)
+      {
+#pragma omp atomic write
+        err = 1;
+      }
+    }
+
+#pragma omp critical
+    mat3_add(&(universe->constraint_virial), &(universe->constraint_virial), &vir);
+  }
+  if (0 != err)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_POS_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
+
+/* Remove the velocities along the constraints */
+universe_t *universe_constrain_vel(universe_t *universe)
+{
+  size_t i; /* Iterator */
+  int err = 0;
+
+#pragma omp parallel
+  {
+#pragma omp for schedule(static) nowait
+    for (i=0; i<(universe->cluster_nb); ++i)
+    {
+      if (constraint_rattle(universe, i) == NULL)
+      {
+#pragma omp atomic write
+        err = 1;
+      }
+    }
+
+#pragma omp for schedule(static) nowait
+    for (i=0; i<(universe->settle_nb); ++i)
+    {
+      if (constraint_settle_vel(universe, i) == NULL)
+      {
+#pragma omp atomic write
+        err = 1;
+      }
+    }
+  }
+  if (0 != err)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_CONSTRAIN_VEL_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
@@ -14,33 +14,29 @@
 #include "universe.h"
 #include "util.h"
 
-universe_t *force_bond(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2)
+/*
+ * The kernels below compute the force an interaction applies to a1 and, if
+ * pot isn't NULL, its potential energy. They take the unit vector going from
+ * a1 to a2 and the distance between the atoms, so that force_total() computes
+ * them once per pair whatever it is asked for. The nonbonded kernels are
+ * softened when lambda is below 1.
+ *
+ */
+
+static void force_kernel_bond(vec3_t *frc, double *pot, const universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *unit, const double dst)
 {
-  atom_t *atom_1;
-  atom_t *atom_2;
+  const atom_t *atom_1;
+  const atom_t *atom_2;
   double radius_a1;
   double radius_a2;
   double spring_constant;
   double displacement;
-  double force;
   int bond_id;
-  double dst;
-  vec3_t vec;
 
   /* Makes the code easier to read */
   atom_1 = &(universe->atom[a1]);
   atom_2 = &(universe->atom[a2]);
 
-  /* Get the distance between the atoms */
-  vec3_sub(&vec, &(atom_2->pos), &(atom_1->pos));
-  dst = vec3_mag(&vec);
-
-  /* Turn it into its unit vector */
-  if (vec3_unit(&vec, &vec) == NULL)
-  {
-    return (retstr(NULL, TEXT_FORCE_BOND_FAILURE, __FILE__, __LINE__));
-  }
-
   /* Find the bond id */
   for (bond_id=0; bond_id<(atom_1->bond_nb); ++bond_id)
   {
@@ -57,86 +53,116 @@ universe_t *force_bond(vec3_t *frc, universe_t *universe, const uint64_t a1, con
 
   /* Compute the force vector */
   spring_constant = atom_1->bond_strength[bond_id];
-  force = spring_constant * displacement;
-  vec3_mul(frc, &vec, force);
+  vec3_mul(frc, unit, spring_constant * displacement);
 
-  return (universe);
+  /* And the potential U=(k/2)*(x^2) */
+  if (pot != NULL)
+  {
+    *pot = 0.5*spring_constant*POW2(displacement);
+  }
 }
 
-universe_t *force_electrostatic(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2)
+static void force_kernel_electrostatic(vec3_t *frc, double *pot, const universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *unit, const double dst, const double lambda)
 {
-  atom_t *atom_1;
-  atom_t *atom_2;
-  double force;
-  double dst;
-  vec3_t vec;
+  double charges;
+  double dst_cap;
 
-  /* Makes the code easier to read */
-  atom_1 = &(universe->atom[a1]);
-  atom_2 = &(universe->atom[a2]);
-
-  /* Get the distance between the atoms */
-  vec3_sub(&vec, &(atom_2->pos), &(atom_1->pos));
-  dst = vec3_mag(&vec);
+  charges = universe->atom[a1].charge * universe->atom[a2].charge;
 
-  /* Turn it into its unit vector */
-  if (vec3_unit(&vec, &vec) == NULL)
+  /* While the potentials are switched on, the force keeps the value it has at the capping distance below it */
+  dst_cap = (lambda < 1.0) ? SOFTCORE_COULOMB_RADIUS*sqrt(1 - lambda) : 0.0;
+  if (dst < dst_cap)
   {
-    return (retstr(NULL, TEXT_FORCE_BOND_FAILURE, __FILE__, __LINE__));
+    vec3_mul(frc, unit, -charges / (4*M_PI*C_VACUUMPERM*POW2(dst_cap)));
+
+    /* And the potential is extended linearly from the cap */
+    if (pot != NULL)
+    {
+      *pot = charges * (2*dst_cap - dst) / (POW2(dst_cap)*4*M_PI*C_VACUUMPERM);
+    }
   }
 
-  /* Compute the force vector */
-  force = -(atom_1->charge * atom_2->charge) / (4*M_PI*C_VACUUMPERM*POW2(dst));
-  vec3_mul(frc, &vec, force);
+  else
+  {
+    vec3_mul(frc, unit, -charges / (4*M_PI*C_VACUUMPERM*POW2(dst)));
 
-  return (universe);
+    if (pot != NULL)
+    {
+      *pot = charges / (dst*4*M_PI*C_VACUUMPERM);
+    }
+  }
 }
 
-universe_t *force_lennardjones(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2)
+static void force_kernel_lennardjones(vec3_t *frc, double *pot, const universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *unit, double dst, const double lambda)
 {
-  atom_t *atom_1;
-  atom_t *atom_2;
+  const atom_t *atom_1;
+  const atom_t *atom_2;
   double sigma;
   double epsilon;
   double force;
-  double dst;
-  vec3_t vec;
-
-  /* Initialize the resulting force vector */
-  frc->x = 0.0;
-  frc->y = 0.0;
-  frc->z = 0.0;
+  double dst_cap;
 
   /* Makes the code easier to read */
   atom_1 = &(universe->atom[a1]);
   atom_2 = &(universe->atom[a2]);
 
-  /* Get the distance between the atoms */
-  /* Scale it to Angstroms */
-  vec3_sub(&vec, &(atom_2->pos), &(atom_1->pos));
-  dst = vec3_mag(&vec);
+  /* Initialize the results */
+  frc->x = 0.0;
+  frc->y = 0.0;
+  frc->z = 0.0;
+  if (pot != NULL)
+  {
+    *pot = 0.0;
+  }
+
+  /* Scale the distance to Angstroms */
   dst *= 1E10;
 
   /* Compute the Lennard-Jones parameters
    * (Duffy, E. M.; Severance, D. L.; Jorgensen, W. L.; Isr. J. Chem.1993, 33,  323)
    */
-  sigma = sqrt((universe->atom[a1].sigma)*(universe->atom[a2].sigma));
-  epsilon = sqrt((universe->atom[a1].epsilon)*(universe->atom[a2].epsilon));
+  sigma = sqrt((atom_1->sigma)*(atom_2->sigma));
+  epsilon = sqrt((atom_1->epsilon)*(atom_2->epsilon));
 
   /* Don't compute beyond the cutoff distance */
-  if (dst < LENNARDJONES_CUTOFF*sigma)
+  if (dst >= LENNARDJONES_CUTOFF*sigma)
+  {
+    return;
+  }
+
+  /* While the potentials are switched on, the force keeps the value it has at the capping distance below it */
+  dst_cap = (lambda < 1.0) ? SOFTCORE_LENNARDJONES_RADIUS*sigma*pow(1 - lambda, 1.0/6.0) : 0.0;
+  if (dst < dst_cap)
+  {
+    force = 48*epsilon*((POW12(sigma)/POW13(dst_cap)) - 0.5*(POW6(sigma)/POW7(dst_cap)));
+
+    /* And the potential is extended linearly from the cap */
+    if (pot != NULL)
+    {
+      *pot = 4*epsilon*(POW12(sigma/dst_cap)-POW6(sigma/dst_cap)) - force*(dst - dst_cap);
+    }
+  }
+
+  else
   {
-    /* Compute the force and scale it to Newtons
-     */
     force = 48*epsilon*((POW12(sigma)/POW13(dst)) - 0.5*(POW6(sigma)/POW7(dst)));
-    force *= 1.66053892103219E-11; /* Scaling constant to SI units */
-    vec3_mul(frc, &vec, force/dst); /* Divide by dst to get the unit vector */
+
+    if (pot != NULL)
+    {
+      *pot = 4*epsilon*(POW12(sigma/dst)-POW6(sigma/dst));
+    }
   }
 
-  return (universe);
+  /* Scale the force to Newtons and the potential from kJ.mol-1 to Joules */
+  force *= 1.66053892103219E-11;
+  vec3_mul(frc, unit, -force); /* A repulsive force pushes a1 away from a2 */
+  if (pot != NULL)
+  {
+    *pot *= 1.66053892103219E-21;
+  }
 }
 
-universe_t *force_angle(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2)
+static universe_t *force_kernel_angle(vec3_t *frc, double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2)
 {
   /* This function is a bit complex so here is a rundown:
    * a1 is bonded to a2, but a2 can be bonded to more atoms.
@@ -166,15 +192,18 @@ universe_t *force_angle(vec3_t *frc, universe_t *universe, const uint64_t a1, co
   vec3_t to_ligand;
   vec3_t e_phi;
   vec3_t temp;
-  vec3_t pos_backup;
   atom_t *current;
   atom_t *ligand;
   atom_t *node;
 
-  /* Initialize the resulting force vector */
+  /* Initialize the results */
   frc->x = 0.0;
   frc->y = 0.0;
   frc->z = 0.0;
+  if (pot != NULL)
+  {
+    *pot = 0.0;
+  }
 
   /* Those are just shortcuts, making the code easier to read */
   current = &(universe->atom[a1]);
@@ -188,7 +217,7 @@ universe_t *force_angle(vec3_t *frc, universe_t *universe, const uint64_t a1, co
   }
 
   /* Get the vector going from the node to the current atom and its magnitude */
-  vec3_sub(&to_current, &(current->pos), &(node->pos));
+  atom_pbc_vector(&to_current, universe, a2, a1);
   to_current_mag = vec3_mag(&to_current);
 
   /* For all ligands */
@@ -200,41 +229,7 @@ universe_t *force_angle(vec3_t *frc, universe_t *universe, const uint64_t a1, co
     if (ligand != NULL && ligand != current)
     {
       /* Get the vector going from the node to the ligand */
-      vec3_sub(&to_ligand, &(ligand->pos), &(node->pos));
-
-      /* PERIODIC BOUNDARY CONDITIONS */
-      pos_backup = ligand->pos;
-
-      if (to_ligand.x > 0.5*(universe->size))
-      {
-        ligand->pos.x -= universe->size;
-      }
-      
-      else if (to_ligand.x <= -0.5*(universe->size))
-      {
-        ligand->pos.x += universe->size;
-      }
-
-      if (to_ligand.y > 0.5*(universe->size))
-      {
-        ligand->pos.y -= universe->size;
-      }
-      
-      else if (to_ligand.y <= -0.5*(universe->size))
-      {
-        ligand->pos.y += universe->size;
-      }
-
-      if (to_ligand.z > 0.5*(universe->size))
-      {
-        ligand->pos.z -= universe->size;
-      }
-      
-      else if (to_ligand.z <= -0.5*(universe->size))
-      {
-        ligand->pos.z += universe->size;
-      }
-      /* PERIODIC BOUNDARY CONDITIONS */
+      atom_pbc_vector(&to_ligand, universe, a2, node->bond[i]);
 
       /* Get its magnitude */
       to_ligand_mag = vec3_mag(&to_ligand);
@@ -275,111 +270,251 @@ universe_t *force_angle(vec3_t *frc, universe_t *universe, const uint64_t a1, co
       force = torque/to_current_mag;
       vec3_mul(&temp, &e_phi, force);
 
-      /* Sum it */
+      /* Sum it, along with the potential U=(k/2)*(angle^2) */
       vec3_add(frc, frc, &temp);
-
-      /* Restore the backup coordinates */
-      ligand->pos = pos_backup;
+      if (pot != NULL)
+      {
+        *pot += 0.5*C_AHO*POW2(angular_displacement);
+      }
     }
   }
 
   return (universe);
 }
 
-universe_t *force_total(vec3_t *frc, universe_t *universe, const uint64_t atom_id)
+universe_t *force_bond(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2)
+{
+  double dst;
+  vec3_t vec;
+
+  /* Get the distance between the atoms */
+  atom_pbc_vector(&vec, universe, a1, a2);
+  dst = vec3_mag(&vec);
+
+  /* Turn it into its unit vector */
+  if (vec3_unit(&vec, &vec) == NULL)
+  {
+    return (retstr(NULL, TEXT_FORCE_BOND_FAILURE, __FILE__, __LINE__));
+  }
+
+  force_kernel_bond(frc, NULL, universe, a1, a2, &vec, dst);
+
+  return (universe);
+}
+
+universe_t *force_electrostatic(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2)
+{
+  double dst;
+  vec3_t vec;
+
+  /* Get the distance between the atoms */
+  atom_pbc_vector(&vec, universe, a1, a2);
+  dst = vec3_mag(&vec);
+
+  /* Turn it into its unit vector */
+  if (vec3_unit(&vec, &vec) == NULL)
+  {
+    return (retstr(NULL, TEXT_FORCE_ELECTROSTATIC_FAILURE, __FILE__, __LINE__));
+  }
+
+  force_kernel_electrostatic(frc, NULL, universe, a1, a2, &vec, dst, 1.0);
+
+  return (universe);
+}
+
+universe_t *force_lennardjones(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2)
+{
+  double dst;
+  vec3_t vec;
+
+  /* Get the distance between the atoms */
+  atom_pbc_vector(&vec, universe, a1, a2);
+  dst = vec3_mag(&vec);
+
+  /* Turn it into its unit vector */
+  if (vec3_unit(&vec, &vec) == NULL)
+  {
+    return (retstr(NULL, TEXT_FORCE_LENNARDJONES_FAILURE, __FILE__, __LINE__));
+  }
+
+  force_kernel_lennardjones(frc, NULL, universe, a1, a2, &vec, dst, 1.0);
+
+  return (universe);
+}
+
+universe_t *force_electrostatic_softcore(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2)
+{
+  double dst;
+  vec3_t vec;
+
+  /* Get the distance between the atoms */
+  atom_pbc_vector(&vec, universe, a1, a2);
+  dst = vec3_mag(&vec);
+
+  /* Turn it into its unit vector */
+  if (vec3_unit(&vec, &vec) == NULL)
+  {
+    return (retstr(NULL, TEXT_FORCE_ELECTROSTATIC_SOFTCORE_FAILURE, __FILE__, __LINE__));
+  }
+
+  force_kernel_electrostatic(frc, NULL, universe, a1, a2, &vec, dst, universe->lambda);
+
+  return (universe);
+}
+
+universe_t *force_lennardjones_softcore(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2)
+{
+  double dst;
+  vec3_t vec;
+
+  /* Get the distance between the atoms */
+  atom_pbc_vector(&vec, universe, a1, a2);
+  dst = vec3_mag(&vec);
+
+  /* Turn it into its unit vector */
+  if (vec3_unit(&vec, &vec) == NULL)
+  {
+    return (retstr(NULL, TEXT_FORCE_LENNARDJONES_SOFTCORE_FAILURE, __FILE__, __LINE__));
+  }
+
+  force_kernel_lennardjones(frc, NULL, universe, a1, a2, &vec, dst, universe->lambda);
+
+  return (universe);
+}
+
+universe_t *force_angle(vec3_t *frc, universe_t *universe, const uint64_t a1, const uint64_t a2)
+{
+  return (force_kernel_angle(frc, NULL, universe, a1, a2));
+}
+
+/*
+ * Sum the forces acting on an atom and, if pot and vir aren't NULL, its
+ * potential energy and its share of the virial tensor. Only the terms selected
+ * by FORCE_BONDED and FORCE_NONBONDED are summed. The potential energy follows
+ * potential_total(), which counts every interaction from each of its atoms.
+ * Each pair is seen from both of its atoms, so they each take half of its r.F.
+ * The angle forces on a ligand are taken with the vector from the node, which
+ * accounts for the reaction force on the node as well.
+ */
+universe_t *force_total(vec3_t *frc, double *pot, mat3_t *vir, universe_t *universe, const uint64_t atom_id, const uint8_t terms)
 {
   uint64_t i;
-  vec3_t to_target;
-  vec3_t pos_backup;
+  uint64_t ligand;
+  double dst;
+  double pot_bond;
+  double pot_angle;
+  double pot_electrostatic;
+  double pot_lennardjones;
   vec3_t vec_bond;
   vec3_t vec_electrostatic;
   vec3_t vec_lennardjones;
   vec3_t vec_angle;
+  vec3_t vec_pair; /* From the current atom to the other one */
+  vec3_t unit;
+  atom_t *atom;
 
-  /* For each atom */
-  for (i=0; i<(universe->atom_nb); ++i)
+  atom = &(universe->atom[atom_id]);
+
+  /* Bonded interractions only need the bonds to be walked */
+  if (terms & FORCE_BONDED)
   {
-    /* That isn't the same as the current one */
-    if (i != atom_id)
+    for (i=0; i<(atom->bond_nb); ++i)
     {
-      /* PERIODIC BOUNDARY CONDITIONS */
-      /* Backup the atom's coordinates */
-      pos_backup = universe->atom[i].pos;
-
-      /* Get the vector going to the target atom */
-      vec3_sub(&to_target, &(universe->atom[i].pos), &(universe->atom[atom_id].pos));
+      ligand = atom->bond[i];
 
-      /* Temporarily undo the PBC enforcement, if needed */
-      if (to_target.x > 0.5*(universe->size))
+      /* Get the distance and direction from the atom to its ligand */
+      atom_pbc_vector(&vec_pair, universe, atom_id, ligand);
+      dst = vec3_mag(&vec_pair);
+      if (vec3_unit(&unit, &vec_pair) == NULL)
       {
-        universe->atom[i].pos.x -= universe->size;
+        return (retstr(NULL, TEXT_FORCE_TOTAL_FAILURE, __FILE__, __LINE__));
       }
 
-      else if (to_target.x <= -0.5*(universe->size))
-      {
-        universe->atom[i].pos.x += universe->size;
-      }
+      /* Compute the forces */
+      force_kernel_bond(&vec_bond, (pot != NULL) ? &pot_bond : NULL, universe, atom_id, ligand, &unit, dst);
 
-      if (to_target.y > 0.5*(universe->size))
-      {
-        universe->atom[i].pos.y -= universe->size;
-      }
-      
-      else if (to_target.y <= -0.5*(universe->size))
+      if (force_kernel_angle(&vec_angle, (pot != NULL) ? &pot_angle : NULL, universe, atom_id, ligand) == NULL)
       {
-        universe->atom[i].pos.y += universe->size;
+        return (retstr(NULL, TEXT_FORCE_TOTAL_FAILURE, __FILE__, __LINE__));
       }
 
-      if (to_target.z > 0.5*(universe->size))
+      /* Sum the forces */
+      vec3_add(frc, frc, &vec_bond);
+      vec3_add(frc, frc, &vec_angle);
+
+      if (pot != NULL)
       {
-        universe->atom[i].pos.z -= universe->size;
+        *pot += pot_bond + pot_angle;
       }
-      
-      else if (to_target.z <= -0.5*(universe->size))
+
+      /* The pair vector goes from the atom to the node, hence the signs */
+      if (vir != NULL)
       {
-        universe->atom[i].pos.z += universe->size;
+        mat3_add_outer(vir, &vec_pair, &vec_bond, -0.5);
+        mat3_add_outer(vir, &vec_pair, &vec_angle, -1.0);
       }
-      /* PERIODIC BOUNDARY CONDITIONS */
 
-      /* Bonded interractions */
-      if (atom_is_bonded(universe, atom_id, i))
+      /* The angles the atom is the node of push it back, opposite to its ligands */
+      if (atom->bond_nb > 1)
       {
-        /* Compute the forces */
-        if (force_bond(&vec_bond, universe, atom_id, i) == NULL)
-        {
-          return (retstr(NULL, TEXT_FORCE_TOTAL_FAILURE, __FILE__, __LINE__));
-        }
-        
-        if (force_angle(&vec_angle, universe, atom_id, i) == NULL)
+        if (force_kernel_angle(&vec_angle, NULL, universe, ligand, atom_id) == NULL)
         {
           return (retstr(NULL, TEXT_FORCE_TOTAL_FAILURE, __FILE__, __LINE__));
         }
 
-        /* Sum the forces */
-        vec3_add(frc, frc, &vec_bond);
-        vec3_add(frc, frc, &vec_angle);
+        vec3_sub(frc, frc, &vec_angle);
       }
+    }
+  }
+
+  if (!(terms & FORCE_NONBONDED))
+  {
+    return (universe);
+  }
 
-      /* Non-bonded interractions */
-      else
+  /* For each atom */
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    /* That isn't the same as the current one, nor bonded to it */
+    if (i != atom_id && !atom_is_bonded(universe, atom_id, i))
+    {
+      /* The distance and direction are shared by every interaction of the pair */
+      atom_pbc_vector(&vec_pair, universe, atom_id, i);
+      dst = vec3_mag(&vec_pair);
+
+      /*
+       * While the potentials are switched on, atoms may lie on top of each
+       * other. The capped forces then have no direction, so they are left out,
+       * and only the potential is kept
+       */
+      if (dst == 0.0 && universe->lambda < 1.0)
       {
-        /* Compute the forces */
-        if (force_electrostatic(&vec_electrostatic, universe, atom_id, i) == NULL)
-        {
-          return (retstr(NULL, TEXT_FORCE_TOTAL_FAILURE, __FILE__, __LINE__));
-        }
-        
-        if (force_lennardjones(&vec_lennardjones, universe, atom_id, i) == NULL)
-        {
-          return (retstr(NULL, TEXT_FORCE_TOTAL_FAILURE, __FILE__, __LINE__));
-        }
+        vec3_mul(&unit, &vec_pair, 0.0);
+      }
+
+      else if (vec3_unit(&unit, &vec_pair) == NULL)
+      {
+        return (retstr(NULL, TEXT_FORCE_TOTAL_FAILURE, __FILE__, __LINE__));
+      }
+
+      /* Compute the forces, softened if the potentials are being switched on */
+      force_kernel_electrostatic(&vec_electrostatic, (pot != NULL) ? &pot_electrostatic : NULL, universe, atom_id, i, &unit, dst, universe->lambda);
+      force_kernel_lennardjones(&vec_lennardjones, (pot != NULL) ? &pot_lennardjones : NULL, universe, atom_id, i, &unit, dst, universe->lambda);
 
-        /* Sum the forces */
-        vec3_add(frc, frc, &vec_electrostatic);
-        vec3_add(frc, frc, &vec_lennardjones);
+      /* Sum the forces */
+      vec3_add(frc, frc, &vec_electrostatic);
+      vec3_add(frc, frc, &vec_lennardjones);
+
+      if (pot != NULL)
+      {
+        *pot += pot_electrostatic + pot_lennardjones;
+      }
+
+      if (vir != NULL)
+      {
+        mat3_add_outer(vir, &vec_pair, &vec_electrostatic, -0.5);
+        mat3_add_outer(vir, &vec_pair, &vec_lennardjones, -0.5);
       }
-      /* Restore the backup coordinates */
-      universe->atom[i].pos = pos_backup;
     }
   }
 
@@ -0,0 +1,75 @@
+/*
+ * hmr.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "args.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+
+/*
+ * Hydrogen mass repartitioning (Feenstra, Hess & Berendsen, 1999)
+ *
+ * The hydrogens are made heavier by taking the mass they gain from the atoms
+ * they're bound to, which slows the fastest vibrations down while leaving the
+ * mass of every molecule as it was. This is done on the loaded substrate and
+ * solvent, before they're copied into the universe, and the integrator only
+ * sees the atoms' masses.
+ *
+ */
+
+/* Repartition the masses of a loaded molecule */
+static atom_t *hmr_molecule(atom_t *atom, const uint64_t atom_nb, const universe_t *universe, const double mass)
+{
+  size_t i;        /* Iterator */
+  uint64_t ligand; /* The atom a hydrogen is bound to */
+
+  for (i=0; i<atom_nb; ++i)
+  {
+    /* Only the hydrogens bound to a heavier atom get its mass */
+    if (atom[i].bond_nb != 1 || strcmp(universe->model.entry[atom[i].element].symbol, "H") || atom[i].mass >= mass)
+    {
+      continue;
+    }
+
+    ligand = atom[i].bond[0];
+    if (!strcmp(universe->model.entry[atom[ligand].element].symbol, "H"))
+    {
+      continue;
+    }
+
+    atom[ligand].mass -= mass - atom[i].mass;
+    atom[i].mass = mass;
+
+    /* The heavy atom must stay heavier than its hydrogens */
+    if (atom[ligand].mass < mass)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_HMR_FAILURE, __FILE__, __LINE__));
+    }
+  }
+
+  return (atom);
+}
+
+universe_t *universe_hmr(universe_t *universe, const args_t *args)
+{
+  if (hmr_molecule(universe->substrate_atom, universe->substrate_atom_nb, universe, args->hmr) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_HMR_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (hmr_molecule(universe->solvent_atom, universe->solvent_atom_nb, universe, args->hmr) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_HMR_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
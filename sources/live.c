@@ -0,0 +1,174 @@
+/*
+ * live.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "config.h"
+#include "args.h"
+#include "live.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+
+/* Returns len rounded up to a multiple of 8 bytes */
+static size_t live_pad(const size_t len)
+{
+  return ((len + 7)/8*8);
+}
+
+/* Create the shared memory object, and fill in everything but the frames */
+universe_t *universe_live_init(universe_t *universe, const args_t *args)
+{
+  live_t *live;
+  live_header_t header;
+  char *symbol;
+  uint32_t *element;
+  size_t elements_len;
+  size_t slot_offset;
+  size_t slot_size;
+  size_t i;
+  int fd;
+
+  live = &(universe->live);
+
+  memset(&header, 0, sizeof(header));
+  header.version = LIVE_VERSION;
+  header.byte_order = 0x0102030405060708;
+  header.atom_nb = universe->atom_nb;
+  header.entry_nb = universe->model.entry_nb;
+  header.coord_size = args->traj_double ? sizeof(double) : sizeof(float);
+  header.slot_nb = LIVE_SLOT_NB;
+  header.timestep = args->timestep*1E15;
+  header.frame_interval = (args->frameskip + 1)*(args->timestep)*1E15;
+
+  /* The element table and the atoms' elements, as in an .sxb file, then the ring */
+  elements_len = live_pad(TRAJ_SYMBOL_LEN*(universe->model.entry_nb));
+  slot_offset = sizeof(live_header_t) + elements_len + live_pad(sizeof(uint32_t)*(universe->atom_nb));
+  slot_size = sizeof(live_slot_t) + live_pad(3*(universe->atom_nb)*(header.coord_size));
+  header.slot_offset = slot_offset;
+  header.slot_size = slot_size;
+
+  /* The readers of a previous run keep the object they mapped, and this run gets a new one */
+  shm_unlink(args->path_live);
+  if ((fd = shm_open(args->path_live, O_CREAT | O_EXCL | O_RDWR, 0644)) < 0)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_LIVE_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  live->len = slot_offset + LIVE_SLOT_NB*slot_size;
+  if (ftruncate(fd, (off_t)(live->len))
+      || (live->header = mmap(NULL, live->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    live->header = LIVE_HEADER_DEFAULT;
+    close(fd);
+    shm_unlink(args->path_live);
+    return (retstr(NULL, TEXT_UNIVERSE_LIVE_INIT_FAILURE, __FILE__, __LINE__));
+  }
+  close(fd);
+  live->name = args->path_live;
+
+  /* The object comes zeroed, which leaves every slot empty */
+  memcpy(live->header, &header, sizeof(header));
+
+  symbol = (char*)(live->header) + sizeof(live_header_t);
+  for (i=0; i<(universe->model.entry_nb); ++i)
+  {
+    strncpy(symbol + TRAJ_SYMBOL_LEN*i, universe->model.entry[i].symbol, TRAJ_SYMBOL_LEN);
+  }
+
+  element = (uint32_t*)(symbol + elements_len);
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    element[i] = (uint32_t)(universe->atom[i].element);
+  }
+
+  /* The magic tells the readers that everything else is there */
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(live->header->magic, LIVE_MAGIC, sizeof(LIVE_MAGIC));
+
+  printf(TEXT_UNIVERSE_LIVE_INIT, live->name);
+
+  return (universe);
+}
+
+/* Copy the current state into the next slot of the ring */
+universe_t *universe_live_publish(universe_t *universe, const args_t *args)
+{
+  live_header_t *header;
+  live_slot_t *slot;
+  uint64_t n;
+  size_t i;
+
+  header = universe->live.header;
+
+  /* Only the simulation writes to the object, so head is read as is */
+  n = header->head;
+  slot = LIVE_SLOT(header, n);
+
+  /* The slot is marked as being copied before anything in it changes */
+  __atomic_store_n(&(slot->sequence), 2*n + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  slot->iterations = universe->iterations;
+  slot->time = universe->time*1E15;
+  slot->size = universe->size*1E10;
+
+  if (args->traj_double)
+  {
+    double *coord = (double*)(slot + 1);
+
+#pragma omp parallel for
+    for (i=0; i<(universe->atom_nb); ++i)
+    {
+      coord[3*i]   = universe->atom[i].pos.x*1E10;
+      coord[3*i+1] = universe->atom[i].pos.y*1E10;
+      coord[3*i+2] = universe->atom[i].pos.z*1E10;
+    }
+  }
+  else
+  {
+    float *coord = (float*)(slot + 1);
+
+#pragma omp parallel for
+    for (i=0; i<(universe->atom_nb); ++i)
+    {
+      coord[3*i]   = (float)(universe->atom[i].pos.x*1E10);
+      coord[3*i+1] = (float)(universe->atom[i].pos.y*1E10);
+      coord[3*i+2] = (float)(universe->atom[i].pos.z*1E10);
+    }
+  }
+
+  __atomic_store_n(&(slot->sequence), 2*n + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&(header->head), n + 1, __ATOMIC_RELEASE);
+
+  return (universe);
+}
+
+/* Tell the readers the simulation is over, and remove the object */
+void universe_live_clean(universe_t *universe)
+{
+  live_t *live;
+
+  live = &(universe->live);
+
+  if (live->header == LIVE_HEADER_DEFAULT)
+  {
+    return;
+  }
+
+  __atomic_store_n(&(live->header->ended), 1, __ATOMIC_RELEASE);
+  munmap(live->header, live->len);
+  shm_unlink(live->name);
+
+  live->header = LIVE_HEADER_DEFAULT;
+}
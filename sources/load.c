@@ -12,97 +12,57 @@
 
 #include "config.h"
 #include "model.h"
+#include "parse.h"
 #include "text.h"
 #include "util.h"
 #include "universe.h"
 
-universe_t *universe_load_model(universe_t *universe, char *file_buffer_model)
-{
-  char *tok;
-  size_t i;
-
-  /* Get the number of entries in the model */
-  /* -3 is there because we're not counting the metadata lines */
-  universe->model.entry_nb = line_nb(file_buffer_model) - 4;
+/*
+ * The input files are mapped and their lines indexed beforehand (see parse.h),
+ * so that the atom and bond blocks, which make up most of a large system, can
+ * be parsed in parallel, one line per atom or bond.
+ *
+ */
 
-  /* Allocate memory for the entries */
-  if ((universe->model.entry = malloc(sizeof(model_entry_t) * universe->model.entry_nb)) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
-  }
+/* Copy a whole line, such as a name, an author or a comment */
+static char *load_line(const line_t *line)
+{
+  char *str;
 
-  /* Initialize each entry */
-  for (i=0; i < universe->model.entry_nb; ++i)
+  if ((str = malloc(sizeof(char)*(line->end - line->start + 1))) == NULL)
   {
-    if (model_entry_init(&(universe->model.entry[i])) == NULL)
-    {
-      return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
-    }
+    return (NULL);
   }
+  memcpy(str, line->start, line->end - line->start);
+  str[line->end - line->start] = '\0';
 
-  /* Get the name line and load the model's name from it */
-  tok = strtok(file_buffer_model, "\n");
-  if ((universe->meta_model_name = malloc(sizeof(char)*(strlen(tok)+1))) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
-  }
-  strcpy(universe->meta_model_name, tok);
+  return (str);
+}
 
-  /* Get the author line and load the author's name from it */
-  tok = strtok(NULL, "\n");
-  if ((universe->meta_model_author = malloc(sizeof(char)*(strlen(tok)+1))) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
-  }
-  strcpy(universe->meta_model_author, tok);
+/* Copy the next field of a line */
+static const char *load_word(const char *str, const char *end, char **word)
+{
+  const char *start;
+  size_t len;
 
-  /* Get the comment line and load the author's comment from it */
-  tok = strtok(NULL, "\n");
-  if ((universe->meta_model_comment = malloc(sizeof(char)*(strlen(tok)+1))) == NULL)
+  if ((str = parse_word(str, end, &start, &len)) == NULL || (*word = malloc(sizeof(char)*(len+1))) == NULL)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
+    return (NULL);
   }
-  strcpy(universe->meta_model_comment, tok);
+  memcpy(*word, start, len);
+  (*word)[len] = '\0';
 
-  /* Load each entry */
-  for (i=0; i < (universe->model.entry_nb); ++i)
-  {
-    /* Get the next line */
-    tok = strtok(NULL, "\n");
-
-    /* Initialize memory for each entry name and symbol */
-    if ((universe->model.entry[i].name = malloc(sizeof(char) * strlen(tok))) == NULL)
-    {
-      return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
-    }
-
-    if ((universe->model.entry[i].symbol = malloc(sizeof(char) * strlen(tok))) == NULL)
-    {
-      return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
-    }
-
-    /* Get the next entry as a line */
-    if (sscanf(tok, "%s %s %lf %lf %lf %lf %lf %lf",
-           universe->model.entry[i].name,
-           universe->model.entry[i].symbol,
-           &(universe->model.entry[i].mass),
-           &(universe->model.entry[i].radius_covalent),
-           &(universe->model.entry[i].radius_vdw),
-           &(universe->model.entry[i].bond_angle),
-           &(universe->model.entry[i].lj_epsilon),
-           &(universe->model.entry[i].lj_sigma)) != 8)
-    {
-      return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
-    }
-  }
-
-  return (universe);
+  return (str);
 }
 
-universe_t *universe_load_substrate(universe_t *universe, char *file_buffer_substrate)
+/* Load the atoms and bonds of an MDS file */
+static universe_t *load_system(universe_t *universe, const input_t *input,
+                               char **name, char **author, char **comment,
+                               atom_t **atom, uint64_t *atom_nb, uint64_t *bond_nb)
 {
   size_t i;
-  char *tok;
+  const char *str;
+  int err = 0;
   /* Used when reading the bond block */
   uint64_t *a1;
   uint64_t *a2;
@@ -111,124 +71,149 @@ universe_t *universe_load_substrate(universe_t *universe, char *file_buffer_subs
   uint64_t first;
   uint64_t second;
 
-  /* Get the name line and load the system's name from it */
-  tok = strtok(file_buffer_substrate, "\n");
-  if ((universe->meta_substrate_name = malloc(sizeof(char)*(strlen(tok)+1))) == NULL)
+  /* The name, author, comment and count lines come first */
+  if (input->line_nb < 4)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
+    return (NULL);
   }
-  strcpy(universe->meta_substrate_name, tok);
 
-  /* Get the author line and load the author's name from it */
-  tok = strtok(NULL, "\n");
-  if ((universe->meta_substrate_author = malloc(sizeof(char)*(strlen(tok)+1))) == NULL)
+  /* Load the system's name, the author's name and the author's comment */
+  if ((*name = load_line(&(input->line[0]))) == NULL
+      || (*author = load_line(&(input->line[1]))) == NULL
+      || (*comment = load_line(&(input->line[2]))) == NULL)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
+    return (NULL);
   }
-  strcpy(universe->meta_substrate_author, tok);
 
-  /* Get the comment line and load the author's comment from it */
-  tok = strtok(NULL, "\n");
-  if ((universe->meta_substrate_comment = malloc(sizeof(char)*(strlen(tok)+1))) == NULL)
+  /* Get the count line, and the atom/bond nb from it  */
+  if ((str = parse_uint64(input->line[3].start, input->line[3].end, atom_nb)) == NULL
+      || parse_uint64(str, input->line[3].end, bond_nb) == NULL
+      || input->line_nb - 4 < *atom_nb + *bond_nb)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
+    return (NULL);
   }
-  strcpy(universe->meta_substrate_comment, tok);
-
-  /* Get the count line, and the atom/bond nb from it  */
-  tok = strtok(NULL, "\n");
-  sscanf(tok, "%ld %ld", &(universe->substrate_atom_nb), &(universe->substrate_bond_nb));
 
   /* Allocate memory for the atoms */
-  if ((universe->substrate_atom = malloc (sizeof(atom_t)*(universe->substrate_atom_nb))) == NULL)
+  if ((*atom = malloc(sizeof(atom_t)*(*atom_nb))) == NULL)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
+    return (NULL);
   }
 
-  /* Initialize the atom memory */
-  for (i=0; i<(universe->substrate_atom_nb); ++i)
+  /* Read the atom block, one line per atom */
+#pragma omp parallel for
+  for (i=0; i<(*atom_nb); ++i)
   {
-    atom_init(&(universe->substrate_atom[i]));
-  }
+    const line_t *line;
+    const char *field;
+    atom_t *current;
 
-  /* Read the atom block */
-  for (i=0; i<(universe->substrate_atom_nb); ++i)
-  {
-    tok = strtok(NULL, "\n");
-    if ((sscanf(tok, "%lf %lf %lf %ld %lf %lf %lf",
-           &(universe->substrate_atom[i].pos.x),
-           &(universe->substrate_atom[i].pos.y),
-           &(universe->substrate_atom[i].pos.z),
-           &(universe->substrate_atom[i].element),
-           &(universe->substrate_atom[i].charge),
-           &(universe->substrate_atom[i].epsilon),
-           &(universe->substrate_atom[i].sigma))) != 7)
+    line = &(input->line[4 + i]);
+    current = &((*atom)[i]);
+    atom_init(current);
+
+    if ((field = parse_double(line->start, line->end, &(current->pos.x))) == NULL
+        || (field = parse_double(field, line->end, &(current->pos.y))) == NULL
+        || (field = parse_double(field, line->end, &(current->pos.z))) == NULL
+        || (field = parse_uint64(field, line->end, &(current->element))) == NULL
+        || (field = parse_double(field, line->end, &(current->charge))) == NULL
+        || (field = parse_double(field, line->end, &(current->epsilon))) == NULL
+        || (field = parse_double(field, line->end, &(current->sigma))) == NULL
+        || current->element >= universe->model.entry_nb)
     {
-      return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
+#pragma omp atomic write
+      err = 1;
+      continue;
     }
 
     /* Scale the atom's position vector from Å to m */
-    vec3_mul(&(universe->substrate_atom[i].pos), &(universe->substrate_atom[i].pos), 1E-10);
+    vec3_mul(&(current->pos), &(current->pos), 1E-10);
 
     /* Scale the atom's charge from C.e-1 to C */
-    universe->substrate_atom[i].charge *= C_ELEMCHARGE;
+    current->charge *= C_ELEMCHARGE;
+
+    /* The atom weighs what its element does, until the masses are repartitioned */
+    current->mass = universe->model.entry[current->element].mass;
+  }
+  if (0 != err)
+  {
+    return (NULL);
   }
 
   /* Allocate memory for the temporary bond information storage */
-  if ((a1 = malloc(sizeof(uint64_t) * (universe->substrate_bond_nb))) == NULL)
+  if ((a1 = malloc(sizeof(uint64_t) * (*bond_nb))) == NULL)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
+    return (NULL);
   }
-  if ((a2 = malloc(sizeof(uint64_t) * (universe->substrate_bond_nb))) == NULL)
+  if ((a2 = malloc(sizeof(uint64_t) * (*bond_nb))) == NULL)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
+    return (NULL);
   }
-  if ((bond_strength = malloc(sizeof(double) * (universe->substrate_bond_nb))) == NULL)
+  if ((bond_strength = malloc(sizeof(double) * (*bond_nb))) == NULL)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
+    return (NULL);
   }
   /* Zero the allocated memory */
-  if ((bond_index = calloc(universe->substrate_atom_nb, sizeof(uint8_t))) == NULL)
+  if ((bond_index = calloc(*atom_nb, sizeof(uint8_t))) == NULL)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
+    return (NULL);
+  }
+
+  /* Read the bond block, one line per bond */
+#pragma omp parallel for
+  for (i=0; i<(*bond_nb); ++i)
+  {
+    const line_t *line;
+    const char *field;
+
+    line = &(input->line[4 + (*atom_nb) + i]);
+    if ((field = parse_uint64(line->start, line->end, &(a1[i]))) == NULL
+        || (field = parse_uint64(field, line->end, &(a2[i]))) == NULL
+        || (field = parse_double(field, line->end, &(bond_strength[i]))) == NULL
+        || a1[i] < 1 || a1[i] > *atom_nb || a2[i] < 1 || a2[i] > *atom_nb)
+    {
+#pragma omp atomic write
+      err = 1;
+    }
+  }
+  if (0 != err)
+  {
+    return (NULL);
   }
 
-  /* Read the bond block and get the number of bonds for each atom */
-  for (i=0; i<(universe->substrate_bond_nb); ++i)
+  /* Get the number of bonds for each atom */
+  for (i=0; i<(*bond_nb); ++i)
   {
-    tok = strtok(NULL, "\n");
-    sscanf(tok, "%ld %ld %lf", &(a1[i]), &(a2[i]), &(bond_strength[i]));
-    ++(universe->substrate_atom[a1[i] - 1].bond_nb);
-    ++(universe->substrate_atom[a2[i] - 1].bond_nb);
+    ++((*atom)[a1[i] - 1].bond_nb);
+    ++((*atom)[a2[i] - 1].bond_nb);
   }
 
   /* Allocate memory for the bond information */
-  for (i=0; i<(universe->substrate_atom_nb); ++i)
+  for (i=0; i<(*atom_nb); ++i)
   {
     /* For the bond nodes */
-    if ((universe->substrate_atom[i].bond = malloc(sizeof(uint64_t) * universe->substrate_atom[i].bond_nb)) == NULL)
+    if (((*atom)[i].bond = malloc(sizeof(uint64_t) * (*atom)[i].bond_nb)) == NULL)
     {
-      return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
+      return (NULL);
     }
 
     /* For the bond strengths */
-    if ((universe->substrate_atom[i].bond_strength = malloc(sizeof(double) * universe->substrate_atom[i].bond_nb)) == NULL)
+    if (((*atom)[i].bond_strength = malloc(sizeof(double) * (*atom)[i].bond_nb)) == NULL)
     {
-      return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
+      return (NULL);
     }
   }
 
   /* Load the bond information */
-  for (i=0; i<(universe->substrate_bond_nb); ++i)
+  for (i=0; i<(*bond_nb); ++i)
   {
     first = a1[i] - 1;
     second = a2[i] - 1;
 
-    universe->substrate_atom[first].bond[bond_index[first]] = second;
-    universe->substrate_atom[first].bond_strength[bond_index[first]] = bond_strength[i];
+    (*atom)[first].bond[bond_index[first]] = second;
+    (*atom)[first].bond_strength[bond_index[first]] = bond_strength[i];
 
-    universe->substrate_atom[second].bond[bond_index[second]] = first;
-    universe->substrate_atom[second].bond_strength[bond_index[second]] = bond_strength[i];
+    (*atom)[second].bond[bond_index[second]] = first;
+    (*atom)[second].bond_strength[bond_index[second]] = bond_strength[i];
 
     ++bond_index[first];
     ++bond_index[second];
@@ -243,146 +228,91 @@ universe_t *universe_load_substrate(universe_t *universe, char *file_buffer_subs
   return (universe);
 }
 
-universe_t *universe_load_solvent(universe_t *universe, char *file_buffer_solvent)
+universe_t *universe_load_model(universe_t *universe, const input_t *input)
 {
+  const char *str;
+  const line_t *line;
   size_t i;
-  char *tok;
-  /* Used when reading the bond block */
-  uint64_t *a1;
-  uint64_t *a2;
-  double *bond_strength;
-  uint8_t *bond_index;
-  uint64_t first;
-  uint64_t second;
 
-  /* Get the name line and load the system's name from it */
-  tok = strtok(file_buffer_solvent, "\n");
-  if ((universe->meta_solvent_name = malloc(sizeof(char)*(strlen(tok)+1))) == NULL)
+  /* The entries follow the name, author and comment lines */
+  if (input->line_nb < 3)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
+    return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
   }
-  strcpy(universe->meta_solvent_name, tok);
+  universe->model.entry_nb = input->line_nb - 3;
 
-  /* Get the author line and load the author's name from it */
-  tok = strtok(NULL, "\n");
-  if ((universe->meta_solvent_author = malloc(sizeof(char)*(strlen(tok)+1))) == NULL)
+  /* Allocate memory for the entries */
+  if ((universe->model.entry = malloc(sizeof(model_entry_t) * universe->model.entry_nb)) == NULL)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
+    return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
   }
-  strcpy(universe->meta_solvent_author, tok);
 
-  /* Get the comment line and load the author's comment from it */
-  tok = strtok(NULL, "\n");
-  if ((universe->meta_solvent_comment = malloc(sizeof(char)*(strlen(tok)+1))) == NULL)
+  /* Initialize each entry */
+  for (i=0; i < universe->model.entry_nb; ++i)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
+    if (model_entry_init(&(universe->model.entry[i])) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
+    }
   }
-  strcpy(universe->meta_solvent_comment, tok);
 
-  /* Get the count line, and the atom/bond nb from it  */
-  tok = strtok(NULL, "\n");
-  sscanf(tok, "%ld %ld", &(universe->solvent_atom_nb), &(universe->solvent_bond_nb));
-
-  /* Allocate memory for the atoms */
-  if ((universe->solvent_atom = malloc (sizeof(atom_t)*(universe->solvent_atom_nb))) == NULL)
+  /* Load the model's name, the author's name and the author's comment */
+  if ((universe->meta_model_name = load_line(&(input->line[0]))) == NULL
+      || (universe->meta_model_author = load_line(&(input->line[1]))) == NULL
+      || (universe->meta_model_comment = load_line(&(input->line[2]))) == NULL)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
+    return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
   }
 
-  /* Initialize the atom memory */
-  for (i=0; i<(universe->solvent_atom_nb); ++i)
+  /* Load each entry */
+  for (i=0; i < (universe->model.entry_nb); ++i)
   {
-    atom_init(&(universe->solvent_atom[i]));
-  }
+    line = &(input->line[3 + i]);
 
-  /* Read the atom block */
-  for (i=0; i<(universe->solvent_atom_nb); ++i)
-  {
-    tok = strtok(NULL, "\n");
-    if ((sscanf(tok, "%lf %lf %lf %ld %lf %lf %lf",
-           &(universe->solvent_atom[i].pos.x),
-           &(universe->solvent_atom[i].pos.y),
-           &(universe->solvent_atom[i].pos.z),
-           &(universe->solvent_atom[i].element),
-           &(universe->solvent_atom[i].charge),
-           &(universe->solvent_atom[i].epsilon),
-           &(universe->solvent_atom[i].sigma))) != 7)
+    if ((str = load_word(line->start, line->end, &(universe->model.entry[i].name))) == NULL
+        || (str = load_word(str, line->end, &(universe->model.entry[i].symbol))) == NULL
+        || (str = parse_double(str, line->end, &(universe->model.entry[i].mass))) == NULL
+        || (str = parse_double(str, line->end, &(universe->model.entry[i].radius_covalent))) == NULL
+        || (str = parse_double(str, line->end, &(universe->model.entry[i].radius_vdw))) == NULL
+        || (str = parse_double(str, line->end, &(universe->model.entry[i].bond_angle))) == NULL
+        || (str = parse_double(str, line->end, &(universe->model.entry[i].lj_epsilon))) == NULL
+        || (str = parse_double(str, line->end, &(universe->model.entry[i].lj_sigma))) == NULL)
     {
-      return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
+      return (retstr(NULL, TEXT_UNIVERSE_LOAD_MODEL_FAILURE, __FILE__, __LINE__));
     }
-
-    /* Scale the atom's position vector from Å to m */
-    vec3_mul(&(universe->solvent_atom[i].pos), &(universe->solvent_atom[i].pos), 1E-10);
-
-    /* Scale the atom's charge from C.e-1 to C */
-    universe->solvent_atom[i].charge *= C_ELEMCHARGE;
   }
 
-  /* Allocate memory for the temporary bond information storage */
-  if ((a1 = malloc(sizeof(uint64_t) * (universe->solvent_bond_nb))) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
-  }
-  if ((a2 = malloc(sizeof(uint64_t) * (universe->solvent_bond_nb))) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
-  }
-  if ((bond_strength = malloc(sizeof(double) * (universe->solvent_bond_nb))) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
-  }
-  /* Zero the allocated memory */
-  if ((bond_index = calloc(universe->solvent_atom_nb, sizeof(uint8_t))) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
-  }
+  return (universe);
+}
 
-  /* Read the bond block and get the number of bonds for each atom */
-  for (i=0; i<(universe->solvent_bond_nb); ++i)
+universe_t *universe_load_substrate(universe_t *universe, const input_t *input)
+{
+  if (load_system(universe, input,
+                  &(universe->meta_substrate_name),
+                  &(universe->meta_substrate_author),
+                  &(universe->meta_substrate_comment),
+                  &(universe->substrate_atom),
+                  &(universe->substrate_atom_nb),
+                  &(universe->substrate_bond_nb)) == NULL)
   {
-    tok = strtok(NULL, "\n");
-    sscanf(tok, "%ld %ld %lf", &(a1[i]), &(a2[i]), &(bond_strength[i]));
-    ++(universe->solvent_atom[a1[i] - 1].bond_nb);
-    ++(universe->solvent_atom[a2[i] - 1].bond_nb);
+    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SUBSTRATE_FAILURE, __FILE__, __LINE__));
   }
 
-  /* Allocate memory for the bond information */
-  for (i=0; i<(universe->solvent_atom_nb); ++i)
-  {
-    /* For the bond nodes */
-    if ((universe->solvent_atom[i].bond = malloc(sizeof(uint64_t) * universe->solvent_atom[i].bond_nb)) == NULL)
-    {
-      return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
-    }
-
-    /* For the bond strengths */
-    if ((universe->solvent_atom[i].bond_strength = malloc(sizeof(double) * universe->solvent_atom[i].bond_nb)) == NULL)
-    {
-      return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
-    }
-  }
+  return (universe);
+}
 
-  /* Load the bond information */
-  for (i=0; i<(universe->solvent_bond_nb); ++i)
+universe_t *universe_load_solvent(universe_t *universe, const input_t *input)
+{
+  if (load_system(universe, input,
+                  &(universe->meta_solvent_name),
+                  &(universe->meta_solvent_author),
+                  &(universe->meta_solvent_comment),
+                  &(universe->solvent_atom),
+                  &(universe->solvent_atom_nb),
+                  &(universe->solvent_bond_nb)) == NULL)
   {
-    first = a1[i] - 1;
-    second = a2[i] - 1;
-
-    universe->solvent_atom[first].bond[bond_index[first]] = second;
-    universe->solvent_atom[first].bond_strength[bond_index[first]] = bond_strength[i];
-
-    universe->solvent_atom[second].bond[bond_index[second]] = first;
-    universe->solvent_atom[second].bond_strength[bond_index[second]] = bond_strength[i];
-
-    ++bond_index[first];
-    ++bond_index[second];
+    return (retstr(NULL, TEXT_UNIVERSE_LOAD_SOLVENT_FAILURE, __FILE__, __LINE__));
   }
 
-  /* Free the temporary bond information storage */
-  free(a1);
-  free(a2);
-  free(bond_strength);
-  free(bond_index);
-
   return (universe);
 }
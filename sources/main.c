@@ -13,15 +13,20 @@
 #include "args.h"
 #include "text.h"
 #include "util.h"
+#include "stop.h"
 
 int main(int argc, char **argv)
 {
   args_t args;         /* Program arguments (from argv) */
   universe_t universe; /* The universe itself (wow) */
+  int cache_hit;       /* Whether the reduced universe was found in the cache */
 
   /* That's the welcome message */
   puts(TEXT_START);
 
+  /* The walltime counts from here */
+  stop_init();
+
   /* Parse the arguments */
   args_init(&args);
   if (args_parse(&args, argc, argv) == NULL)
@@ -42,12 +47,25 @@ int main(int argc, char **argv)
     return (retstri(EXIT_FAILURE, TEXT_MAIN_FAILURE, __FILE__, __LINE__));
   }
 
-  /* Reduce the potential energy before simulating */
-  if (universe_reducepot(&universe, &args) == NULL)
+  /* Skip the potential reduction if it was already done with the same inputs, or before the checkpoint */
+  cache_hit = (args.path_restart != ARGS_PATH_RESTART_DEFAULT);
+  if (!cache_hit && universe_cache_load(&universe, &args, &cache_hit) == NULL)
   {
     return (retstri(EXIT_FAILURE, TEXT_MAIN_FAILURE, __FILE__, __LINE__));
   }
 
+  if (!cache_hit)
+  {
+    /* Reduce the potential energy before simulating */
+    if (universe_reducepot(&universe, &args) == NULL)
+    {
+      return (retstri(EXIT_FAILURE, TEXT_MAIN_FAILURE, __FILE__, __LINE__));
+    }
+
+    /* Failing to fill the cache doesn't prevent the simulation from running */
+    universe_cache_store(&universe, &args);
+  }
+
   /* Let's roll */
   return (universe_simulate(&universe, &args));
 }
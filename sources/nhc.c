@@ -0,0 +1,117 @@
+/*
+ * nhc.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "config.h"
+#include "args.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+
+/*
+ * The chain is propagated by half timesteps at both ends of the Velocity-Verlet
+ * step, as per Martyna, Tuckerman & Klein (1996). The chain never touches the
+ * atoms itself: the velocity scaling it computes is accumulated, and applied by
+ * the next half kick of atom_update_vel(). The kinetic energy it needs is
+ * reduced by the half kick that closes the previous step, so the thermostat
+ * costs no extra sweep over the atoms.
+ *
+ */
+
+/* Returns the force acting on the given thermostat */
+static double nhc_force(const nhc_t *nhc, const size_t link, const double ek, const double kt)
+{
+  if (link == 0)
+  {
+    return ((2*ek - (nhc->dof)*kt) / nhc->mass[0]);
+  }
+
+  return ((nhc->mass[link-1]*POW2(nhc->vel[link-1]) - kt) / nhc->mass[link]);
+}
+
+/* Initialise the chain, and propagate it over the first half step */
+universe_t *universe_nhc_init(universe_t *universe, const args_t *args)
+{
+  size_t i;  /* Iterator */
+  double kt; /* (J) Thermal energy */
+  double ek; /* (J) Kinetic energy of the universe */
+
+  kt = C_BOLTZMANN*(args->temperature);
+
+  /* A chain without mass would have infinite velocities */
+  if (kt*POW2(args->nose_hoover) < DIV_THRESHOLD)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_NHC_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The first thermostat is coupled to every degree of freedom the constraints leave, the others to one */
+  universe->nhc.dof = 3*(universe->atom_nb) - (universe->constraint_nb) - 3*(universe->settle_nb);
+  for (i=0; i<NHC_CHAIN_LENGTH; ++i)
+  {
+    universe->nhc.mass[i] = kt*POW2(args->nose_hoover);
+  }
+  universe->nhc.mass[0] *= universe->nhc.dof;
+
+  /* The first step has no previous half kick to get the kinetic energy from */
+  if (universe_energy_kinetic(universe, &ek) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_NHC_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe_nhc_propagate(universe, args, ek));
+}
+
+/*
+ * Propagate the chain over half a timestep, given the kinetic energy of the
+ * atoms before the pending scaling is applied
+ */
+universe_t *universe_nhc_propagate(universe_t *universe, const args_t *args, double ek)
+{
+  size_t i;     /* Iterator */
+  double kt;    /* (J) Thermal energy */
+  double dt;    /* (s) Half timestep */
+  double scale; /* Velocity scaling over this half step */
+  nhc_t *nhc;
+
+  /* Makes the code easier to read */
+  nhc = &(universe->nhc);
+  kt = C_BOLTZMANN*(args->temperature);
+  dt = 0.5*(universe->timestep);
+  ek *= POW2(nhc->scale);
+
+  /* Update the thermostat velocities from the end of the chain... */
+  nhc->vel[NHC_CHAIN_LENGTH-1] += 0.5*dt*nhc_force(nhc, NHC_CHAIN_LENGTH-1, ek, kt);
+  for (i=NHC_CHAIN_LENGTH-1; i-- > 0;)
+  {
+    nhc->vel[i] *= exp(-0.25*dt*(nhc->vel[i+1]));
+    nhc->vel[i] += 0.5*dt*nhc_force(nhc, i, ek, kt);
+    nhc->vel[i] *= exp(-0.25*dt*(nhc->vel[i+1]));
+  }
+
+  /* Scale the atoms' velocities, and move the thermostats */
+  scale = exp(-dt*(nhc->vel[0]));
+  nhc->scale *= scale;
+  ek *= POW2(scale);
+  for (i=0; i<NHC_CHAIN_LENGTH; ++i)
+  {
+    nhc->pos[i] += dt*(nhc->vel[i]);
+  }
+
+  /* ...then back from its start, with the scaled kinetic energy */
+  for (i=0; i<NHC_CHAIN_LENGTH-1; ++i)
+  {
+    nhc->vel[i] *= exp(-0.25*dt*(nhc->vel[i+1]));
+    nhc->vel[i] += 0.5*dt*nhc_force(nhc, i, ek, kt);
+    nhc->vel[i] *= exp(-0.25*dt*(nhc->vel[i+1]));
+  }
+  nhc->vel[NHC_CHAIN_LENGTH-1] += 0.5*dt*nhc_force(nhc, NHC_CHAIN_LENGTH-1, ek, kt);
+
+  return (universe);
+}
@@ -0,0 +1,336 @@
+/*
+ * parse.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "parse.h"
+
+/* The powers of ten a double holds exactly */
+static const double parse_pow10[] =
+{
+  1E0,  1E1,  1E2,  1E3,  1E4,  1E5,  1E6,  1E7,  1E8,  1E9,  1E10, 1E11,
+  1E12, 1E13, 1E14, 1E15, 1E16, 1E17, 1E18, 1E19, 1E20, 1E21, 1E22
+};
+
+/* Whether c separates the fields of a line */
+static int parse_is_blank(const char c)
+{
+  return (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f');
+}
+
+/* Returns the first character at str that isn't a blank */
+static const char *parse_skip(const char *str, const char *end)
+{
+  while (str < end && parse_is_blank(*str))
+  {
+    ++str;
+  }
+  return (str);
+}
+
+/* Returns the first blank at str */
+static const char *parse_token_end(const char *str, const char *end)
+{
+  while (str < end && !parse_is_blank(*str))
+  {
+    ++str;
+  }
+  return (str);
+}
+
+/* Parse a number strtod's way, for the ones that can't be parsed by hand */
+static const char *parse_double_slow(const char *str, const char *end, double *value)
+{
+  char token[PARSE_TOKEN_MAX];
+  char *token_end;
+  size_t len;
+
+  len = (size_t)(parse_token_end(str, end) - str);
+  if (len == 0 || len >= PARSE_TOKEN_MAX)
+  {
+    return (NULL);
+  }
+
+  memcpy(token, str, len);
+  token[len] = '\0';
+  *value = strtod(token, &token_end);
+
+  /* The whole field has to be a number */
+  if (token_end != token + len)
+  {
+    return (NULL);
+  }
+
+  return (str + len);
+}
+
+/* Map the file in memory */
+input_t *input_map(input_t *input, FILE *file)
+{
+  struct stat st;
+
+  input->data = INPUT_DATA_DEFAULT;
+  input->len = INPUT_LEN_DEFAULT;
+  input->line_nb = INPUT_LINE_NB_DEFAULT;
+  input->line = INPUT_LINE_DEFAULT;
+
+  if (fstat(fileno(file), &st) || st.st_size < 0)
+  {
+    return (NULL);
+  }
+  input->len = (size_t)st.st_size;
+
+  /* An empty file can't be mapped, but has no lines either */
+  if (input->len > 0)
+  {
+    if ((input->data = mmap(NULL, input->len, PROT_READ, MAP_PRIVATE, fileno(file), 0)) == MAP_FAILED)
+    {
+      input->data = INPUT_DATA_DEFAULT;
+      return (NULL);
+    }
+    posix_madvise((void*)input->data, input->len, POSIX_MADV_WILLNEED);
+  }
+
+  return (input);
+}
+
+/* Index the lines of a mapped file */
+input_t *input_index(input_t *input)
+{
+  const char *str;
+  const char *end;
+  const char *line_end;
+  uint64_t line_max;
+
+  /* Count the line breaks, then find the lines between them */
+  line_max = 1;
+  end = input->data + input->len;
+  for (str = input->data; str < end && (str = memchr(str, '\n', end - str)) != NULL; ++str)
+  {
+    ++line_max;
+  }
+
+  if ((input->line = malloc(sizeof(line_t)*line_max)) == NULL)
+  {
+    return (NULL);
+  }
+
+  for (str = input->data; str < end; str = line_end + 1)
+  {
+    if ((line_end = memchr(str, '\n', end - str)) == NULL)
+    {
+      line_end = end;
+    }
+
+    if (line_end > str)
+    {
+      input->line[input->line_nb].start = str;
+      input->line[input->line_nb].end = line_end;
+      ++(input->line_nb);
+    }
+  }
+
+  return (input);
+}
+
+void input_unmap(input_t *input)
+{
+  if (input->data != NULL)
+  {
+    munmap((void*)input->data, input->len);
+  }
+  free(input->line);
+
+  input->data = INPUT_DATA_DEFAULT;
+  input->len = INPUT_LEN_DEFAULT;
+  input->line_nb = INPUT_LINE_NB_DEFAULT;
+  input->line = INPUT_LINE_DEFAULT;
+}
+
+/* Find the next field, which isn't copied */
+const char *parse_word(const char *str, const char *end, const char **word, size_t *len)
+{
+  str = parse_skip(str, end);
+  *word = str;
+  str = parse_token_end(str, end);
+  *len = (size_t)(str - *word);
+
+  if (*len == 0)
+  {
+    return (NULL);
+  }
+
+  return (str);
+}
+
+/*
+ * Parse a decimal number. Up to 19 significant digits fit in a 64-bit integer,
+ * which is exact as a double up to 2^53, and so are the powers of ten up to
+ * 1E22: a single multiplication or division then rounds the number as strtod
+ * would. Anything else is left to strtod.
+ */
+const char *parse_double(const char *str, const char *end, double *value)
+{
+  const char *p;
+  uint64_t mantissa;  /* Significant digits */
+  int digit_nb;       /* Number of significant digits */
+  int digit_seen;     /* Whether there was any digit at all */
+  int truncated;      /* Whether some significant digits were left out */
+  int negative;
+  int64_t exponent;   /* Power of ten the mantissa is multiplied by */
+  int64_t exp_value;  /* Exponent written after 'e' */
+  int exp_negative;
+
+  str = parse_skip(str, end);
+  p = str;
+  mantissa = 0;
+  digit_nb = 0;
+  digit_seen = 0;
+  truncated = 0;
+  exponent = 0;
+
+  negative = (p < end && *p == '-');
+  if (p < end && (*p == '-' || *p == '+'))
+  {
+    ++p;
+  }
+
+  /* Integral part */
+  for (; p < end && *p >= '0' && *p <= '9'; ++p)
+  {
+    digit_seen = 1;
+    if (mantissa == 0 && *p == '0')
+    {
+      continue;
+    }
+    if (digit_nb < 19)
+    {
+      mantissa = 10*mantissa + (uint64_t)(*p - '0');
+      ++digit_nb;
+    }
+    else
+    {
+      truncated = 1;
+      ++exponent;
+    }
+  }
+
+  /* Fractional part, the leading zeros only moving the exponent */
+  if (p < end && *p == '.')
+  {
+    for (++p; p < end && *p >= '0' && *p <= '9'; ++p)
+    {
+      digit_seen = 1;
+      if (mantissa == 0 && *p == '0')
+      {
+        --exponent;
+        continue;
+      }
+      if (digit_nb < 19)
+      {
+        mantissa = 10*mantissa + (uint64_t)(*p - '0');
+        ++digit_nb;
+        --exponent;
+      }
+      else
+      {
+        truncated = 1;
+      }
+    }
+  }
+
+  /* Exponent */
+  if (digit_seen && p < end && (*p == 'e' || *p == 'E'))
+  {
+    ++p;
+    exp_negative = (p < end && *p == '-');
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+      ++p;
+    }
+    if (p == end || *p < '0' || *p > '9')
+    {
+      return (parse_double_slow(str, end, value));
+    }
+
+    for (exp_value = 0; p < end && *p >= '0' && *p <= '9'; ++p)
+    {
+      if (exp_value < 100000)
+      {
+        exp_value = 10*exp_value + (*p - '0');
+      }
+    }
+    exponent += exp_negative ? -exp_value : exp_value;
+  }
+
+  /* Hex, infinities and trailing characters are strtod's call */
+  if (!digit_seen || (p < end && !parse_is_blank(*p)))
+  {
+    return (parse_double_slow(str, end, value));
+  }
+
+  if (mantissa == 0)
+  {
+    *value = negative ? -0.0 : 0.0;
+    return (p);
+  }
+
+  if (truncated || mantissa > ((uint64_t)1 << 53) || exponent > 22 || exponent < -22)
+  {
+    return (parse_double_slow(str, end, value));
+  }
+
+  if (exponent < 0)
+  {
+    *value = (double)mantissa/parse_pow10[-exponent];
+  }
+  else
+  {
+    *value = (double)mantissa*parse_pow10[exponent];
+  }
+  if (negative)
+  {
+    *value = -(*value);
+  }
+
+  return (p);
+}
+
+/* Parse a decimal unsigned integer */
+const char *parse_uint64(const char *str, const char *end, uint64_t *value)
+{
+  const char *digits;
+
+  str = parse_skip(str, end);
+  if (str < end && *str == '+')
+  {
+    ++str;
+  }
+
+  *value = 0;
+  for (digits = str; str < end && *str >= '0' && *str <= '9'; ++str)
+  {
+    if (*value > (UINT64_MAX - (uint64_t)(*str - '0'))/10)
+    {
+      return (NULL);
+    }
+    *value = 10*(*value) + (uint64_t)(*str - '0');
+  }
+
+  if (str == digits || (str < end && !parse_is_blank(*str)))
+  {
+    return (NULL);
+  }
+
+  return (str);
+}
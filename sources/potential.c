@@ -16,7 +16,13 @@
 #include "util.h"
 #include "vec3.h"
 
-universe_t *potential_bond(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2)
+/* Position of an atom other than the one feeling the potential: the universe's, or pos's if given */
+static const vec3_t *potential_pos(const universe_t *universe, const vec3_t *pos, const uint64_t atom_id)
+{
+  return ((pos == NULL) ? &(universe->atom[atom_id].pos) : &(pos[atom_id]));
+}
+
+universe_t *potential_bond(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec)
 {
   atom_t *atom_1;
   atom_t *atom_2;
@@ -26,18 +32,17 @@ universe_t *potential_bond(double *pot, universe_t *universe, const uint64_t a1,
   double displacement;
   int bond_id;
   double dst;
-  vec3_t vec;
+  vec3_t unit;
 
   /* Makes the code easier to read */
   atom_1 = &(universe->atom[a1]);
   atom_2 = &(universe->atom[a2]);
 
   /* Get the distance between the atoms */
-  vec3_sub(&vec, &(atom_2->pos), &(atom_1->pos));
-  dst = vec3_mag(&vec);
+  dst = vec3_mag(vec);
 
   /* Turn it into its unit vector */
-  if (vec3_unit(&vec, &vec) == NULL)
+  if (vec3_unit(&unit, vec) == NULL)
   {
     return (retstr(NULL, TEXT_POTENTIAL_BOND_FAILURE, __FILE__, __LINE__));
   }
@@ -63,47 +68,40 @@ universe_t *potential_bond(double *pot, universe_t *universe, const uint64_t a1,
   return (universe);
 }
 
-universe_t *potential_electrostatic(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2)
+universe_t *potential_electrostatic(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec)
 {
   atom_t *atom_1;
   atom_t *atom_2;
-  double atom1_charge;
-  double atom2_charge;
   double dst;
-  vec3_t vec;
+  vec3_t unit;
 
   /* Makes the code easier to read */
   atom_1 = &(universe->atom[a1]);
   atom_2 = &(universe->atom[a2]);
 
   /* Get the distance between the atoms */
-  vec3_sub(&vec, &(atom_2->pos), &(atom_1->pos));
-  dst = vec3_mag(&vec);
+  dst = vec3_mag(vec);
 
   /* Turn it into its unit vector */
-  if (vec3_unit(&vec, &vec) == NULL)
+  if (vec3_unit(&unit, vec) == NULL)
   {
     return (retstr(NULL, TEXT_POTENTIAL_ELECTROSTATIC_FAILURE, __FILE__, __LINE__));
   }
 
-  /* Convert the charges to their absolute values */
-  atom1_charge = (atom_1->charge < 0.0 ) ? -(atom_1->charge) : (atom_1->charge);
-  atom2_charge = (atom_2->charge < 0.0 ) ? -(atom_2->charge) : (atom_2->charge);
-
   /* Compute the potential */
-  *pot = (atom1_charge * atom2_charge) / (dst*4*M_PI*C_VACUUMPERM);
+  *pot = (atom_1->charge * atom_2->charge) / (dst*4*M_PI*C_VACUUMPERM);
 
   return (universe);
 }
 
-universe_t *potential_lennardjones(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2)
+universe_t *potential_lennardjones(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec)
 {
   atom_t *atom_1;
   atom_t *atom_2;
   double sigma;
   double epsilon;
   double dst;
-  vec3_t vec;
+  vec3_t unit;
 
   /* Makes the code easier to read */
   atom_1 = &(universe->atom[a1]);
@@ -111,12 +109,11 @@ universe_t *potential_lennardjones(double *pot, universe_t *universe, const uint
 
   /* Get the distance between the atoms */
   /* Scale it to Angstroms */
-  vec3_sub(&vec, &(atom_2->pos), &(atom_1->pos));
-  dst = vec3_mag(&vec);
+  dst = vec3_mag(vec);
   dst *= 1E10;
 
   /* Turn it into its unit vector */
-  if (vec3_unit(&vec, &vec) == NULL)
+  if (vec3_unit(&unit, vec) == NULL)
   {
     return (retstr(NULL, TEXT_POTENTIAL_LENNARDJONES_FAILURE, __FILE__, __LINE__));
   }
@@ -125,8 +122,8 @@ universe_t *potential_lennardjones(double *pot, universe_t *universe, const uint
    * (Duffy, E. M.; Severance, D. L.; Jorgensen, W. L.; Isr. J. Chem.1993, 33,  323)
    *
    */
-  sigma = sqrt((universe->atom[a1].sigma)*(universe->atom[a2].sigma));
-  epsilon = sqrt((universe->atom[a1].epsilon)*(universe->atom[a2].epsilon));
+  sigma = sqrt((atom_1->sigma)*(atom_2->sigma));
+  epsilon = sqrt((atom_1->epsilon)*(atom_2->epsilon));
 
   /* Don't compute beyond the cutoff distance */
   if (dst < LENNARDJONES_CUTOFF*sigma)
@@ -145,7 +142,90 @@ universe_t *potential_lennardjones(double *pot, universe_t *universe, const uint
   return (universe);
 }
 
-universe_t *potential_angle(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2)
+universe_t *potential_electrostatic_softcore(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec)
+{
+  atom_t *atom_1;
+  atom_t *atom_2;
+  double dst;
+  double dst_cap;
+
+  /* Makes the code easier to read */
+  atom_1 = &(universe->atom[a1]);
+  atom_2 = &(universe->atom[a2]);
+
+  /* Get the distance between the atoms */
+  dst = vec3_mag(vec);
+
+  /* Compute the potential */
+  dst_cap = SOFTCORE_COULOMB_RADIUS*sqrt(1 - universe->lambda);
+  if (dst < dst_cap)
+  {
+    /* Below the capping distance, the potential is extended linearly from the cap */
+    *pot = (atom_1->charge * atom_2->charge) * (2*dst_cap - dst) / (POW2(dst_cap)*4*M_PI*C_VACUUMPERM);
+  }
+  else
+  {
+    *pot = (atom_1->charge * atom_2->charge) / (dst*4*M_PI*C_VACUUMPERM);
+  }
+
+  return (universe);
+}
+
+universe_t *potential_lennardjones_softcore(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec)
+{
+  atom_t *atom_1;
+  atom_t *atom_2;
+  double sigma;
+  double epsilon;
+  double dst;
+  double dst_cap;
+  double slope;
+
+  /* Makes the code easier to read */
+  atom_1 = &(universe->atom[a1]);
+  atom_2 = &(universe->atom[a2]);
+
+  /* Get the distance between the atoms */
+  /* Scale it to Angstroms */
+  dst = vec3_mag(vec);
+  dst *= 1E10;
+
+  /* Compute the Lennard-Jones parameters
+   * (Duffy, E. M.; Severance, D. L.; Jorgensen, W. L.; Isr. J. Chem.1993, 33,  323)
+   *
+   */
+  sigma = sqrt((atom_1->sigma)*(atom_2->sigma));
+  epsilon = sqrt((atom_1->epsilon)*(atom_2->epsilon));
+
+  /* Don't compute beyond the cutoff distance */
+  if (dst < LENNARDJONES_CUTOFF*sigma)
+  {
+    dst_cap = SOFTCORE_LENNARDJONES_RADIUS*sigma*pow(1 - universe->lambda, 1.0/6.0);
+    if (dst < dst_cap)
+    {
+      /* Below the capping distance, the potential is extended linearly from the cap */
+      slope = -48*epsilon*((POW12(sigma)/POW13(dst_cap)) - 0.5*(POW6(sigma)/POW7(dst_cap)));
+      *pot = 4*epsilon*(POW12(sigma/dst_cap)-POW6(sigma/dst_cap)) + slope*(dst - dst_cap);
+    }
+    else
+    {
+      *pot = 4*epsilon*(POW12(sigma/dst)-POW6(sigma/dst));
+    }
+
+    /* Scale the potential from kJ.mol-1 to Joules */
+    *pot *= 1.66053892103219E-21;
+  }
+
+  else
+  {
+    /* Initialize the potential */
+    *pot = 0.0;
+  }
+
+  return (universe);
+}
+
+universe_t *potential_angle(double *pot, universe_t *universe, const uint64_t a1, const uint64_t a2, const vec3_t *vec, const vec3_t *pos)
 {
   /* This function is a bit complex so here is a rundown:
    * a1 is bonded to a2, but a2 can be bonded to more atoms.
@@ -171,7 +251,6 @@ universe_t *potential_angle(double *pot, universe_t *universe, const uint64_t a1
   double to_ligand_mag;
   vec3_t to_current;
   vec3_t to_ligand;
-  vec3_t pos_backup;
   atom_t *current;
   atom_t *ligand;
   atom_t *node;
@@ -190,7 +269,7 @@ universe_t *potential_angle(double *pot, universe_t *universe, const uint64_t a1
   }
 
   /* Get the vector going from the node to the current atom */
-  vec3_sub(&to_current, &(current->pos), &(node->pos));
+  vec3_mul(&to_current, vec, -1.0);
 
   /* As well as its magnitude */
   to_current_mag = vec3_mag(&to_current);
@@ -204,41 +283,7 @@ universe_t *potential_angle(double *pot, universe_t *universe, const uint64_t a1
     if (ligand != NULL && ligand != current)
     {
       /* Get the vector going from the node to the ligand */
-      vec3_sub(&to_ligand, &(ligand->pos), &(node->pos));
-
-      /* PERIODIC BOUNDARY CONDITIONS */
-      pos_backup = ligand->pos;
-
-      if (to_ligand.x > 0.5*(universe->size))
-      {
-        ligand->pos.x -= universe->size;
-      }
-
-      else if (to_ligand.x <= -0.5*(universe->size))
-      {
-        ligand->pos.x += universe->size;
-      }
-
-      if (to_ligand.y > 0.5*(universe->size))
-      {
-        ligand->pos.y -= universe->size;
-      }
-
-      else if (to_ligand.y <= -0.5*(universe->size))
-      {
-        ligand->pos.y += universe->size;
-      }
-
-      if (to_ligand.z > 0.5*(universe->size))
-      {
-        ligand->pos.z -= universe->size;
-      }
-
-      else if (to_ligand.z <= -0.5*(universe->size))
-      {
-        ligand->pos.z += universe->size;
-      }
-      /* PERIODIC BOUNDARY CONDITIONS */
+      atom_pbc_vector_pos(&to_ligand, universe, potential_pos(universe, pos, a2), potential_pos(universe, pos, node->bond[i]));
 
       /* Get its magnitude */
       to_ligand_mag = vec3_mag(&to_ligand);
@@ -253,9 +298,6 @@ universe_t *potential_angle(double *pot, universe_t *universe, const uint64_t a1
       /* Compute the potential U=(k/2)*(angle^2) */
       angular_displacement = angle - angle_eq;
       *pot += 0.5*C_AHO*POW2(angular_displacement);
-
-      /* Restore the backup coordinates */
-      ligand->pos = pos_backup;
     }
   }
 
@@ -263,10 +305,14 @@ universe_t *potential_angle(double *pot, universe_t *universe, const uint64_t a1
 }
 
 universe_t *potential_total(double *pot, universe_t *universe, const uint64_t atom_id)
+{
+  return (potential_total_at(pot, universe, atom_id, &(universe->atom[atom_id].pos), NULL));
+}
+
+universe_t *potential_total_at(double *pot, universe_t *universe, const uint64_t atom_id, const vec3_t *pos_id, const vec3_t *pos)
 {
   size_t i;
-  vec3_t to_target;
-  vec3_t pos_backup;
+  vec3_t vec;
   double pot_bond;
   double pot_electrostatic;
   double pot_lennardjones;
@@ -281,55 +327,17 @@ universe_t *potential_total(double *pot, universe_t *universe, const uint64_t at
     /* That isn't the same as the current one */
     if (i != atom_id)
     {
-      /* PERIODIC BOUNDARY CONDITIONS */
-      /* Backup the atom's coordinates */
-      pos_backup = universe->atom[i].pos;
-
-      /* Get the vector going to the target atom */
-      vec3_sub(&to_target, &(universe->atom[i].pos), &(universe->atom[atom_id].pos));
-
-      /* Temporarily undo the PBC enforcement, if needed */
-      if (to_target.x > 0.5*(universe->size))
-      {
-        universe->atom[i].pos.x -= universe->size;
-      }
-      
-      else if (to_target.x <= -0.5*(universe->size))
-      {
-        universe->atom[i].pos.x += universe->size;
-      }
-
-      if (to_target.y > 0.5*(universe->size))
-      {
-        universe->atom[i].pos.y -= universe->size;
-      }
-        
-      else if (to_target.y <= -0.5*(universe->size))
-      {
-        universe->atom[i].pos.y += universe->size;
-      }
-
-      if (to_target.z > 0.5*(universe->size))
-      {
-        universe->atom[i].pos.z -= universe->size;
-      }
-        
-      else if (to_target.z <= -0.5*(universe->size))
-      {
-        universe->atom[i].pos.z += universe->size;
-      }
-
-      /* PERIODIC BOUNDARY CONDITIONS */
+      atom_pbc_vector_pos(&vec, universe, pos_id, potential_pos(universe, pos, i));
 
       /* Bonded interractions */
       if (atom_is_bonded(universe, atom_id, i))
       {
-        if (potential_bond(&pot_bond, universe, atom_id, i) == NULL)
+        if (potential_bond(&pot_bond, universe, atom_id, i, &vec) == NULL)
         {
           return (retstr(NULL, TEXT_POTENTIAL_TOTAL_FAILURE, __FILE__, __LINE__));
         }
           
-        if (potential_angle(&pot_angle, universe, atom_id, i) == NULL)
+        if (potential_angle(&pot_angle, universe, atom_id, i, &vec, pos) == NULL)
         {
           return (retstr(NULL, TEXT_POTENTIAL_TOTAL_FAILURE, __FILE__, __LINE__));
         }
@@ -342,14 +350,31 @@ universe_t *potential_total(double *pot, universe_t *universe, const uint64_t at
       /* Non-bonded interractions */
       else
       {
-        if (potential_electrostatic(&pot_electrostatic, universe, atom_id, i) == NULL)
+        /* Soften the potentials if they are being switched on */
+        if (universe->lambda < 1.0)
         {
-          return (retstr(NULL, TEXT_POTENTIAL_TOTAL_FAILURE, __FILE__, __LINE__));
+          if (potential_electrostatic_softcore(&pot_electrostatic, universe, atom_id, i, &vec) == NULL)
+          {
+            return (retstr(NULL, TEXT_POTENTIAL_TOTAL_FAILURE, __FILE__, __LINE__));
+          }
+
+          if (potential_lennardjones_softcore(&pot_lennardjones, universe, atom_id, i, &vec) == NULL)
+          {
+            return (retstr(NULL, TEXT_POTENTIAL_TOTAL_FAILURE, __FILE__, __LINE__));
+          }
         }
-          
-        if (potential_lennardjones(&pot_lennardjones, universe, atom_id, i) == NULL)
+
+        else
         {
-          return (retstr(NULL, TEXT_POTENTIAL_TOTAL_FAILURE, __FILE__, __LINE__));
+          if (potential_electrostatic(&pot_electrostatic, universe, atom_id, i, &vec) == NULL)
+          {
+            return (retstr(NULL, TEXT_POTENTIAL_TOTAL_FAILURE, __FILE__, __LINE__));
+          }
+
+          if (potential_lennardjones(&pot_lennardjones, universe, atom_id, i, &vec) == NULL)
+          {
+            return (retstr(NULL, TEXT_POTENTIAL_TOTAL_FAILURE, __FILE__, __LINE__));
+          }
         }
 
         /* Sum the potentials */
@@ -357,9 +382,6 @@ universe_t *potential_total(double *pot, universe_t *universe, const uint64_t at
         *pot += pot_electrostatic;
         *pot += pot_lennardjones;
       }
-
-      /* Restore the backup coordinates */
-      universe->atom[i].pos = pos_backup;
     }
   }
 
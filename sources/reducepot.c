@@ -8,15 +8,25 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
+#include <omp.h>
 
 #include "config.h"
+#include "cell.h"
+#include "rng.h"
 #include "text.h"
+#include "vec3.h"
 #include "util.h"
 #include "universe.h"
+#include "potential.h"
 
 /* Move the atoms around until a target potential is reached */
 universe_t *universe_reducepot(universe_t *universe, args_t *args)
 {
+  size_t i;
+  size_t lambda_id;                         /* Index of the current soft-core coupling */
+  uint64_t cycle_nb_softcore;               /* How many cycles of soft-core descent we went through */
+  uint64_t cycle_nb_rigid;                  /* How many cycles of rigid molecule descent we went through */
   uint64_t cycle_nb_coarse;                 /* How many cycles of wiggling we went through */
   uint64_t cycle_nb_fine;                   /* How many cycles of gradient descent we went through */
   double potential_last_cycle;              /* Potential energy at the last cycle */
@@ -25,6 +35,7 @@ universe_t *universe_reducepot(universe_t *universe, args_t *args)
   double potential_reduced_so_far;
   double potential_to_reduce;
   double progress;
+  double step;                              /* (m) Largest displacement of the soft-core and rigid descents */
 
   /* Compute and print the current potential */
   if (universe_energy_potential(universe, &potential) == NULL)
@@ -45,10 +56,108 @@ universe_t *universe_reducepot(universe_t *universe, args_t *args)
 
   /* Print the message that says we're starting potential reduction */
   printf(TEXT_UNIVERSE_REDUCEPOT_START);
+  potential_reduced_so_far = 0.0;
+
+  /* PHASE 0 - SOFT-CORE WARM-UP */
+  if (args->softcore)
+  {
+    cycle_nb_softcore = 0;
+    step = UNIVERSE_REDUCEPOT_SOFTCORE_STEP;
+    printf(TEXT_UNIVERSE_REDUCEPOT_SOFTCORE_START);
+
+    /* Switch the nonbonded potentials on progressively */
+    for (lambda_id=0; UNIVERSE_REDUCEPOT_SOFTCORE_LAMBDA_START + lambda_id*UNIVERSE_REDUCEPOT_SOFTCORE_LAMBDA_STEP < 1.0; ++lambda_id)
+    {
+      universe->lambda = UNIVERSE_REDUCEPOT_SOFTCORE_LAMBDA_START + lambda_id*UNIVERSE_REDUCEPOT_SOFTCORE_LAMBDA_STEP;
+
+      for (i=0; i<UNIVERSE_REDUCEPOT_SOFTCORE_CYCLES; ++i)
+      {
+        ++cycle_nb_softcore;
+        if (universe_reducepot_softcore(universe, &step) == NULL)
+        {
+          universe->lambda = 1.0;
+          return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_FAILURE, __FILE__, __LINE__));
+        }
+      }
+
+      /* Print current status */
+      if (universe_energy_potential(universe, &potential) == NULL)
+      {
+        universe->lambda = 1.0;
+        return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_FAILURE, __FILE__, __LINE__));
+      }
+      printf(TEXT_UNIVERSE_REDUCEPOT_SOFTCORE_SUCCESS, potential*1E12, universe->lambda, cycle_nb_softcore);
+      fflush(stdout);
+    }
+
+    /* Back to the real potentials */
+    universe->lambda = 1.0;
+    printf("\n");
+
+    potential_last_cycle = potential_to_reduce + args->reduce_potential;
+    if (universe_energy_potential(universe, &potential) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_FAILURE, __FILE__, __LINE__));
+    }
+    potential_reduced_so_far = potential_last_cycle - potential;
+    printf(TEXT_UNIVERSE_REDUCEPOT_CURRENT_POT, potential*1E12, args->reduce_potential * 1E12);
+
+    /* Exit if we don't need to reduce the potential any more */
+    if (potential < args->reduce_potential)
+    {
+      printf(TEXT_UNIVERSE_REDUCEPOT_SUCCESS);
+      return (universe);
+    }
+  }
+
+  /* PHASE 0B - RIGID MOLECULES */
+  if (args->rigid)
+  {
+    cycle_nb_rigid = 0;
+    step = UNIVERSE_REDUCEPOT_RIGID_STEP;
+    printf(TEXT_UNIVERSE_REDUCEPOT_RIGID_START);
+    while (step > UNIVERSE_REDUCEPOT_RIGID_MIN_STEP && cycle_nb_rigid < UNIVERSE_REDUCEPOT_RIGID_MAX_CYCLES)
+    {
+      potential_last_cycle = potential;
+
+      /* Increment how many cycles we went through */
+      ++cycle_nb_rigid;
+
+      if (universe_reducepot_rigid(universe, &step) == NULL)
+      {
+        return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_FAILURE, __FILE__, __LINE__));
+      }
+
+      /* Update the system's potential energy */
+      if (universe_energy_potential(universe, &potential) == NULL)
+      {
+        return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_FAILURE, __FILE__, __LINE__));
+      }
+
+      /* Compute how much the potential changed, and the current progress */
+      potential_delta = potential_last_cycle - potential;
+      potential_reduced_so_far += potential_delta;
+      progress = potential_reduced_so_far / potential_to_reduce;
+
+      /* Print current status */
+      printf(TEXT_UNIVERSE_REDUCEPOT_RIGID_SUCCESS, potential_delta*1E12, potential*1E12, cycle_nb_rigid, progress*1E2);
+      fflush(stdout);
+
+      /* Exit if we don't need to reduce the potential any more */
+      if (potential < args->reduce_potential)
+      {
+        printf("\n");
+        printf(TEXT_UNIVERSE_REDUCEPOT_SUCCESS);
+        return (universe);
+      }
+    }
+
+    /* We need to print a new line, that last message doesn't print its own */
+    printf("\n");
+  }
 
   /* PHASE 1 - BRUTEFORCE/WIGGLING */
   cycle_nb_coarse = 0;
-  potential_reduced_so_far = 0.0;
   potential_delta = 0.0;
   progress = 0.0;
   printf(TEXT_UNIVERSE_REDUCEPOT_COARSE_START);
@@ -59,7 +168,14 @@ universe_t *universe_reducepot(universe_t *universe, args_t *args)
     /* Increment how many cycles we went through */
     ++cycle_nb_coarse;
 
-    if (universe_reducepot_coarse(universe) == NULL)
+    if (args->parallel_coarse)
+    {
+      if (universe_reducepot_coarse_parallel(universe) == NULL)
+      {
+        return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_FAILURE, __FILE__, __LINE__));
+      }
+    }
+    else if (universe_reducepot_coarse(universe) == NULL)
     {
       return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_FAILURE, __FILE__, __LINE__));
     }
@@ -165,6 +281,290 @@ universe_t *universe_reducepot(universe_t *universe, args_t *args)
   return (universe);
 }
 
+/* Move all the atoms at once down the soft-core potential gradient (steepest descent) */
+universe_t *universe_reducepot_softcore(universe_t *universe, double *step)
+{
+  size_t i;
+  double pot_pre;
+  double pot_post;
+  double frc_max;
+  vec3_t *pos_pre;
+  vec3_t displacement;
+
+  /* Backup the coordinates */
+  if ((pos_pre = malloc(sizeof(vec3_t)*(universe->atom_nb))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_SOFTCORE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Compute the potential before the transformation */
+  if (universe_energy_potential(universe, &pot_pre) == NULL)
+  {
+    free(pos_pre);
+    return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_SOFTCORE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Compute the potential gradient (=force) with respect to each atom's coordinates */
+  frc_max = 0.0;
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    pos_pre[i] = universe->atom[i].pos;
+
+    if (atom_update_frc_analytical(universe, i, 0) == NULL)
+    {
+      free(pos_pre);
+      return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_SOFTCORE_FAILURE, __FILE__, __LINE__));
+    }
+
+    if (vec3_mag(&(universe->atom[i].frc)) > frc_max)
+    {
+      frc_max = vec3_mag(&(universe->atom[i].frc));
+    }
+  }
+
+  /* Nothing to do if we're already at a stationary point */
+  if (frc_max < DIV_THRESHOLD)
+  {
+    free(pos_pre);
+    return (universe);
+  }
+
+  /* Step along the gradient, the most strained atom moving by the step length */
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    vec3_mul(&displacement, &(universe->atom[i].frc), (*step)/frc_max);
+    vec3_add(&(universe->atom[i].pos), &(universe->atom[i].pos), &displacement);
+
+    if (atom_enforce_pbc(universe, i) == NULL)
+    {
+      free(pos_pre);
+      return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_SOFTCORE_FAILURE, __FILE__, __LINE__));
+    }
+  }
+
+  /* Compute the potential after the transformation */
+  if (universe_energy_potential(universe, &pot_post) == NULL)
+  {
+    free(pos_pre);
+    return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_SOFTCORE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Grow the step on success, discard the transformation and shrink the step otherwise */
+  if (pot_post < pot_pre)
+  {
+    *step *= UNIVERSE_REDUCEPOT_SOFTCORE_STEP_GROWTH;
+  }
+  else
+  {
+    for (i=0; i<(universe->atom_nb); ++i)
+    {
+      universe->atom[i].pos = pos_pre[i];
+    }
+    *step *= UNIVERSE_REDUCEPOT_SOFTCORE_STEP_SHRINK;
+  }
+
+  free(pos_pre);
+  return (universe);
+}
+
+/* Get the range of atoms making up a molecule (substrate copies first, then solvent copies) */
+static void reducepot_molecule(const universe_t *universe, const uint64_t molecule, uint64_t *first, uint64_t *atom_nb)
+{
+  if (molecule < universe->copy_nb)
+  {
+    *first = molecule*(universe->substrate_atom_nb);
+    *atom_nb = universe->substrate_atom_nb;
+  }
+  else
+  {
+    *first = (universe->copy_nb)*(universe->substrate_atom_nb) + (molecule - universe->copy_nb)*(universe->solvent_atom_nb);
+    *atom_nb = universe->solvent_atom_nb;
+  }
+}
+
+/* Compute the potential energy felt by the atoms of a molecule */
+static universe_t *reducepot_molecule_potential(universe_t *universe, const uint64_t first, const uint64_t atom_nb, double *pot)
+{
+  size_t i;
+  double pot_atom;
+
+  *pot = 0.0;
+  for (i=first; i<first+atom_nb; ++i)
+  {
+    if (potential_total(&pot_atom, universe, i) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_RIGID_FAILURE, __FILE__, __LINE__));
+    }
+    *pot += pot_atom;
+  }
+
+  return (universe);
+}
+
+/* Move each molecule as a rigid body (translation + rotation) down the potential gradient */
+universe_t *universe_reducepot_rigid(universe_t *universe, double *step)
+{
+  size_t i;
+  uint64_t molecule;
+  uint64_t molecule_nb;
+  uint64_t first;
+  uint64_t atom_nb;
+  uint64_t accepted;
+  double pot_pre;
+  double pot_post;
+  double radius;         /* (m) Distance from the centroid to the farthest atom */
+  double frc_mag;        /* (N) Magnitude of the net force */
+  double trq_mag;        /* (N) Magnitude of the net torque, over the radius */
+  double scale;
+  vec3_t *pos_pre;
+  vec3_t *offset;        /* Atom positions relative to the centroid, through the periodic boundaries */
+  vec3_t centroid;
+  vec3_t frc;            /* Net force on the molecule */
+  vec3_t trq;            /* Net torque on the molecule, about its centroid */
+  vec3_t vec;
+  mat3_t rot;
+
+  /* Find the largest molecule, to size the buffers */
+  molecule_nb = (universe->copy_nb) + (universe->solvent_copy_nb);
+  atom_nb = (universe->substrate_atom_nb > universe->solvent_atom_nb) ? universe->substrate_atom_nb : universe->solvent_atom_nb;
+
+  if ((pos_pre = malloc(sizeof(vec3_t)*atom_nb)) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_RIGID_FAILURE, __FILE__, __LINE__));
+  }
+
+  if ((offset = malloc(sizeof(vec3_t)*atom_nb)) == NULL)
+  {
+    free(pos_pre);
+    return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_RIGID_FAILURE, __FILE__, __LINE__));
+  }
+
+  accepted = 0;
+  for (molecule=0; molecule<molecule_nb; ++molecule)
+  {
+    reducepot_molecule(universe, molecule, &first, &atom_nb);
+
+    /* Unwrap the molecule around its first atom, and get its centroid */
+    centroid.x = 0.0;
+    centroid.y = 0.0;
+    centroid.z = 0.0;
+    for (i=0; i<atom_nb; ++i)
+    {
+      pos_pre[i] = universe->atom[first + i].pos;
+
+      atom_pbc_vector(&(offset[i]), universe, first, first + i);
+      vec3_add(&centroid, &centroid, &(offset[i]));
+    }
+    vec3_div(&centroid, &centroid, (double)atom_nb);
+
+    /* Get the net force and torque, from the forces on each atom */
+    radius = 0.0;
+    frc.x = 0.0;
+    frc.y = 0.0;
+    frc.z = 0.0;
+    trq = frc;
+    for (i=0; i<atom_nb; ++i)
+    {
+      vec3_sub(&(offset[i]), &(offset[i]), &centroid);
+      if (vec3_mag(&(offset[i])) > radius)
+      {
+        radius = vec3_mag(&(offset[i]));
+      }
+
+      if (atom_update_frc_analytical(universe, first + i, 0) == NULL)
+      {
+        free(pos_pre);
+        free(offset);
+        return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_RIGID_FAILURE, __FILE__, __LINE__));
+      }
+
+      vec3_add(&frc, &frc, &(universe->atom[first + i].frc));
+      vec3_cross(&vec, &(offset[i]), &(universe->atom[first + i].frc));
+      vec3_add(&trq, &trq, &vec);
+    }
+    vec3_add(&centroid, &centroid, &(pos_pre[0]));
+
+    /* A lone atom can't rotate */
+    frc_mag = vec3_mag(&frc);
+    trq_mag = (radius > DIV_THRESHOLD) ? vec3_mag(&trq)/radius : 0.0;
+
+    /* Nothing to do if the molecule is at a stationary point */
+    scale = (frc_mag > trq_mag) ? frc_mag : trq_mag;
+    if (scale < DIV_THRESHOLD)
+    {
+      continue;
+    }
+
+    if (reducepot_molecule_potential(universe, first, atom_nb, &pot_pre) == NULL)
+    {
+      free(pos_pre);
+      free(offset);
+      return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_RIGID_FAILURE, __FILE__, __LINE__));
+    }
+
+    /* Rotate about the torque, the farthest atom moving by at most the step length */
+    if (trq_mag > DIV_THRESHOLD)
+    {
+      vec3_unit(&vec, &trq);
+      mat3_transform_gen_rot(&rot, &vec, (*step)*(trq_mag/scale)/radius);
+      for (i=0; i<atom_nb; ++i)
+      {
+        mat3_transform_apply(&rot, &(offset[i]));
+      }
+    }
+
+    /* Translate along the force, by at most the step length */
+    vec3_mul(&vec, &frc, (*step)/scale);
+    vec3_add(&centroid, &centroid, &vec);
+
+    /* Apply the transformation */
+    for (i=0; i<atom_nb; ++i)
+    {
+      vec3_add(&(universe->atom[first + i].pos), &centroid, &(offset[i]));
+      if (atom_enforce_pbc(universe, first + i) == NULL)
+      {
+        free(pos_pre);
+        free(offset);
+        return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_RIGID_FAILURE, __FILE__, __LINE__));
+      }
+    }
+
+    if (reducepot_molecule_potential(universe, first, atom_nb, &pot_post) == NULL)
+    {
+      free(pos_pre);
+      free(offset);
+      return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_RIGID_FAILURE, __FILE__, __LINE__));
+    }
+
+    /* If the potential increased, discard the transformation */
+    if (pot_post < pot_pre)
+    {
+      ++accepted;
+    }
+    else
+    {
+      for (i=0; i<atom_nb; ++i)
+      {
+        universe->atom[first + i].pos = pos_pre[i];
+      }
+    }
+  }
+
+  /* Grow the step if most molecules moved, shrink it otherwise */
+  if (2*accepted > molecule_nb)
+  {
+    *step *= UNIVERSE_REDUCEPOT_RIGID_STEP_GROWTH;
+  }
+  else
+  {
+    *step *= UNIVERSE_REDUCEPOT_RIGID_STEP_SHRINK;
+  }
+
+  free(pos_pre);
+  free(offset);
+  return (universe);
+}
+
 /* Apply transformations to lower the system's potential energy (wiggling) */
 universe_t *universe_reducepot_coarse(universe_t *universe)
 {
@@ -231,6 +631,209 @@ universe_t *universe_reducepot_coarse(universe_t *universe)
   return (universe);
 }
 
+/* Wiggle an atom until the potential it feels from the other atoms, at pos, is lowered */
+static universe_t *reducepot_coarse_atom(universe_t *universe, const uint64_t atom_id, const double max_step, rng_t *rng, const vec3_t *pos)
+{
+  size_t tries;
+  double step_magnitude;
+  double pot_pre;
+  double pot_post;
+  vec3_t step;
+  vec3_t pos_pre;
+
+  /* Backup the coordinates */
+  pos_pre = universe->atom[atom_id].pos;
+
+  /* Compute the pre-transformation potential */
+  if (potential_total_at(&pot_pre, universe, atom_id, &(universe->atom[atom_id].pos), pos) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_COARSE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Until we lower the potential */
+  tries = 0;
+  step_magnitude = max_step;
+  do
+  {
+    /* Reset the displacement */
+    universe->atom[atom_id].pos = pos_pre;
+
+    /* Compute the displacement magnitude */
+    if (tries == UNIVERSE_REDUCEPOT_COARSE_MAX_ATTEMPTS)
+    {
+      tries = 0;
+      step_magnitude *= UNIVERSE_REDUCEPOT_COARSE_MAGNITUDE_MULTIPLIER;
+    }
+    else
+      ++tries;
+
+    /* Compute and apply the displacement */
+    rng_marsaglia(&step, rng);
+    vec3_mul(&step, &step, step_magnitude);
+    vec3_add(&(universe->atom[atom_id].pos), &(universe->atom[atom_id].pos), &step);
+
+    /* Enforce PBCs */
+    if (atom_enforce_pbc(universe, atom_id) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_COARSE_FAILURE, __FILE__, __LINE__));
+    }
+
+    /* Compute the post-transformation potential */
+    if (potential_total_at(&pot_post, universe, atom_id, &(universe->atom[atom_id].pos), pos) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_COARSE_FAILURE, __FILE__, __LINE__));
+    }
+  } while (pot_post > pot_pre);
+
+  return (universe);
+}
+
+/* Apply transformations to lower the system's potential energy (wiggling, in parallel)
+ *
+ * The universe is split into cells wider than the reach of the short-range
+ * interactions plus twice the largest displacement, and the cells are coloured
+ * as a 2x2x2 checkerboard. Two cells of the same colour are always at least a
+ * cell apart, so the atoms they hold can be wiggled concurrently: only the
+ * potential felt by the moving atom needs to be compared. The atoms of a cell
+ * are wiggled one after another by the same thread.
+ * The electrostatic interactions still reach the atoms wiggled by the other
+ * threads, so a moving atom feels the others where the colour found them, in a
+ * snapshot of the positions that nothing writes during the colour.
+ * Each cell draws its displacements from a random stream of its own, seeded
+ * from rand() and its colour, so that the result doesn't depend on which
+ * thread wiggles which cell.
+ */
+universe_t *universe_reducepot_coarse_parallel(universe_t *universe)
+{
+  size_t i;
+  int err;
+  uint64_t colour;
+  uint64_t cell;
+  uint64_t cell_total;
+  uint64_t cell_nb;
+  uint64_t cx;
+  uint64_t cy;
+  uint64_t cz;
+  uint64_t seed;
+  double sigma_max;          /* (Å) Largest Lennard-Jones sigma parameter */
+  double radius_max;         /* (m) Largest covalent radius */
+  double reach;              /* (m) Farthest distance at which two atoms interact, apart from electrostatics */
+  double max_step;           /* (m) Largest displacement keeping concurrently wiggled atoms out of reach */
+  rng_t rng;
+  vec3_t *pos;               /* (m) Positions of the atoms when the colour started */
+  cell_grid_t grid;
+
+  /* Get the reach of the Lennard-Jones and bonded (up to the angles) interactions */
+  sigma_max = 0.0;
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    if (universe->atom[i].sigma > sigma_max)
+    {
+      sigma_max = universe->atom[i].sigma;
+    }
+  }
+
+  radius_max = 0.0;
+  for (i=0; i<(universe->model.entry_nb); ++i)
+  {
+    if (universe->model.entry[i].radius_covalent > radius_max)
+    {
+      radius_max = universe->model.entry[i].radius_covalent;
+    }
+  }
+
+  reach = LENNARDJONES_CUTOFF*sigma_max*1E-10;
+  if (4*radius_max > reach)
+  {
+    reach = 4*radius_max;
+  }
+
+  if (cell_grid_init(&grid, universe->size, reach + 2*UNIVERSE_REDUCEPOT_COARSE_PARALLEL_MIN_STEP) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_COARSE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The checkerboard needs an even number of cells along each side, merge them if needed */
+  cell_nb = grid.cell_nb;
+  if (cell_nb > 1 && cell_nb % 2)
+  {
+    cell_grid_clean(&grid);
+    if (cell_grid_init(&grid, universe->size, (1 - 1E-9)*(universe->size)/(cell_nb - 1)) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_COARSE_FAILURE, __FILE__, __LINE__));
+    }
+  }
+  cell_total = (grid.cell_nb)*(grid.cell_nb)*(grid.cell_nb);
+
+  /* Wider cells leave more room to wiggle (a single cell is wiggled serially) */
+  max_step = 0.5*(grid.cell_size - reach);
+  if (grid.cell_nb == 1 || max_step > UNIVERSE_REDUCEPOT_COARSE_STEP_MAGNITUDE)
+  {
+    max_step = UNIVERSE_REDUCEPOT_COARSE_STEP_MAGNITUDE;
+  }
+
+  if ((pos = malloc(sizeof(vec3_t)*(universe->atom_nb))) == NULL)
+  {
+    cell_grid_clean(&grid);
+    return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_COARSE_FAILURE, __FILE__, __LINE__));
+  }
+
+  seed = (uint64_t)rand();
+
+  err = 0;
+  for (colour=0; colour<8; ++colour)
+  {
+    /* Bin the atoms where the previous colours left them */
+    if (cell_grid_fill(&grid, universe->atom, universe->atom_nb) == NULL)
+    {
+      free(pos);
+      cell_grid_clean(&grid);
+      return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_COARSE_FAILURE, __FILE__, __LINE__));
+    }
+
+    /* The moving atoms feel the others where this colour found them */
+#pragma omp parallel for
+    for (i=0; i<(universe->atom_nb); ++i)
+    {
+      pos[i] = universe->atom[i].pos;
+    }
+
+#pragma omp parallel for private(i, cx, cy, cz, rng) schedule(dynamic)
+    for (cell=0; cell<cell_total; ++cell)
+    {
+      cx = cell % grid.cell_nb;
+      cy = (cell / grid.cell_nb) % grid.cell_nb;
+      cz = cell / (grid.cell_nb*grid.cell_nb);
+
+      if (((cx & 1) | ((cy & 1) << 1) | ((cz & 1) << 2)) != colour)
+      {
+        continue;
+      }
+
+      rng_seed(&rng, seed ^ (colour*cell_total + cell));
+      for (i=grid.head[cell]; i!=CELL_GRID_EMPTY; i=grid.next[i])
+      {
+        if (reducepot_coarse_atom(universe, i, max_step, &rng, pos) == NULL)
+        {
+#pragma omp atomic write
+          err = 1;
+        }
+      }
+    }
+
+    if (0 != err)
+    {
+      free(pos);
+      cell_grid_clean(&grid);
+      return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_COARSE_FAILURE, __FILE__, __LINE__));
+    }
+  }
+
+  free(pos);
+  cell_grid_clean(&grid);
+  return (universe);
+}
+
 /* Apply transformations to lower the system's potential energy (gradient descent) */
 universe_t *universe_reducepot_fine(universe_t *universe)
 {
@@ -248,7 +851,7 @@ universe_t *universe_reducepot_fine(universe_t *universe)
     pos_pre = universe->atom[i].pos;
 
     /* Compute the potential gradient with respect to the atom's coordinates (=force) */
-    if (atom_update_frc_analytical(universe, i) == NULL)
+    if (atom_update_frc_analytical(universe, i, 0) == NULL)
     {
       return (retstr(NULL, TEXT_UNIVERSE_REDUCEPOT_FINE_FAILURE, __FILE__, __LINE__));
     }
@@ -266,7 +869,7 @@ universe_t *universe_reducepot_fine(universe_t *universe)
     /* The direction in which the step is taken is derived from the force vector, since force = -nabla*potential */
     /* Motion is just fancy gradient descent that instead of bleeding potential conserves it as kinetic energy */
     /* Think of this algorithm as a simulation without motion, we're just reaching equilibrium without motion */
-    step_magnitude = POW2(UNIVERSE_REDUCEPOT_FINE_TIMESTEP)/(2* universe->model.entry[universe->atom[i].element].mass);
+    step_magnitude = POW2(UNIVERSE_REDUCEPOT_FINE_TIMESTEP)/(2* universe->atom[i].mass);
     vec3_mul(&step, &(universe->atom[i].frc), step_magnitude);
 
     /* Limit the maximum displacement to 1 Angstrom */
@@ -0,0 +1,110 @@
+/*
+ * rng.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "rng.h"
+#include "vec3.h"
+
+/* Rotates x left by k bits */
+#define ROTL64(x, k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+/* Seed the generator, expanding the seed with splitmix64 */
+rng_t *rng_seed(rng_t *rng, const uint64_t seed)
+{
+  size_t i;
+  uint64_t z;
+  uint64_t state;
+
+  state = seed;
+  for (i=0; i<4; ++i)
+  {
+    state += 0x9E3779B97F4A7C15;
+    z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    rng->s[i] = z ^ (z >> 31);
+  }
+
+  return (rng);
+}
+
+/* xoshiro256** (Blackman & Vigna, 2018) */
+uint64_t rng_next(rng_t *rng)
+{
+  uint64_t result;
+  uint64_t t;
+
+  result = ROTL64(rng->s[1] * 5, 7) * 9;
+  t = rng->s[1] << 17;
+
+  rng->s[2] ^= rng->s[0];
+  rng->s[3] ^= rng->s[1];
+  rng->s[1] ^= rng->s[2];
+  rng->s[0] ^= rng->s[3];
+  rng->s[2] ^= t;
+  rng->s[3] = ROTL64(rng->s[3], 45);
+
+  return (result);
+}
+
+/* Use the upper 53 bits, as many as a double can hold */
+double rng_uniform(rng_t *rng)
+{
+  return ((rng_next(rng) >> 11) * 0x1.0p-53);
+}
+
+/* Generate a random vector from the unit sphere */
+vec3_t *rng_marsaglia(vec3_t *v, rng_t *rng)
+{
+  double x1;
+  double x2;
+
+  do
+  {
+    x1 = 2*rng_uniform(rng) - 1;
+    x2 = 2*rng_uniform(rng) - 1;
+  } while ((x1*x1)+(x2*x2) >= 1);
+
+  v->x = 2*x1*sqrt(1-(x1*x1)-(x2*x2));
+  v->y = 2*x2*sqrt(1-(x1*x1)-(x2*x2));
+  v->z = 1-2*((x1*x1)+(x2*x2));
+
+  return (v);
+}
+
+/* Draw a pair of standard normal deviates with the Marsaglia polar method */
+static void rng_gaussian_pair(double *g1, double *g2, rng_t *rng)
+{
+  double x1;
+  double x2;
+  double r2;
+
+  do
+  {
+    x1 = 2*rng_uniform(rng) - 1;
+    x2 = 2*rng_uniform(rng) - 1;
+    r2 = (x1*x1)+(x2*x2);
+  } while (r2 >= 1 || r2 == 0);
+
+  r2 = sqrt(-2*log(r2)/r2);
+  *g1 = x1*r2;
+  *g2 = x2*r2;
+}
+
+/* Generate a vector whose components are independent standard normal deviates */
+vec3_t *rng_gaussian(vec3_t *v, rng_t *rng)
+{
+  double unused;
+
+  rng_gaussian_pair(&(v->x), &(v->y), rng);
+  rng_gaussian_pair(&(v->z), &unused, rng);
+
+  return (v);
+}
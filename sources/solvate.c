@@ -0,0 +1,235 @@
+/*
+ * solvate.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "config.h"
+#include "args.h"
+#include "cell.h"
+#include "model.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+#include "vec3.h"
+
+/* Returns 1 if an atom of the given element located at pos overlaps with any atom binned in the grid */
+static int solvate_overlaps(const universe_t *universe, const cell_grid_t *grid, const vec3_t *pos, const uint64_t element)
+{
+  int64_t dx;
+  int64_t dy;
+  int64_t dz;
+  int64_t range_min;
+  int64_t range_max;
+  int64_t n;
+  uint64_t cx;
+  uint64_t cy;
+  uint64_t cz;
+  uint64_t j;
+  double radius;
+  double overlap;
+  vec3_t vec;
+
+  n = (int64_t)(grid->cell_nb);
+  radius = universe->model.entry[element].radius_vdw;
+  cell_grid_coord(grid, pos, &cx, &cy, &cz);
+
+  /* Scan the neighbouring cells (all of them if there are too few to have distinct neighbours) */
+  if (n < 3)
+  {
+    range_min = 0;
+    range_max = n-1;
+  }
+  else
+  {
+    range_min = -1;
+    range_max = 1;
+  }
+
+  for (dz=range_min; dz<=range_max; ++dz)
+  {
+    for (dy=range_min; dy<=range_max; ++dy)
+    {
+      for (dx=range_min; dx<=range_max; ++dx)
+      {
+        /* Go through the cell's atoms */
+        j = grid->head[cell_grid_index(grid,
+                                       (n < 3) ? (uint64_t)dx : (uint64_t)((((int64_t)cx + dx) % n + n) % n),
+                                       (n < 3) ? (uint64_t)dy : (uint64_t)((((int64_t)cy + dy) % n + n) % n),
+                                       (n < 3) ? (uint64_t)dz : (uint64_t)((((int64_t)cz + dz) % n + n) % n))];
+        for (; j != CELL_GRID_EMPTY; j = grid->next[j])
+        {
+          /* Get the shortest vector going to the atom, through the periodic boundaries */
+          vec3_sub(&vec, &(universe->atom[j].pos), pos);
+          vec.x -= (universe->size)*round(vec.x/(universe->size));
+          vec.y -= (universe->size)*round(vec.y/(universe->size));
+          vec.z -= (universe->size)*round(vec.z/(universe->size));
+
+          overlap = UNIVERSE_SOLVATE_OVERLAP_FACTOR * (radius + universe->model.entry[universe->atom[j].element].radius_vdw);
+          if (vec3_dot(&vec, &vec) < POW2(overlap))
+          {
+            return (1);
+          }
+        }
+      }
+    }
+  }
+
+  return (0);
+}
+
+/* Fill the volume left by the substrate with copies of the solvent */
+universe_t *universe_solvate(universe_t *universe, const args_t *args)
+{
+  size_t i;
+  size_t ii;
+  size_t site;
+  uint64_t site_nb;      /* Number of lattice sites along each side of the universe */
+  uint64_t site_total;   /* Number of lattice sites in the universe */
+  uint64_t kept_nb;      /* Number of solvent molecules that don't overlap the substrate */
+  uint64_t atom_nb;      /* Number of atoms before solvation */
+  uint64_t first;        /* ID of the first atom of a solvent copy */
+  uint8_t *kept;         /* kept[site] is 1 if a solvent molecule can be inserted at site */
+  double mass_mol;       /* Mass of a solvent molecule */
+  double spacing;        /* (m) Distance between two lattice sites */
+  double radius_max;     /* (m) Largest Van der Waals radius */
+  vec3_t centroid;       /* Geometric center of the solvent molecule */
+  vec3_t origin;         /* Location of a lattice site */
+  vec3_t pos;
+  atom_t *atom;
+  cell_grid_t grid;
+
+  /* A void solvent doesn't need to be inserted */
+  if (universe->solvent_atom_nb == 0)
+  {
+    return (universe);
+  }
+
+  /* Get the solvent's molecular mass and geometric center */
+  mass_mol = 0.0;
+  centroid.x = 0.0;
+  centroid.y = 0.0;
+  centroid.z = 0.0;
+  for (i=0; i<(universe->solvent_atom_nb); ++i)
+  {
+    mass_mol += universe->model.entry[universe->solvent_atom[i].element].mass;
+    vec3_add(&centroid, &centroid, &(universe->solvent_atom[i].pos));
+  }
+  vec3_div(&centroid, &centroid, (double)(universe->solvent_atom_nb));
+
+  /* Each solvent molecule gets a cube of the lattice, sized from the solvent density */
+  spacing = cbrt(mass_mol / (args->solvent_density));
+  site_nb = (uint64_t)floor((universe->size) / spacing);
+  if (site_nb == 0)
+  {
+    return (universe);
+  }
+  spacing = (universe->size) / site_nb;
+  site_total = site_nb*site_nb*site_nb;
+
+  /* Bin the substrate atoms into cells as large as the largest possible overlap */
+  radius_max = 0.0;
+  for (i=0; i<(universe->model.entry_nb); ++i)
+  {
+    if (universe->model.entry[i].radius_vdw > radius_max)
+    {
+      radius_max = universe->model.entry[i].radius_vdw;
+    }
+  }
+
+  if (cell_grid_init(&grid, universe->size, 2*UNIVERSE_SOLVATE_OVERLAP_FACTOR*radius_max) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_SOLVATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (cell_grid_fill(&grid, universe->atom, universe->atom_nb) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_SOLVATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  if ((kept = malloc(sizeof(uint8_t)*site_total)) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_SOLVATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Check every lattice site for overlaps with the substrate */
+  kept_nb = 0;
+#pragma omp parallel for private(ii, origin, pos) reduction(+:kept_nb)
+  for (site=0; site<site_total; ++site)
+  {
+    origin.x = -0.5*(universe->size) + (0.5 + (site % site_nb))*spacing;
+    origin.y = -0.5*(universe->size) + (0.5 + ((site / site_nb) % site_nb))*spacing;
+    origin.z = -0.5*(universe->size) + (0.5 + (site / (site_nb*site_nb)))*spacing;
+
+    kept[site] = 1;
+    for (ii=0; ii<(universe->solvent_atom_nb) && kept[site]; ++ii)
+    {
+      vec3_sub(&pos, &(universe->solvent_atom[ii].pos), &centroid);
+      vec3_add(&pos, &pos, &origin);
+
+      if (solvate_overlaps(universe, &grid, &pos, universe->solvent_atom[ii].element))
+      {
+        kept[site] = 0;
+      }
+    }
+
+    kept_nb += kept[site];
+  }
+
+  cell_grid_clean(&grid);
+
+  /* Make room for the solvent */
+  atom_nb = universe->atom_nb;
+  if ((atom = realloc(universe->atom, sizeof(atom_t)*(atom_nb + kept_nb*(universe->solvent_atom_nb)))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_SOLVATE_FAILURE, __FILE__, __LINE__));
+  }
+  universe->atom = atom;
+
+  /* Insert a copy of the solvent at each free lattice site */
+  first = atom_nb;
+  for (site=0; site<site_total; ++site)
+  {
+    if (!kept[site])
+    {
+      continue;
+    }
+
+    origin.x = -0.5*(universe->size) + (0.5 + (site % site_nb))*spacing;
+    origin.y = -0.5*(universe->size) + (0.5 + ((site / site_nb) % site_nb))*spacing;
+    origin.z = -0.5*(universe->size) + (0.5 + (site / (site_nb*site_nb)))*spacing;
+
+    for (ii=0; ii<(universe->solvent_atom_nb); ++ii)
+    {
+      atom_init(&(universe->atom[first + ii]));
+      if (atom_duplicate(&(universe->atom[first + ii]), &(universe->solvent_atom[ii]), first) == NULL)
+      {
+        return (retstr(NULL, TEXT_UNIVERSE_SOLVATE_FAILURE, __FILE__, __LINE__));
+      }
+
+      vec3_sub(&(universe->atom[first + ii].pos), &(universe->atom[first + ii].pos), &centroid);
+      vec3_add(&(universe->atom[first + ii].pos), &(universe->atom[first + ii].pos), &origin);
+      ++(universe->atom_nb);
+
+      if (atom_enforce_pbc(universe, first + ii) == NULL)
+      {
+        return (retstr(NULL, TEXT_UNIVERSE_SOLVATE_FAILURE, __FILE__, __LINE__));
+      }
+    }
+
+    first += universe->solvent_atom_nb;
+  }
+
+  free(kept);
+
+  universe->solvent_copy_nb = kept_nb;
+  printf(TEXT_UNIVERSE_SOLVATE_SUCCESS, kept_nb, site_total - kept_nb);
+
+  return (universe);
+}
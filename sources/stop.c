@@ -0,0 +1,45 @@
+/*
+ * stop.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <signal.h>
+#include <string.h>
+#include <omp.h>
+
+#include "args.h"
+#include "stop.h"
+
+static volatile sig_atomic_t stop_signal = 0; /* Whether a signal asked to stop */
+static double stop_start = 0.0;               /* (s) Wall clock when the program started */
+
+static void stop_handler(int sig)
+{
+  (void)sig;
+  stop_signal = 1;
+}
+
+void stop_init(void)
+{
+  stop_start = omp_get_wtime();
+}
+
+void stop_catch(void)
+{
+  struct sigaction action;
+
+  /* The system calls the signals interrupt are carried on */
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stop_handler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&(action.sa_mask));
+  sigaction(SIGTERM, &action, NULL);
+  sigaction(SIGUSR1, &action, NULL);
+}
+
+int stop_requested(const args_t *args)
+{
+  return (stop_signal || (args->max_walltime > 0.0 && omp_get_wtime() - stop_start >= args->max_walltime));
+}
@@ -0,0 +1,526 @@
+/*
+ * stream.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "args.h"
+#include "parse.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+
+/*
+ * An output stream is given with --stream as the path to its file, followed
+ * by options separated by colons:
+ *   every=N         A frame every N steps, --frameskip's interval by default
+ *   time=T          A frame every T fs of simulated time instead
+ *   format=F        xyz, sxb or energy, after the file's extension by default
+ *   copies=A-B      The atoms of the copies A to B of the substrate
+ *   elements=S,...  The atoms of the given chemical symbols
+ *   atoms=A-B,C,... The atoms of the given indices, or ranges of indices
+ * The copies and the atoms are counted from 1, as in an .mds file, and an
+ * atom has to meet every selection given. An energy stream saves the whole
+ * universe's energies, and selects no atoms.
+ * A rollback cuts each stream's file where it stood at the watchdog's
+ * snapshot, and a restarted run where it stood when the checkpoint was taken,
+ * the streams being matched by their order on the command line.
+ *
+ */
+
+/* Returns the value of the option at [str, end) if it is key's, NULL otherwise */
+static const char *stream_option(const char *str, const char *end, const char *key)
+{
+  size_t len;
+
+  len = strlen(key);
+  if ((size_t)(end - str) <= len || strncmp(str, key, len) || str[len] != '=')
+  {
+    return (NULL);
+  }
+
+  return (str + len + 1);
+}
+
+/* Parse A or A-B at [str, end) */
+static int stream_range(const char *str, const char *end, uint64_t *first, uint64_t *last)
+{
+  const char *dash;
+
+  if ((dash = memchr(str, '-', end - str)) == NULL)
+  {
+    dash = end;
+  }
+
+  if (parse_uint64(str, dash, first) != dash)
+  {
+    return (-1);
+  }
+
+  *last = *first;
+  if (dash < end && parse_uint64(dash + 1, end, last) != end)
+  {
+    return (-1);
+  }
+
+  return ((*first >= 1 && *last >= *first) ? 0 : -1);
+}
+
+/* Mark the atoms the selection at [str, end) holds, the items of a list being separated by commas */
+static int stream_select(const universe_t *universe, const char *key, const char *str, const char *end, uint8_t *hit)
+{
+  const char *item_end;
+  uint64_t first;
+  uint64_t last;
+  size_t i;
+
+  for (; str < end; str = item_end + 1)
+  {
+    if ((item_end = memchr(str, ',', end - str)) == NULL)
+    {
+      item_end = end;
+    }
+
+    if (!strcmp(key, "copies"))
+    {
+      if (stream_range(str, item_end, &first, &last) || last > universe->copy_nb)
+      {
+        return (-1);
+      }
+      memset(hit + (first - 1)*(universe->substrate_atom_nb), 1, (last - first + 1)*(universe->substrate_atom_nb));
+    }
+
+    else if (!strcmp(key, "atoms"))
+    {
+      if (stream_range(str, item_end, &first, &last) || last > universe->atom_nb)
+      {
+        return (-1);
+      }
+      memset(hit + first - 1, 1, last - first + 1);
+    }
+
+    /* The symbols are looked up in the model, and may match several of its entries */
+    else
+    {
+      first = 0;
+      for (i=0; i<(universe->atom_nb); ++i)
+      {
+        const char *symbol = universe->model.entry[universe->atom[i].element].symbol;
+
+        if (symbol != NULL && strlen(symbol) == (size_t)(item_end - str) && !strncmp(symbol, str, item_end - str))
+        {
+          hit[i] = 1;
+          first = 1;
+        }
+      }
+      if (!first)
+      {
+        return (-1);
+      }
+    }
+  }
+
+  return (0);
+}
+
+/* Read a stream's description, and select its atoms */
+static int stream_parse(universe_t *universe, const args_t *args, stream_t *stream, const char *spec)
+{
+  const char *str;
+  const char *end;
+  const char *value;
+  const char *key;
+  uint8_t *selected;
+  uint8_t *hit;
+  int selection;
+  size_t len;
+  size_t i;
+
+  /* The path comes first */
+  if ((end = strchr(spec, ':')) == NULL)
+  {
+    end = spec + strlen(spec);
+  }
+  if (end == spec || (stream->path = malloc(end - spec + 1)) == NULL)
+  {
+    return (-1);
+  }
+  memcpy(stream->path, spec, end - spec);
+  stream->path[end - spec] = '\0';
+
+  len = strlen(stream->path);
+  if (len >= strlen(TRAJ_EXTENSION) && !strcmp(stream->path + len - strlen(TRAJ_EXTENSION), TRAJ_EXTENSION))
+  {
+    stream->format = OUTPUT_FORMAT_SXB;
+  }
+
+  if ((selected = malloc(universe->atom_nb)) == NULL || (hit = malloc(universe->atom_nb)) == NULL)
+  {
+    return (-1);
+  }
+  memset(selected, 1, universe->atom_nb);
+  selection = 0;
+
+  for (str = end; *str == ':'; str = end)
+  {
+    ++str;
+    if ((end = strchr(str, ':')) == NULL)
+    {
+      end = str + strlen(str);
+    }
+
+    if ((value = stream_option(str, end, "every")) != NULL)
+    {
+      if (parse_uint64(value, end, &(stream->every)) != end || stream->every < 1)
+      {
+        return (-1);
+      }
+    }
+
+    else if ((value = stream_option(str, end, "time")) != NULL)
+    {
+      if (parse_double(value, end, &(stream->interval)) != end || !(stream->interval > 0.0))
+      {
+        return (-1);
+      }
+      stream->interval *= 1E-15;
+    }
+
+    else if ((value = stream_option(str, end, "format")) != NULL)
+    {
+      if ((size_t)(end - value) == 3 && !strncmp(value, "xyz", 3))
+      {
+        stream->format = OUTPUT_FORMAT_XYZ;
+      }
+      else if ((size_t)(end - value) == 3 && !strncmp(value, "sxb", 3))
+      {
+        stream->format = OUTPUT_FORMAT_SXB;
+      }
+      else if ((size_t)(end - value) == 6 && !strncmp(value, "energy", 6))
+      {
+        stream->format = OUTPUT_FORMAT_ENERGY;
+      }
+      else
+      {
+        return (-1);
+      }
+    }
+
+    else
+    {
+      key = ((value = stream_option(str, end, "copies")) != NULL) ? "copies"
+          : ((value = stream_option(str, end, "elements")) != NULL) ? "elements"
+          : ((value = stream_option(str, end, "atoms")) != NULL) ? "atoms" : NULL;
+
+      memset(hit, 0, universe->atom_nb);
+      if (key == NULL || stream_select(universe, key, value, end, hit))
+      {
+        return (-1);
+      }
+      for (i=0; i<(universe->atom_nb); ++i)
+      {
+        selected[i] &= hit[i];
+      }
+      selection = 1;
+    }
+  }
+
+  /* Both intervals can't be given, and the energies need every force, which r-RESPA only has once an outer step closes */
+  if (stream->every > 0 && stream->interval > 0.0)
+  {
+    return (-1);
+  }
+  if (stream->every == 0 && stream->interval == 0.0)
+  {
+    stream->every = args->frameskip + 1;
+  }
+  if (stream->format == OUTPUT_FORMAT_ENERGY && (selection || (stream->every % args->respa) != 0))
+  {
+    return (-1);
+  }
+
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    stream->atom_nb += selected[i];
+  }
+  if ((stream->atom = malloc(sizeof(uint64_t)*(stream->atom_nb))) == NULL)
+  {
+    return (-1);
+  }
+  stream->atom_nb = 0;
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    if (selected[i])
+    {
+      stream->atom[stream->atom_nb++] = i;
+    }
+  }
+
+  free(selected);
+  free(hit);
+
+  return ((stream->format == OUTPUT_FORMAT_ENERGY || stream->atom_nb > 0) ? 0 : -1);
+}
+
+/* Whether a stream saves a frame at the given step */
+static int stream_due(const stream_t *stream, const args_t *args, const uint64_t iterations, const double time, const double timestep)
+{
+  if (stream->format == OUTPUT_FORMAT_ENERGY && (iterations % args->respa) != 0)
+  {
+    return (0);
+  }
+
+  if (stream->every > 0)
+  {
+    return ((iterations % stream->every) == 0);
+  }
+
+  /* As the output file's, the frames are saved at the steps closest to their time */
+  return (time >= stream->frame_time - 0.5*timestep);
+}
+
+/* Save the energies of the universe as a line of text */
+static universe_t *stream_energy(universe_t *universe, const stream_t *stream)
+{
+  double ek;
+  double potential;
+  double dof;
+
+  /* Each pair of atoms is summed once from either side */
+  potential = universe->potential;
+  if (!(universe->potential_fresh) && universe_energy_potential(universe, &potential) == NULL)
+  {
+    return (NULL);
+  }
+  potential *= 0.5;
+
+  if (universe_energy_kinetic(universe, &ek) == NULL)
+  {
+    return (NULL);
+  }
+
+  dof = 3.0*(universe->atom_nb) - (universe->constraint_nb) - 3.0*(universe->settle_nb);
+
+  if (fprintf(stream->file, "%ld\t%lf\t%.10E\t%.10E\t%.10E\t%lf\t%lf\n",
+              universe->iterations, universe->time*1E15, ek, potential, ek + potential,
+              2*ek/(dof*C_BOLTZMANN), universe->size*1E10) < 0)
+  {
+    return (NULL);
+  }
+
+  return (universe);
+}
+
+/* Save the positions of the atoms a stream selected as an .xyz frame */
+static universe_t *stream_xyz(universe_t *universe, const stream_t *stream)
+{
+  size_t i;
+  const atom_t *atom;
+
+  if (fprintf(stream->file, "%ld\n%ld\n", stream->atom_nb, universe->iterations) < 0)
+  {
+    return (NULL);
+  }
+
+  for (i=0; i<(stream->atom_nb); ++i)
+  {
+    atom = &(universe->atom[stream->atom[i]]);
+    if (fprintf(stream->file, "%s\t%lf\t%lf\t%lf\n", universe->model.entry[atom->element].symbol,
+                atom->pos.x*1E10, atom->pos.y*1E10, atom->pos.z*1E10) < 0)
+    {
+      return (NULL);
+    }
+  }
+
+  return (universe);
+}
+
+/* Cut the frames saved after the mark off the stream's file */
+static int stream_rewind(stream_t *stream, const stream_mark_t *mark)
+{
+  if (fflush(stream->file)
+      || ftruncate(fileno(stream->file), (off_t)(mark->pos))
+      || fseek(stream->file, (long)(mark->pos), SEEK_SET))
+  {
+    return (-1);
+  }
+
+  stream->frame_time = mark->frame_time;
+  return (0);
+}
+
+/* Read the streams' descriptions, and open their files */
+universe_t *universe_streams_init(universe_t *universe, const args_t *args)
+{
+  stream_t *stream;
+  size_t i;
+  int restarted; /* Whether the stream goes on from the checkpoint */
+
+  if ((universe->stream = malloc(sizeof(stream_t)*(args->stream_nb))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_STREAMS_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  for (i=0; i<(args->stream_nb); ++i)
+  {
+    stream = &(universe->stream[i]);
+    stream->path = STREAM_PATH_DEFAULT;
+    stream->file = STREAM_FILE_DEFAULT;
+    stream->format = STREAM_FORMAT_DEFAULT;
+    stream->every = STREAM_EVERY_DEFAULT;
+    stream->interval = STREAM_INTERVAL_DEFAULT;
+    stream->frame_time = STREAM_FRAME_TIME_DEFAULT;
+    stream->atom_nb = STREAM_ATOM_NB_DEFAULT;
+    stream->atom = STREAM_ATOM_DEFAULT;
+    stream->frame = STREAM_FRAME_DEFAULT;
+    ++(universe->stream_nb);
+
+    if (stream_parse(universe, args, stream, args->stream[i]))
+    {
+      printf(TEXT_UNIVERSE_STREAMS_INVALID, args->stream[i]);
+      return (retstr(NULL, TEXT_UNIVERSE_STREAMS_INIT_FAILURE, __FILE__, __LINE__));
+    }
+
+    /* The frames fall on multiples of the interval, wherever the run starts from */
+    if (stream->interval > 0.0)
+    {
+      stream->frame_time = ceil((universe->time - 0.5*(universe->timestep))/(stream->interval))*(stream->interval);
+    }
+
+    /* A restarted run goes on where the stream stood at the checkpoint, and a binary one already has its header */
+    restarted = (args->path_restart != ARGS_PATH_RESTART_DEFAULT && i < universe->checkpoint.stream_nb);
+    if ((stream->file = fopen(stream->path, restarted ? "a" : "w")) == NULL
+        || (restarted && stream_rewind(stream, &(universe->checkpoint.stream[i]))))
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_STREAMS_INIT_FAILURE, __FILE__, __LINE__));
+    }
+
+    if (stream->format == OUTPUT_FORMAT_SXB)
+    {
+      if ((stream->frame = malloc(3*(stream->atom_nb)*(args->traj_double ? sizeof(double) : sizeof(float)))) == NULL
+          || (ftell(stream->file) == 0 && universe_traj_stream_header(universe, args, stream) == NULL))
+      {
+        return (retstr(NULL, TEXT_UNIVERSE_STREAMS_INIT_FAILURE, __FILE__, __LINE__));
+      }
+    }
+
+    if (stream->format == OUTPUT_FORMAT_ENERGY && ftell(stream->file) == 0 && fputs(STREAM_ENERGY_HEADER, stream->file) < 0)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_STREAMS_INIT_FAILURE, __FILE__, __LINE__));
+    }
+  }
+
+  return (universe);
+}
+
+/* Returns whether a stream of the given format saves a frame at the given step */
+int universe_streams_due(const universe_t *universe, const args_t *args, const uint64_t iterations, const double time, const uint8_t format)
+{
+  size_t i;
+
+  for (i=0; i<(universe->stream_nb); ++i)
+  {
+    if (universe->stream[i].format == format && stream_due(&(universe->stream[i]), args, iterations, time, universe->timestep))
+    {
+      return (1);
+    }
+  }
+
+  return (0);
+}
+
+/* Save a frame to each stream whose turn it is */
+universe_t *universe_streams_write(universe_t *universe, const args_t *args)
+{
+  stream_t *stream;
+  size_t i;
+
+  for (i=0; i<(universe->stream_nb); ++i)
+  {
+    stream = &(universe->stream[i]);
+
+    if (!stream_due(stream, args, universe->iterations, universe->time, universe->timestep))
+    {
+      continue;
+    }
+
+    if ((stream->format == OUTPUT_FORMAT_ENERGY && stream_energy(universe, stream) == NULL)
+        || (stream->format == OUTPUT_FORMAT_XYZ && stream_xyz(universe, stream) == NULL)
+        || (stream->format == OUTPUT_FORMAT_SXB && universe_traj_stream_write(universe, args, stream) == NULL))
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_STREAMS_WRITE_FAILURE, __FILE__, __LINE__));
+    }
+
+    while (stream->interval > 0.0 && stream->frame_time <= universe->time + 0.5*(universe->timestep))
+    {
+      stream->frame_time += stream->interval;
+    }
+  }
+
+  return (universe);
+}
+
+/* Note where each stream stands, once its frames are in its file */
+universe_t *universe_streams_mark(universe_t *universe, stream_mark_t *mark)
+{
+  size_t i;
+  long pos;
+
+  for (i=0; i<(universe->stream_nb); ++i)
+  {
+    if (fflush(universe->stream[i].file) || (pos = ftell(universe->stream[i].file)) < 0)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_STREAMS_MARK_FAILURE, __FILE__, __LINE__));
+    }
+
+    mark[i].pos = (int64_t)pos;
+    mark[i].frame_time = universe->stream[i].frame_time;
+  }
+
+  return (universe);
+}
+
+/* Cut the frames saved after the marks off each stream */
+universe_t *universe_streams_rewind(universe_t *universe, const stream_mark_t *mark)
+{
+  size_t i;
+
+  for (i=0; i<(universe->stream_nb); ++i)
+  {
+    if (stream_rewind(&(universe->stream[i]), &(mark[i])))
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_STREAMS_REWIND_FAILURE, __FILE__, __LINE__));
+    }
+  }
+
+  return (universe);
+}
+
+void universe_streams_clean(universe_t *universe)
+{
+  size_t i;
+
+  for (i=0; i<(universe->stream_nb); ++i)
+  {
+    if (universe->stream[i].file != NULL)
+    {
+      fclose(universe->stream[i].file);
+    }
+    free(universe->stream[i].path);
+    free(universe->stream[i].atom);
+    free(universe->stream[i].frame);
+  }
+  free(universe->stream);
+
+  universe->stream_nb = UNIVERSE_STREAM_NB_DEFAULT;
+  universe->stream = UNIVERSE_STREAM_DEFAULT;
+}
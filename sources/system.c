@@ -0,0 +1,522 @@
+/*
+ * system.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "args.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+#include "vec3.h"
+
+/*
+ * A compiled system is what the loaders build from the model, substrate and
+ * solvent files, laid out flat so that it can be mapped and copied back in
+ * place: a header, the model's entries, the strings (the name, author and
+ * comment of each file, then the name and symbol of each entry, in that
+ * order), then the atoms and bonds of the substrate and of the solvent. Each
+ * atom's bonds follow the previous atom's, both ends of a bond listing it.
+ * Every part is a multiple of 8 bytes long.
+ * The file is named after the hash of the input files, which the header holds
+ * too, so that a file compiled from other inputs is never mistaken for it.
+ * Such a file, or one cut short, is a cache miss, and replaced once the input
+ * files are compiled again.
+ *
+ */
+typedef struct system_header_s system_header_t;
+struct system_header_s
+{
+  char magic[8];              /* SYSTEM_MAGIC */
+  uint64_t version;           /* SYSTEM_VERSION */
+  uint64_t byte_order;        /* 0x0102030405060708, as written by the machine */
+  uint64_t key;               /* Hash of the model, substrate and solvent files */
+  uint64_t entry_nb;          /* Number of entries in the model */
+  uint64_t text_len;          /* Length of the strings, padding included (bytes) */
+  uint64_t substrate_atom_nb; /* Number of atoms in the substrate */
+  uint64_t substrate_bond_nb; /* Number of bonds in the substrate */
+  uint64_t solvent_atom_nb;   /* Number of atoms in the solvent */
+  uint64_t solvent_bond_nb;   /* Number of bonds in the solvent */
+};
+
+typedef struct system_entry_s system_entry_t;
+struct system_entry_s
+{
+  uint64_t id;
+  double mass;
+  double radius_covalent;
+  double radius_vdw;
+  double bond_angle;
+  double lj_epsilon;
+  double lj_sigma;
+};
+
+typedef struct system_atom_s system_atom_t;
+struct system_atom_s
+{
+  vec3_t pos;       /* (m) Position */
+  uint64_t element; /* Entry of the model */
+  double mass;      /* (kg) */
+  double charge;    /* (C) */
+  double epsilon;   /* (J) */
+  double sigma;     /* (m) */
+  uint64_t bond_nb; /* Number of bonds following the previous atom's */
+};
+
+typedef struct system_bond_s system_bond_t;
+struct system_bond_s
+{
+  uint64_t atom;    /* Bonded atom */
+  double strength;  /* (N.m-1) */
+};
+
+/* Get the path of the compiled system matching the input files */
+static char *system_path(const universe_t *universe, const args_t *args)
+{
+  char *path;
+  size_t len;
+
+  len = strlen(args->path_cache) + 1 + 16 + strlen(SYSTEM_EXTENSION) + 1;
+  if ((path = malloc(len)) == NULL)
+  {
+    return (NULL);
+  }
+
+  snprintf(path, len, "%s/%016llx%s", args->path_cache, (unsigned long long)universe->input_hash, SYSTEM_EXTENSION);
+  return (path);
+}
+
+/* Copy the next string of the compiled system */
+static char *system_string(const char **text, const char *text_end)
+{
+  char *str;
+  size_t len;
+
+  len = strnlen(*text, text_end - *text);
+  if (len == (size_t)(text_end - *text) || (str = malloc(len + 1)) == NULL)
+  {
+    return (NULL);
+  }
+  memcpy(str, *text, len + 1);
+  *text += len + 1;
+
+  return (str);
+}
+
+/* Rebuild the atoms of a substrate or solvent, and their bonds */
+static const void *system_atoms_load(const void *data, const void *data_end, const uint64_t entry_nb,
+                                     atom_t **atom, const uint64_t atom_nb, const uint64_t bond_nb)
+{
+  size_t i;
+  const system_atom_t *record;
+  const system_bond_t *bond;
+  uint64_t *bond_first; /* First bond of each atom */
+  int err = 0;
+
+  record = data;
+  bond = (const system_bond_t*)(record + atom_nb);
+  if ((const void*)(bond + 2*bond_nb) > data_end)
+  {
+    return (NULL);
+  }
+
+  if ((*atom = malloc(sizeof(atom_t)*atom_nb)) == NULL || (bond_first = malloc(sizeof(uint64_t)*(atom_nb + 1))) == NULL)
+  {
+    return (NULL);
+  }
+
+  /* Each atom's bonds start where the previous atom's end */
+  bond_first[0] = 0;
+  for (i=0; i<atom_nb; ++i)
+  {
+    bond_first[i+1] = bond_first[i] + record[i].bond_nb;
+  }
+  if (bond_first[atom_nb] != 2*bond_nb)
+  {
+    free(bond_first);
+    return (NULL);
+  }
+
+#pragma omp parallel for
+  for (i=0; i<atom_nb; ++i)
+  {
+    size_t ii;
+    size_t first;
+    atom_t *current;
+
+    current = &((*atom)[i]);
+    atom_init(current);
+
+    current->pos = record[i].pos;
+    current->element = record[i].element;
+    current->mass = record[i].mass;
+    current->charge = record[i].charge;
+    current->epsilon = record[i].epsilon;
+    current->sigma = record[i].sigma;
+    current->bond_nb = (uint8_t)record[i].bond_nb;
+
+    if (record[i].element >= entry_nb || record[i].bond_nb > UINT8_MAX
+        || (current->bond = malloc(sizeof(uint64_t)*(current->bond_nb))) == NULL
+        || (current->bond_strength = malloc(sizeof(double)*(current->bond_nb))) == NULL)
+    {
+#pragma omp atomic write
+      err = 1;
+      continue;
+    }
+
+    first = bond_first[i];
+    for (ii=0; ii<(current->bond_nb); ++ii)
+    {
+      if (bond[first + ii].atom >= atom_nb)
+      {
+#pragma omp atomic write
+        err = 1;
+      }
+      current->bond[ii] = bond[first + ii].atom;
+      current->bond_strength[ii] = bond[first + ii].strength;
+    }
+  }
+
+  free(bond_first);
+  if (0 != err)
+  {
+    return (NULL);
+  }
+
+  return (bond + 2*bond_nb);
+}
+
+/* Write the atoms of a substrate or solvent, and their bonds */
+static int system_atoms_store(FILE *file, const atom_t *atom, const uint64_t atom_nb)
+{
+  size_t i;
+  size_t ii;
+  system_atom_t record;
+  system_bond_t bond;
+
+  for (i=0; i<atom_nb; ++i)
+  {
+    memset(&record, 0, sizeof(record));
+    record.pos = atom[i].pos;
+    record.element = atom[i].element;
+    record.mass = atom[i].mass;
+    record.charge = atom[i].charge;
+    record.epsilon = atom[i].epsilon;
+    record.sigma = atom[i].sigma;
+    record.bond_nb = atom[i].bond_nb;
+
+    if (fwrite(&record, sizeof(record), 1, file) != 1)
+    {
+      return (-1);
+    }
+  }
+
+  for (i=0; i<atom_nb; ++i)
+  {
+    for (ii=0; ii<(atom[i].bond_nb); ++ii)
+    {
+      bond.atom = atom[i].bond[ii];
+      bond.strength = atom[i].bond_strength[ii];
+
+      if (fwrite(&bond, sizeof(bond), 1, file) != 1)
+      {
+        return (-1);
+      }
+    }
+  }
+
+  return (0);
+}
+
+/* Load the model, substrate and solvent, if they were compiled. *hit tells whether they were */
+universe_t *universe_system_load(universe_t *universe, const args_t *args, int *hit)
+{
+  size_t i;
+  int fd;
+  char *path;
+  void *map;
+  struct stat st;
+  const system_header_t *header;
+  const system_entry_t *entry;
+  const char *text;
+  const char *text_end;
+  const void *data;
+  const void *data_end;
+
+  *hit = 0;
+
+  /* Nothing to do without a cache */
+  if (args->path_cache == ARGS_PATH_CACHE_DEFAULT)
+  {
+    return (universe);
+  }
+
+  if ((path = system_path(universe, args)) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_SYSTEM_LOAD_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* A missing file is a cache miss */
+  if ((fd = open(path, O_RDONLY)) == -1)
+  {
+    printf(TEXT_UNIVERSE_SYSTEM_MISS, path);
+    free(path);
+    return (universe);
+  }
+
+  if (fstat(fd, &st) == -1)
+  {
+    close(fd);
+    free(path);
+    return (retstr(NULL, TEXT_UNIVERSE_SYSTEM_LOAD_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* So is a file too short to hold a header, which the compiled system then replaces */
+  if ((size_t)st.st_size < sizeof(system_header_t))
+  {
+    close(fd);
+    printf(TEXT_UNIVERSE_SYSTEM_MISS, path);
+    free(path);
+    return (universe);
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    free(path);
+    return (retstr(NULL, TEXT_UNIVERSE_SYSTEM_LOAD_FAILURE, __FILE__, __LINE__));
+  }
+
+  /*
+   * Make sure the file really holds these input files, and is as long as its
+   * header says. If it isn't, it is replaced as missing
+   */
+  header = map;
+  data_end = (const char*)map + st.st_size;
+  if (memcmp(header->magic, SYSTEM_MAGIC, sizeof(SYSTEM_MAGIC))
+      || header->version != SYSTEM_VERSION
+      || header->byte_order != 0x0102030405060708
+      || header->key != universe->input_hash
+      || header->entry_nb > (size_t)st.st_size/sizeof(system_entry_t)
+      || header->text_len > (size_t)st.st_size
+      || header->substrate_atom_nb > (size_t)st.st_size/sizeof(system_atom_t)
+      || header->substrate_bond_nb > (size_t)st.st_size/sizeof(system_bond_t)
+      || header->solvent_atom_nb > (size_t)st.st_size/sizeof(system_atom_t)
+      || header->solvent_bond_nb > (size_t)st.st_size/sizeof(system_bond_t)
+      || sizeof(system_header_t) + (header->entry_nb)*sizeof(system_entry_t) + header->text_len
+         + (header->substrate_atom_nb + header->solvent_atom_nb)*sizeof(system_atom_t)
+         + 2*(header->substrate_bond_nb + header->solvent_bond_nb)*sizeof(system_bond_t) != (size_t)st.st_size)
+  {
+    munmap(map, st.st_size);
+    printf(TEXT_UNIVERSE_SYSTEM_MISS, path);
+    free(path);
+    return (universe);
+  }
+
+  entry = (const system_entry_t*)(header + 1);
+  text = (const char*)(entry + header->entry_nb);
+  text_end = text + header->text_len;
+  data = text_end;
+
+  /* The model */
+  universe->model.entry_nb = header->entry_nb;
+  if ((universe->model.entry = malloc(sizeof(model_entry_t)*(universe->model.entry_nb))) == NULL)
+  {
+    munmap(map, st.st_size);
+    free(path);
+    return (retstr(NULL, TEXT_UNIVERSE_SYSTEM_LOAD_FAILURE, __FILE__, __LINE__));
+  }
+
+  if ((universe->meta_model_name = system_string(&text, text_end)) == NULL
+      || (universe->meta_model_author = system_string(&text, text_end)) == NULL
+      || (universe->meta_model_comment = system_string(&text, text_end)) == NULL
+      || (universe->meta_substrate_name = system_string(&text, text_end)) == NULL
+      || (universe->meta_substrate_author = system_string(&text, text_end)) == NULL
+      || (universe->meta_substrate_comment = system_string(&text, text_end)) == NULL
+      || (universe->meta_solvent_name = system_string(&text, text_end)) == NULL
+      || (universe->meta_solvent_author = system_string(&text, text_end)) == NULL
+      || (universe->meta_solvent_comment = system_string(&text, text_end)) == NULL)
+  {
+    munmap(map, st.st_size);
+    free(path);
+    return (retstr(NULL, TEXT_UNIVERSE_SYSTEM_LOAD_FAILURE, __FILE__, __LINE__));
+  }
+
+  for (i=0; i<(universe->model.entry_nb); ++i)
+  {
+    model_entry_init(&(universe->model.entry[i]));
+    universe->model.entry[i].id = entry[i].id;
+    universe->model.entry[i].mass = entry[i].mass;
+    universe->model.entry[i].radius_covalent = entry[i].radius_covalent;
+    universe->model.entry[i].radius_vdw = entry[i].radius_vdw;
+    universe->model.entry[i].bond_angle = entry[i].bond_angle;
+    universe->model.entry[i].lj_epsilon = entry[i].lj_epsilon;
+    universe->model.entry[i].lj_sigma = entry[i].lj_sigma;
+
+    if ((universe->model.entry[i].name = system_string(&text, text_end)) == NULL
+        || (universe->model.entry[i].symbol = system_string(&text, text_end)) == NULL)
+    {
+      munmap(map, st.st_size);
+      free(path);
+      return (retstr(NULL, TEXT_UNIVERSE_SYSTEM_LOAD_FAILURE, __FILE__, __LINE__));
+    }
+  }
+
+  /* The substrate, then the solvent */
+  universe->substrate_atom_nb = header->substrate_atom_nb;
+  universe->substrate_bond_nb = header->substrate_bond_nb;
+  universe->solvent_atom_nb = header->solvent_atom_nb;
+  universe->solvent_bond_nb = header->solvent_bond_nb;
+  if ((data = system_atoms_load(data, data_end, header->entry_nb, &(universe->substrate_atom), header->substrate_atom_nb, header->substrate_bond_nb)) == NULL
+      || (data = system_atoms_load(data, data_end, header->entry_nb, &(universe->solvent_atom), header->solvent_atom_nb, header->solvent_bond_nb)) == NULL
+      || data != data_end)
+  {
+    munmap(map, st.st_size);
+    free(path);
+    return (retstr(NULL, TEXT_UNIVERSE_SYSTEM_LOAD_FAILURE, __FILE__, __LINE__));
+  }
+
+  munmap(map, st.st_size);
+  printf(TEXT_UNIVERSE_SYSTEM_HIT, path);
+  free(path);
+
+  *hit = 1;
+  return (universe);
+}
+
+/* Write the model, substrate and solvent */
+static int system_write(FILE *file, const void *data)
+{
+  const universe_t *universe;
+  size_t i;
+  size_t len;
+  system_header_t header;
+  system_entry_t entry;
+  const char *text[9];
+  const uint64_t zero = 0;
+
+  universe = data;
+  text[0] = universe->meta_model_name;
+  text[1] = universe->meta_model_author;
+  text[2] = universe->meta_model_comment;
+  text[3] = universe->meta_substrate_name;
+  text[4] = universe->meta_substrate_author;
+  text[5] = universe->meta_substrate_comment;
+  text[6] = universe->meta_solvent_name;
+  text[7] = universe->meta_solvent_author;
+  text[8] = universe->meta_solvent_comment;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SYSTEM_MAGIC, sizeof(SYSTEM_MAGIC));
+  header.version = SYSTEM_VERSION;
+  header.byte_order = 0x0102030405060708;
+  header.key = universe->input_hash;
+  header.entry_nb = universe->model.entry_nb;
+  header.substrate_atom_nb = universe->substrate_atom_nb;
+  header.substrate_bond_nb = universe->substrate_bond_nb;
+  header.solvent_atom_nb = universe->solvent_atom_nb;
+  header.solvent_bond_nb = universe->solvent_bond_nb;
+
+  /* The strings, each with its terminator, are padded to a multiple of 8 bytes */
+  len = 0;
+  for (i=0; i<9; ++i)
+  {
+    len += strlen(text[i]) + 1;
+  }
+  for (i=0; i<(universe->model.entry_nb); ++i)
+  {
+    len += strlen(universe->model.entry[i].name) + 1;
+    len += strlen(universe->model.entry[i].symbol) + 1;
+  }
+  header.text_len = (len + 7)/8*8;
+
+  if (fwrite(&header, sizeof(header), 1, file) != 1)
+  {
+    return (-1);
+  }
+
+  for (i=0; i<(universe->model.entry_nb); ++i)
+  {
+    memset(&entry, 0, sizeof(entry));
+    entry.id = universe->model.entry[i].id;
+    entry.mass = universe->model.entry[i].mass;
+    entry.radius_covalent = universe->model.entry[i].radius_covalent;
+    entry.radius_vdw = universe->model.entry[i].radius_vdw;
+    entry.bond_angle = universe->model.entry[i].bond_angle;
+    entry.lj_epsilon = universe->model.entry[i].lj_epsilon;
+    entry.lj_sigma = universe->model.entry[i].lj_sigma;
+
+    if (fwrite(&entry, sizeof(entry), 1, file) != 1)
+    {
+      return (-1);
+    }
+  }
+
+  for (i=0; i<9; ++i)
+  {
+    if (fwrite(text[i], strlen(text[i]) + 1, 1, file) != 1)
+    {
+      return (-1);
+    }
+  }
+  for (i=0; i<(universe->model.entry_nb); ++i)
+  {
+    if (fwrite(universe->model.entry[i].name, strlen(universe->model.entry[i].name) + 1, 1, file) != 1
+        || fwrite(universe->model.entry[i].symbol, strlen(universe->model.entry[i].symbol) + 1, 1, file) != 1)
+    {
+      return (-1);
+    }
+  }
+  if (fwrite(&zero, 1, header.text_len - len, file) != header.text_len - len)
+  {
+    return (-1);
+  }
+
+  if (system_atoms_store(file, universe->substrate_atom, universe->substrate_atom_nb)
+      || system_atoms_store(file, universe->solvent_atom, universe->solvent_atom_nb))
+  {
+    return (-1);
+  }
+
+  return (0);
+}
+
+/* Save the model, substrate and solvent as loaded */
+universe_t *universe_system_store(universe_t *universe, const args_t *args)
+{
+  char *path;
+
+  /* Nothing to do without a cache */
+  if (args->path_cache == ARGS_PATH_CACHE_DEFAULT)
+  {
+    return (universe);
+  }
+
+  if ((path = system_path(universe, args)) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_SYSTEM_STORE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Jobs started from the same inputs may compile them at the same time */
+  if (file_replace(path, system_write, universe))
+  {
+    free(path);
+    return (retstr(NULL, TEXT_UNIVERSE_SYSTEM_STORE_FAILURE, __FILE__, __LINE__));
+  }
+
+  printf(TEXT_UNIVERSE_SYSTEM_STORE_SUCCESS, path);
+  free(path);
+  return (universe);
+}
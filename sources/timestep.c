@@ -0,0 +1,81 @@
+/*
+ * timestep.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "config.h"
+#include "args.h"
+#include "universe.h"
+#include "vec3.h"
+
+/*
+ * The adaptive timestep keeps the fastest atom from moving further than
+ * args->adaptive in one step, with dt = min(d/v, sqrt(2d/a)). Each step is a
+ * whole Velocity-Verlet step with its own timestep, so the timestep is only
+ * changed between steps, from the velocities and accelerations the closing
+ * half kick left.
+ *
+ */
+
+/* Returns the timestep that keeps the displacements below args->adaptive */
+static double timestep_target(const args_t *args, const double vel_max, const double acc_max)
+{
+  double timestep;
+
+  timestep = args->timestep;
+
+  if (vel_max > DIV_THRESHOLD)
+  {
+    timestep = fmin(timestep, args->adaptive/vel_max);
+  }
+
+  if (acc_max > DIV_THRESHOLD)
+  {
+    timestep = fmin(timestep, sqrt(2*(args->adaptive)/acc_max));
+  }
+
+  return (fmax(timestep, ADAPTIVE_MIN_RATIO*(args->timestep)));
+}
+
+/* Pick the first timestep, from the starting velocities and forces */
+universe_t *universe_timestep_init(universe_t *universe, const args_t *args)
+{
+  size_t i;       /* Iterator */
+  double vel_max; /* (m2.s-2) Largest squared velocity */
+  double acc_max; /* (m2.s-4) Largest squared acceleration */
+
+  universe->timestep = args->timestep;
+  if (args->adaptive <= 0.0)
+  {
+    return (universe);
+  }
+
+  vel_max = 0.0;
+  acc_max = 0.0;
+#pragma omp parallel for reduction(max:vel_max,acc_max)
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    vel_max = fmax(vel_max, vec3_dot(&(universe->atom[i].vel), &(universe->atom[i].vel)));
+    acc_max = fmax(acc_max, vec3_dot(&(universe->atom[i].acc), &(universe->atom[i].acc)));
+  }
+
+  /* The forces are at their largest right after potential reduction, so there's nothing to smooth */
+  universe->timestep = timestep_target(args, sqrt(vel_max), sqrt(acc_max));
+
+  return (universe);
+}
+
+/* Pick the next timestep, given the largest velocity and acceleration */
+universe_t *universe_timestep_adapt(universe_t *universe, const args_t *args, const double vel_max, const double acc_max)
+{
+  /* The timestep shrinks at once, but only grows slowly */
+  universe->timestep = fmin(timestep_target(args, vel_max, acc_max), ADAPTIVE_MAX_GROWTH*(universe->timestep));
+
+  return (universe);
+}
@@ -0,0 +1,608 @@
+/*
+ * traj.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "args.h"
+#include "parse.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+
+/*
+ * A binary trajectory is a header, the element table, the element of each
+ * atom, then one record per frame holding the coordinates as raw floats (or
+ * doubles with --double), in the byte order of the machine that wrote it.
+ * Every part is a multiple of 8 bytes long, so that the file can be mapped in
+ * memory and read in place. The layout is described in
+ * Documentation/sxb-format.txt.
+ * The frames are converted in parallel into a buffer and written with a single
+ * call, through a large aligned stdio buffer.
+ *
+ * A compressed trajectory has the same layout, with a header of its own and
+ * frame records holding the coordinates as multiples of args->precision. Each
+ * of them is stored as the difference with the same coordinate in the previous
+ * frame, or in a keyframe with the same coordinate of the previous atom, as the
+ * atoms of a molecule follow each other. The differences are mapped to
+ * unsigned integers (zigzag), and written 7 bits per byte (LEB128). The layout
+ * is described in Documentation/sxc-format.txt.
+ *
+ * A restarted run finds the end of the frames saved before its checkpoint by
+ * counting them from the start of the file, whatever its format, and cuts the
+ * file there.
+ *
+ */
+typedef struct traj_header_s traj_header_t;
+struct traj_header_s
+{
+  char magic[8];         /* TRAJ_MAGIC */
+  uint64_t version;      /* TRAJ_VERSION */
+  uint64_t byte_order;   /* 0x0102030405060708, as written by the machine */
+  uint64_t atom_nb;      /* Number of atoms in each frame */
+  uint64_t entry_nb;     /* Number of symbols in the element table */
+  uint64_t coord_size;   /* Size of a coordinate, 4 (float) or 8 (double) */
+  double size;           /* (Å) Length of the universe's side in the first frame */
+  double timestep;       /* (fs) Largest timestep */
+  double frame_interval; /* (fs) Simulated time between two frames */
+};
+
+typedef struct trajc_header_s trajc_header_t;
+struct trajc_header_s
+{
+  char magic[8];               /* TRAJC_MAGIC */
+  uint64_t version;            /* TRAJC_VERSION */
+  uint64_t byte_order;         /* 0x0102030405060708, as written by the machine */
+  uint64_t atom_nb;            /* Number of atoms in each frame */
+  uint64_t entry_nb;           /* Number of symbols in the element table */
+  uint64_t keyframe_interval;  /* Frames between two keyframes, at most */
+  double precision;            /* (Å) The coordinates are multiples of this */
+  double size;                 /* (Å) Length of the universe's side in the first frame */
+  double timestep;             /* (fs) Largest timestep */
+  double frame_interval;       /* (fs) Simulated time between two frames */
+};
+
+typedef struct trajc_frame_s trajc_frame_t;
+struct trajc_frame_s
+{
+  uint64_t iterations;         /* Iterations rendered before the frame */
+  double time;                 /* (fs) Simulated time */
+  double size;                 /* (Å) Length of the universe's side */
+  uint64_t keyframe;           /* 1 if the frame can be decoded on its own, 0 otherwise */
+  uint64_t len;                /* Length of the coded coordinates, before padding (bytes) */
+};
+
+typedef struct traj_frame_s traj_frame_t;
+struct traj_frame_s
+{
+  uint64_t iterations;   /* Iterations rendered before the frame */
+  double time;           /* (fs) Simulated time */
+  double size;           /* (Å) Length of the universe's side */
+};
+
+/* Returns the number of bytes needed to pad len to a multiple of 8 */
+static size_t traj_padding(const size_t len)
+{
+  return ((8 - len%8) % 8);
+}
+
+/* Returns whether path ends with extension */
+static int traj_has_extension(const char *path, const char *extension)
+{
+  size_t len;
+
+  len = strlen(path);
+  return (len >= strlen(extension) && !strcmp(path + len - strlen(extension), extension));
+}
+
+/* Append value to the buffer as a zigzag LEB128 integer, and return the number of bytes it took */
+static size_t trajc_varint(uint8_t *buffer, const int64_t value)
+{
+  uint64_t zigzag;
+  size_t len;
+
+  zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+  len = 0;
+  while (zigzag >= 0x80)
+  {
+    buffer[len++] = (uint8_t)(zigzag | 0x80);
+    zigzag >>= 7;
+  }
+  buffer[len++] = (uint8_t)zigzag;
+
+  return (len);
+}
+
+/* Write the element table and the element of each atom, which both formats share, all atoms being written if atom is NULL */
+static universe_t *traj_write_elements(universe_t *universe, FILE *file, const uint64_t atom_nb, const uint64_t *atom)
+{
+  size_t i;
+  char symbol[TRAJ_SYMBOL_LEN];
+  uint32_t element;
+  const uint64_t zero = 0;
+
+  /* The symbols are cut to fit, and padded with zeroes */
+  for (i=0; i<(universe->model.entry_nb); ++i)
+  {
+    memset(symbol, 0, TRAJ_SYMBOL_LEN);
+    if (universe->model.entry[i].symbol != NULL)
+    {
+      memcpy(symbol, universe->model.entry[i].symbol, strlen(universe->model.entry[i].symbol) < TRAJ_SYMBOL_LEN
+                                                      ? strlen(universe->model.entry[i].symbol) : TRAJ_SYMBOL_LEN);
+    }
+
+    if (fwrite(symbol, TRAJ_SYMBOL_LEN, 1, file) != 1)
+    {
+      return (NULL);
+    }
+  }
+
+  if (fwrite(&zero, 1, traj_padding((universe->model.entry_nb)*TRAJ_SYMBOL_LEN), file)
+      != traj_padding((universe->model.entry_nb)*TRAJ_SYMBOL_LEN))
+  {
+    return (NULL);
+  }
+
+  for (i=0; i<atom_nb; ++i)
+  {
+    element = (uint32_t)(universe->atom[(atom == NULL) ? i : atom[i]].element);
+    if (fwrite(&element, sizeof(uint32_t), 1, file) != 1)
+    {
+      return (NULL);
+    }
+  }
+
+  if (fwrite(&zero, 1, traj_padding(atom_nb*sizeof(uint32_t)), file)
+      != traj_padding(atom_nb*sizeof(uint32_t)))
+  {
+    return (NULL);
+  }
+
+  return (universe);
+}
+
+/* Write the header of a compressed trajectory */
+static universe_t *trajc_header(universe_t *universe, const args_t *args)
+{
+  trajc_header_t header;
+
+  memset(&header, 0, sizeof(trajc_header_t));
+  memcpy(header.magic, TRAJC_MAGIC, sizeof(TRAJC_MAGIC));
+  header.version = TRAJC_VERSION;
+  header.byte_order = 0x0102030405060708;
+  header.atom_nb = universe->atom_nb;
+  header.entry_nb = universe->model.entry_nb;
+  header.keyframe_interval = TRAJC_KEYFRAME_INTERVAL;
+  header.precision = args->precision*1E10;
+  header.size = universe->size*1E10;
+  header.timestep = args->timestep*1E15;
+  header.frame_interval = (args->frameskip + 1)*(args->timestep)*1E15;
+
+  if (fwrite(&header, sizeof(trajc_header_t), 1, universe->file_output) != 1)
+  {
+    return (NULL);
+  }
+
+  return (traj_write_elements(universe, universe->file_output, universe->atom_nb, NULL));
+}
+
+/* Write a frame to a compressed trajectory */
+static universe_t *trajc_write(universe_t *universe, const args_t *args, const frame_t *state)
+{
+  size_t i;
+  trajc_frame_t frame;
+  uint8_t *buffer;
+  int64_t *swap;
+  const uint64_t zero = 0;
+  int err = 0;
+
+  frame.iterations = state->iterations;
+  frame.time = state->time*1E15;
+  frame.size = state->size*1E10;
+  frame.keyframe = (universe->output_frame_nb == 0);
+
+  /* Round the coordinates, which have to be finite for that */
+#pragma omp parallel for
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    if (!isfinite(state->pos[i].x) || !isfinite(state->pos[i].y) || !isfinite(state->pos[i].z))
+    {
+#pragma omp atomic write
+      err = 1;
+      continue;
+    }
+
+    universe->output_quant[3*i]   = llround(state->pos[i].x/(args->precision));
+    universe->output_quant[3*i+1] = llround(state->pos[i].y/(args->precision));
+    universe->output_quant[3*i+2] = llround(state->pos[i].z/(args->precision));
+  }
+  if (0 != err)
+  {
+    return (NULL);
+  }
+
+  /* Code each coordinate against the previous frame's, or the previous atom's in a keyframe */
+  buffer = universe->output_frame;
+  frame.len = 0;
+  for (i=0; i<3*(universe->atom_nb); ++i)
+  {
+    if (frame.keyframe)
+    {
+      frame.len += trajc_varint(buffer + frame.len, universe->output_quant[i] - ((i < 3) ? 0 : universe->output_quant[i-3]));
+    }
+    else
+    {
+      frame.len += trajc_varint(buffer + frame.len, universe->output_quant[i] - universe->output_ref[i]);
+    }
+  }
+
+  if (fwrite(&frame, sizeof(trajc_frame_t), 1, universe->file_output) != 1
+      || fwrite(buffer, 1, frame.len, universe->file_output) != frame.len
+      || fwrite(&zero, 1, traj_padding(frame.len), universe->file_output) != traj_padding(frame.len))
+  {
+    return (NULL);
+  }
+
+  /* This frame is the next one's reference */
+  swap = universe->output_ref;
+  universe->output_ref = universe->output_quant;
+  universe->output_quant = swap;
+  universe->output_frame_nb = (universe->output_frame_nb + 1) % TRAJC_KEYFRAME_INTERVAL;
+
+  return (universe);
+}
+
+/* Allocate the buffers the frames are converted in */
+static universe_t *traj_alloc(universe_t *universe, const args_t *args)
+{
+  /* The text of an .xyz frame is formatted in parallel */
+  if (universe->output_format == OUTPUT_FORMAT_XYZ)
+  {
+    return (universe_xyz_init(universe));
+  }
+
+  /* Every delta takes TRAJC_VARINT_MAX bytes at worst, and the first frame is a keyframe */
+  if (universe->output_format == OUTPUT_FORMAT_SXC)
+  {
+    if ((universe->output_frame = malloc(3*(universe->atom_nb)*TRAJC_VARINT_MAX)) == NULL
+        || (universe->output_ref = malloc(3*(universe->atom_nb)*sizeof(int64_t))) == NULL
+        || (universe->output_quant = malloc(3*(universe->atom_nb)*sizeof(int64_t))) == NULL)
+    {
+      return (NULL);
+    }
+    universe->output_frame_nb = 0;
+    return (universe);
+  }
+
+  if ((universe->output_frame = malloc(3*(universe->atom_nb)*(args->traj_double ? sizeof(double) : sizeof(float)))) == NULL)
+  {
+    return (NULL);
+  }
+
+  return (universe);
+}
+
+/* Returns the length of the first frame_nb frames of the mapped output file, with what precedes them, or -1 */
+static long traj_frames_end(const universe_t *universe, const args_t *args, const input_t *input, const uint64_t frame_nb)
+{
+  const char *str;
+  const char *end;
+  size_t pos;     /* Length of the header and of the frames found so far */
+  size_t len;     /* Length of a frame's coordinates */
+  uint64_t i;     /* Iterator */
+  traj_header_t header;
+  trajc_header_t headerc;
+  trajc_frame_t framec;
+
+  /* Each frame of an .xyz file is two lines, then one per atom */
+  if (universe->output_format == OUTPUT_FORMAT_XYZ)
+  {
+    str = input->data;
+    end = input->data + input->len;
+    for (i=0; i<frame_nb*(universe->atom_nb + 2); ++i)
+    {
+      if (str == NULL || str >= end || (str = memchr(str, '\n', end - str)) == NULL)
+      {
+        return (-1);
+      }
+      ++str;
+    }
+    return ((frame_nb == 0) ? 0 : (long)(str - input->data));
+  }
+
+  /* The element table and the element of each atom follow both headers */
+  pos = traj_padding((universe->model.entry_nb)*TRAJ_SYMBOL_LEN) + (universe->model.entry_nb)*TRAJ_SYMBOL_LEN
+        + traj_padding((universe->atom_nb)*sizeof(uint32_t)) + (universe->atom_nb)*sizeof(uint32_t);
+
+  if (universe->output_format == OUTPUT_FORMAT_SXC)
+  {
+    if (input->len < sizeof(trajc_header_t))
+    {
+      return (-1);
+    }
+    memcpy(&headerc, input->data, sizeof(trajc_header_t));
+    if (memcmp(headerc.magic, TRAJC_MAGIC, sizeof(TRAJC_MAGIC)) || headerc.atom_nb != universe->atom_nb)
+    {
+      return (-1);
+    }
+
+    /* The compressed frames are as long as their coordinates took to code */
+    pos += sizeof(trajc_header_t);
+    for (i=0; i<frame_nb; ++i)
+    {
+      if (input->len < pos + sizeof(trajc_frame_t))
+      {
+        return (-1);
+      }
+      memcpy(&framec, input->data + pos, sizeof(trajc_frame_t));
+      pos += sizeof(trajc_frame_t) + framec.len + traj_padding(framec.len);
+    }
+  }
+  else
+  {
+    if (input->len < sizeof(traj_header_t))
+    {
+      return (-1);
+    }
+    memcpy(&header, input->data, sizeof(traj_header_t));
+    if (memcmp(header.magic, TRAJ_MAGIC, sizeof(TRAJ_MAGIC)) || header.atom_nb != universe->atom_nb
+        || header.coord_size != (args->traj_double ? sizeof(double) : sizeof(float)))
+    {
+      return (-1);
+    }
+
+    len = 3*(universe->atom_nb)*(header.coord_size);
+    pos += sizeof(traj_header_t) + frame_nb*(sizeof(traj_frame_t) + len + traj_padding(len));
+  }
+
+  if (input->len < pos)
+  {
+    return (-1);
+  }
+
+  return ((long)pos);
+}
+
+/* Pick the output format from the output file's extension, and buffer the file */
+universe_t *universe_traj_init(universe_t *universe, const args_t *args)
+{
+  if (traj_has_extension(args->path_out, TRAJ_EXTENSION))
+  {
+    universe->output_format = OUTPUT_FORMAT_SXB;
+  }
+  else if (traj_has_extension(args->path_out, TRAJC_EXTENSION))
+  {
+    universe->output_format = OUTPUT_FORMAT_SXC;
+  }
+  else
+  {
+    universe->output_format = OUTPUT_FORMAT_XYZ;
+  }
+
+  /* The stream has to be buffered before anything is written to it */
+  if (posix_memalign((void**)&(universe->output_buffer), TRAJ_BUFFER_ALIGNMENT, TRAJ_BUFFER_SIZE)
+      || setvbuf(universe->file_output, universe->output_buffer, _IOFBF, TRAJ_BUFFER_SIZE))
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_TRAJ_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
+
+/* Write the header, the element table and the element of each atom */
+universe_t *universe_traj_header(universe_t *universe, const args_t *args)
+{
+  traj_header_t header;
+
+  if (traj_alloc(universe, args) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_TRAJ_HEADER_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* An .xyz file has no header */
+  if (universe->output_format == OUTPUT_FORMAT_XYZ)
+  {
+    return (universe);
+  }
+
+  if (universe->output_format == OUTPUT_FORMAT_SXC)
+  {
+    if (trajc_header(universe, args) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_TRAJ_HEADER_FAILURE, __FILE__, __LINE__));
+    }
+    return (universe);
+  }
+
+  memset(&header, 0, sizeof(traj_header_t));
+  memcpy(header.magic, TRAJ_MAGIC, sizeof(TRAJ_MAGIC));
+  header.version = TRAJ_VERSION;
+  header.byte_order = 0x0102030405060708;
+  header.atom_nb = universe->atom_nb;
+  header.entry_nb = universe->model.entry_nb;
+  header.coord_size = args->traj_double ? sizeof(double) : sizeof(float);
+  header.size = universe->size*1E10;
+  header.timestep = args->timestep*1E15;
+  header.frame_interval = (args->frameskip + 1)*(args->timestep)*1E15;
+
+  if (fwrite(&header, sizeof(traj_header_t), 1, universe->file_output) != 1)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_TRAJ_HEADER_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (traj_write_elements(universe, universe->file_output, universe->atom_nb, NULL) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_TRAJ_HEADER_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
+
+/* Cut the output file after the frames saved before the checkpoint, and carry on from there */
+universe_t *universe_traj_resume(universe_t *universe, const args_t *args)
+{
+  input_t input;
+  long end; /* Length of the file, once cut */
+
+  if (traj_alloc(universe, args) == NULL || input_map(&input, universe->file_output) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_TRAJ_RESUME_FAILURE, __FILE__, __LINE__));
+  }
+  end = traj_frames_end(universe, args, &input, universe->output_count);
+  input_unmap(&input);
+
+  /* The next compressed frame has nothing to be coded against, so it is a keyframe */
+  universe->output_frame_nb = 0;
+
+  if (end < 0
+      || ftruncate(fileno(universe->file_output), end)
+      || fseek(universe->file_output, end, SEEK_SET))
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_TRAJ_RESUME_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
+
+/* Write a frame */
+universe_t *universe_traj_write(universe_t *universe, const args_t *args, const frame_t *state)
+{
+  size_t i;
+  size_t len;
+  traj_frame_t frame;
+  float *frame_float;
+  double *frame_double;
+  const uint64_t zero = 0;
+
+  if (universe->output_format == OUTPUT_FORMAT_SXC)
+  {
+    if (trajc_write(universe, args, state) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_TRAJ_WRITE_FAILURE, __FILE__, __LINE__));
+    }
+    return (universe);
+  }
+
+  frame.iterations = state->iterations;
+  frame.time = state->time*1E15;
+  frame.size = state->size*1E10;
+
+  /* Convert the positions to Å, in the precision of the file */
+  if (args->traj_double)
+  {
+    frame_double = universe->output_frame;
+#pragma omp parallel for
+    for (i=0; i<(universe->atom_nb); ++i)
+    {
+      frame_double[3*i]   = state->pos[i].x*1E10;
+      frame_double[3*i+1] = state->pos[i].y*1E10;
+      frame_double[3*i+2] = state->pos[i].z*1E10;
+    }
+    len = 3*(universe->atom_nb)*sizeof(double);
+  }
+  else
+  {
+    frame_float = universe->output_frame;
+#pragma omp parallel for
+    for (i=0; i<(universe->atom_nb); ++i)
+    {
+      frame_float[3*i]   = (float)(state->pos[i].x*1E10);
+      frame_float[3*i+1] = (float)(state->pos[i].y*1E10);
+      frame_float[3*i+2] = (float)(state->pos[i].z*1E10);
+    }
+    len = 3*(universe->atom_nb)*sizeof(float);
+  }
+
+  /* Single precision leaves 4 bytes to pad with an odd number of atoms */
+  if (fwrite(&frame, sizeof(traj_frame_t), 1, universe->file_output) != 1
+      || fwrite(universe->output_frame, 1, len, universe->file_output) != len
+      || fwrite(&zero, 1, traj_padding(len), universe->file_output) != traj_padding(len))
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_TRAJ_WRITE_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
+
+/* Write the header of an output stream's binary trajectory, which only holds the atoms it selected */
+universe_t *universe_traj_stream_header(universe_t *universe, const args_t *args, const stream_t *stream)
+{
+  traj_header_t header;
+
+  memset(&header, 0, sizeof(traj_header_t));
+  memcpy(header.magic, TRAJ_MAGIC, sizeof(TRAJ_MAGIC));
+  header.version = TRAJ_VERSION;
+  header.byte_order = 0x0102030405060708;
+  header.atom_nb = stream->atom_nb;
+  header.entry_nb = universe->model.entry_nb;
+  header.coord_size = args->traj_double ? sizeof(double) : sizeof(float);
+  header.size = universe->size*1E10;
+  header.timestep = args->timestep*1E15;
+  header.frame_interval = ((stream->every > 0) ? (stream->every)*(args->timestep) : stream->interval)*1E15;
+
+  if (fwrite(&header, sizeof(traj_header_t), 1, stream->file) != 1
+      || traj_write_elements(universe, stream->file, stream->atom_nb, stream->atom) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_TRAJ_STREAM_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
+
+/* Write the current positions of the atoms an output stream selected as a binary frame */
+universe_t *universe_traj_stream_write(universe_t *universe, const args_t *args, const stream_t *stream)
+{
+  size_t i;
+  size_t len;
+  traj_frame_t frame;
+  float *frame_float;
+  double *frame_double;
+  const uint64_t zero = 0;
+
+  frame.iterations = universe->iterations;
+  frame.time = universe->time*1E15;
+  frame.size = universe->size*1E10;
+
+  if (args->traj_double)
+  {
+    frame_double = stream->frame;
+#pragma omp parallel for
+    for (i=0; i<(stream->atom_nb); ++i)
+    {
+      frame_double[3*i]   = universe->atom[stream->atom[i]].pos.x*1E10;
+      frame_double[3*i+1] = universe->atom[stream->atom[i]].pos.y*1E10;
+      frame_double[3*i+2] = universe->atom[stream->atom[i]].pos.z*1E10;
+    }
+    len = 3*(stream->atom_nb)*sizeof(double);
+  }
+  else
+  {
+    frame_float = stream->frame;
+#pragma omp parallel for
+    for (i=0; i<(stream->atom_nb); ++i)
+    {
+      frame_float[3*i]   = (float)(universe->atom[stream->atom[i]].pos.x*1E10);
+      frame_float[3*i+1] = (float)(universe->atom[stream->atom[i]].pos.y*1E10);
+      frame_float[3*i+2] = (float)(universe->atom[stream->atom[i]].pos.z*1E10);
+    }
+    len = 3*(stream->atom_nb)*sizeof(float);
+  }
+
+  if (fwrite(&frame, sizeof(traj_frame_t), 1, stream->file) != 1
+      || fwrite(stream->frame, 1, len, stream->file) != len
+      || fwrite(&zero, 1, traj_padding(len), stream->file) != traj_padding(len))
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_TRAJ_STREAM_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
@@ -10,33 +10,44 @@
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
+#include <omp.h>
 
 #include "config.h"
 #include "args.h"
 #include "model.h"
+#include "parse.h"
 #include "text.h"
 #include "vec3.h"
 #include "util.h"
 #include "universe.h"
 #include "potential.h"
+#include "rng.h"
+#include "stop.h"
 
 universe_t *universe_init(universe_t *universe, const args_t *args)
 {
   size_t i;                    /* Iterator */
-  size_t file_len_model;       /* Size of the model file (bytes) */
-  size_t file_len_substrate;   /* Size of the substrate file (bytes) */
-  size_t file_len_solvent;     /* Size of the solvent file (bytes) */
-  char *file_buffer_model;     /* A memory copy of the model */
-  char *file_buffer_substrate; /* A memory copy of the substrate file */
-  char *file_buffer_solvent;   /* A memory copy of the solvent file */
+  input_t input_model;         /* The model file, mapped in memory */
+  input_t input_substrate;     /* The substrate file, mapped in memory */
+  input_t input_solvent;       /* The solvent file, mapped in memory */
+  int system_hit;              /* Whether the input files were found compiled */
   double universe_mass;        /* Total mass of the universe */
 
   /* Initialize the structure variables */
   universe->file_model = UNIVERSE_FILE_MODEL_DEFAULT;
   universe->file_output = UNIVERSE_FILE_OUTPUT_DEFAULT;
+  universe->output_format = UNIVERSE_OUTPUT_FORMAT_DEFAULT;
+  universe->output_buffer = UNIVERSE_OUTPUT_BUFFER_DEFAULT;
+  universe->output_frame = UNIVERSE_OUTPUT_FRAME_DEFAULT;
+  universe->output_ref = UNIVERSE_OUTPUT_REF_DEFAULT;
+  universe->output_quant = UNIVERSE_OUTPUT_QUANT_DEFAULT;
+  universe->output_frame_nb = UNIVERSE_OUTPUT_FRAME_NB_DEFAULT;
+  universe->output_count = UNIVERSE_OUTPUT_COUNT_DEFAULT;
+  universe->output_chunk_len = UNIVERSE_OUTPUT_CHUNK_LEN_DEFAULT;
   universe->file_substrate = UNIVERSE_FILE_SUBSTRATE_DEFAULT;
   universe->file_solvent = UNIVERSE_FILE_SOLVENT_DEFAULT;
   universe->meta_model_name = UNIVERSE_META_MODEL_NAME_DEFAULT;
+  universe->input_hash = UNIVERSE_INPUT_HASH_DEFAULT;
   universe->meta_model_author = UNIVERSE_META_MODEL_AUTHOR_DEFAULT;
   universe->meta_model_comment = UNIVERSE_META_MODEL_COMMENT_DEFAULT;
   universe->meta_substrate_name = UNIVERSE_META_SUBSTRATE_NAME_DEFAULT;
@@ -52,124 +63,146 @@ universe_t *universe_init(universe_t *universe, const args_t *args)
   universe->solvent_atom_nb = UNIVERSE_SOLVENT_ATOM_NB_DEFAULT;
   universe->solvent_bond_nb = UNIVERSE_SOLVENT_BOND_NB_DEFAULT;
   universe->solvent_atom = UNIVERSE_SOLVENT_ATOM_DEFAULT;
+  universe->solvent_copy_nb = UNIVERSE_SOLVENT_COPY_NB_DEFAULT;
   universe->atom = UNIVERSE_ATOM_DEFAULT;
   universe->copy_nb = UNIVERSE_COPY_NB_DEFAULT;
   universe->atom_nb = UNIVERSE_ATOM_NB_DEFAULT;
   universe->iterations = UNIVERSE_ITERATIONS_DEFAULT;
   universe->size = UNIVERSE_SIZE_DEFAULT;
   universe->time = UNIVERSE_TIME_DEFAULT;
+  universe->timestep = UNIVERSE_TIMESTEP_DEFAULT;
+  universe->frame_time = UNIVERSE_FRAME_TIME_DEFAULT;
   universe->temperature = UNIVERSE_TEMPERATURE_DEFAULT;
   universe->pressure = UNIVERSE_PRESSURE_DEFAULT;
+  universe->lambda = UNIVERSE_LAMBDA_DEFAULT;
+  universe->potential = UNIVERSE_POTENTIAL_DEFAULT;
+  universe->potential_fresh = UNIVERSE_POTENTIAL_FRESH_DEFAULT;
+  universe->stream_nb = UNIVERSE_STREAM_NB_DEFAULT;
+  universe->stream = UNIVERSE_STREAM_DEFAULT;
+  mat3_zero(&(universe->virial));
+  universe->rng = UNIVERSE_RNG_DEFAULT;
+  for (i=0; i<NHC_CHAIN_LENGTH; ++i)
+  {
+    universe->nhc.pos[i] = NHC_POS_DEFAULT;
+    universe->nhc.vel[i] = NHC_VEL_DEFAULT;
+    universe->nhc.mass[i] = NHC_MASS_DEFAULT;
+  }
+  universe->nhc.dof = NHC_DOF_DEFAULT;
+  universe->nhc.scale = NHC_SCALE_DEFAULT;
+  universe->watchdog.sampled = WATCHDOG_SAMPLED_DEFAULT;
+  universe->watchdog.frc_max = WATCHDOG_FRC_MAX_DEFAULT;
+  universe->watchdog.nonfinite_nb = WATCHDOG_NONFINITE_NB_DEFAULT;
+  universe->watchdog.energy = WATCHDOG_ENERGY_DEFAULT;
+  universe->watchdog.ek = WATCHDOG_EK_DEFAULT;
+  universe->watchdog.atom = WATCHDOG_ATOM_DEFAULT;
+  universe->watchdog.rng = WATCHDOG_RNG_DEFAULT;
+  universe->watchdog.output_pos = WATCHDOG_OUTPUT_POS_DEFAULT;
+  universe->watchdog.output_count = WATCHDOG_OUTPUT_COUNT_DEFAULT;
+  universe->watchdog.stream = WATCHDOG_STREAM_DEFAULT;
+  universe->checkpoint.path = CHECKPOINT_PATH_DEFAULT;
+  universe->checkpoint.running = CHECKPOINT_RUNNING_DEFAULT;
+  universe->checkpoint.done = CHECKPOINT_DONE_DEFAULT;
+  universe->checkpoint.err = CHECKPOINT_ERR_DEFAULT;
+  universe->checkpoint.writer_head = CHECKPOINT_WRITER_HEAD_DEFAULT;
+  universe->checkpoint.atom = CHECKPOINT_ATOM_DEFAULT;
+  universe->checkpoint.rng_nb = CHECKPOINT_RNG_NB_DEFAULT;
+  universe->checkpoint.rng = CHECKPOINT_RNG_DEFAULT;
+  universe->checkpoint.stream_nb = CHECKPOINT_STREAM_NB_DEFAULT;
+  universe->checkpoint.stream = CHECKPOINT_STREAM_DEFAULT;
+  universe->writer.slot_nb = WRITER_SLOT_NB_DEFAULT;
+  universe->writer.slot = WRITER_SLOT_DEFAULT;
+  universe->writer.head = WRITER_HEAD_DEFAULT;
+  universe->writer.tail = WRITER_TAIL_DEFAULT;
+  universe->writer.running = WRITER_RUNNING_DEFAULT;
+  universe->writer.stop = WRITER_STOP_DEFAULT;
+  universe->writer.err = WRITER_ERR_DEFAULT;
+  universe->live.name = LIVE_NAME_DEFAULT;
+  universe->live.header = LIVE_HEADER_DEFAULT;
+  universe->live.len = LIVE_LEN_DEFAULT;
+  universe->constraint_nb = UNIVERSE_CONSTRAINT_NB_DEFAULT;
+  universe->constraint = UNIVERSE_CONSTRAINT_DEFAULT;
+  universe->cluster_nb = UNIVERSE_CLUSTER_NB_DEFAULT;
+  universe->cluster = UNIVERSE_CLUSTER_DEFAULT;
+  universe->settle_nb = UNIVERSE_SETTLE_NB_DEFAULT;
+  universe->settle = UNIVERSE_SETTLE_DEFAULT;
+  universe->constraint_ref = UNIVERSE_CONSTRAINT_REF_DEFAULT;
+  mat3_zero(&(universe->constraint_virial));
 
   universe->copy_nb = args->copies;
+  universe->timestep = args->timestep;
   universe->temperature = args->temperature;
   universe->pressure = args->pressure;
 
-  /* Open the output file */
-  if ((universe->file_output = fopen(args->path_out, "w")) == NULL)
+  /* Open the output file, in the format its name asks for. A restarted run carries on with its frames */
+  if ((universe->file_output = fopen(args->path_out, (args->path_restart == ARGS_PATH_RESTART_DEFAULT) ? "w" : "r+")) == NULL
+      || universe_traj_init(universe, args) == NULL)
   {
     return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
   }
 
-  /* Open the model file */
-  if ((universe->file_model = fopen(args->path_model, "r")) == NULL)
+  /* Open the input files */
+  if ((universe->file_model = fopen(args->path_model, "r")) == NULL
+      || (universe->file_substrate = fopen(args->path_substrate, "r")) == NULL
+      || (universe->file_solvent = fopen(args->path_solvent, "r")) == NULL)
   {
     return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
   }
 
-  /* Get the model file's size */
-  fseek(universe->file_model, 0, SEEK_END);
-  file_len_model = ftell(universe->file_model);
-  rewind(universe->file_model);
-
-  /* Initialize the memory buffer for the model file */
-  if ((file_buffer_model = (char*)malloc(file_len_model+1)) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
-  }
-
-  /* Load it in the model buffer, terminate the string */
-  if (fread(file_buffer_model, sizeof(char), file_len_model, universe->file_model) != file_len_model)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
-  }
-  file_buffer_model[file_len_model] = '\0';
-
-  /* Load the model from the file */
-  if (universe_load_model(universe, file_buffer_model) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
-  }
-
-  /* Free the model file buffer, we're done */
-  free(file_buffer_model);
-
-  /* Open the substrate file */
-  if ((universe->file_substrate = fopen(args->path_substrate, "r")) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
-  }
-
-  /* Get the substrate file's size */
-  fseek(universe->file_substrate, 0, SEEK_END);
-  file_len_substrate = ftell(universe->file_substrate);
-  rewind(universe->file_substrate);
-
-  /* Initialize the memory buffer for the substrate file */
-  if ((file_buffer_substrate = (char*)malloc(file_len_substrate+1)) == NULL)
+  /* Map them in memory, and hash their contents */
+  if (input_map(&input_model, universe->file_model) == NULL
+      || input_map(&input_substrate, universe->file_substrate) == NULL
+      || input_map(&input_solvent, universe->file_solvent) == NULL)
   {
     return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
   }
+  universe->input_hash = fnv1a(universe->input_hash, input_model.data, input_model.len);
+  universe->input_hash = fnv1a(universe->input_hash, input_substrate.data, input_substrate.len);
+  universe->input_hash = fnv1a(universe->input_hash, input_solvent.data, input_solvent.len);
 
-  /* Load it in the substrate buffer, terminate the string */
-  if (fread(file_buffer_substrate, sizeof(char), file_len_substrate, universe->file_substrate) != file_len_substrate)
+  /* Skip the parsing if the same files were already compiled */
+  if (universe_system_load(universe, args, &system_hit) == NULL)
   {
     return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
   }
-  file_buffer_substrate[file_len_substrate] = '\0';
 
-  /* Load the initial state from the substrate file */
-  if (universe_load_substrate(universe, file_buffer_substrate) == NULL)
+  if (!system_hit)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
-  }
+    /* Load the model, then the initial state from the substrate and solvent files */
+    if (input_index(&input_model) == NULL
+        || input_index(&input_substrate) == NULL
+        || input_index(&input_solvent) == NULL
+        || universe_load_model(universe, &input_model) == NULL
+        || universe_load_substrate(universe, &input_substrate) == NULL
+        || universe_load_solvent(universe, &input_solvent) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
+    }
 
-  /* Free the substrate file buffer, we're done */
-  free(file_buffer_substrate);
-  
-  /* Open the solvent file */
-  if ((universe->file_solvent  = fopen(args->path_solvent, "r")) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
+    /* Failing to compile the system doesn't prevent the simulation from running */
+    universe_system_store(universe, args);
   }
 
-  /* Get the solvent file's size */
-  fseek(universe->file_solvent, 0, SEEK_END);
-  file_len_solvent = ftell(universe->file_solvent);
-  rewind(universe->file_solvent);
-
-  /* Initialize the memory buffer for the solvent file */
-  if ((file_buffer_solvent = (char*)malloc(file_len_substrate+1)) == NULL)
-  {
-    return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
-  }
+  /* Unmap the input files, we're done */
+  input_unmap(&input_model);
+  input_unmap(&input_substrate);
+  input_unmap(&input_solvent);
 
-  /* Load it in the solvent buffer, terminate the string */
-  if (fread(file_buffer_solvent, sizeof(char), file_len_solvent, universe->file_solvent) != file_len_solvent)
+  /* Move some of the heavy atoms' mass onto their hydrogens */
+  if (args->hmr > 0.0 && universe_hmr(universe, args) == NULL)
   {
     return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
   }
-  file_buffer_solvent[file_len_solvent] = '\0';
 
-  /* Load the initial state from the solvent file */
-  if (universe_load_solvent(universe, file_buffer_solvent) == NULL)
+  /* A restarted run takes the universe as it was when the checkpoint was taken */
+  if (args->path_restart != ARGS_PATH_RESTART_DEFAULT)
   {
-    return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
+    if (universe_checkpoint_load(universe, args) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
+    }
+    return (universe);
   }
 
-  /* Free the solvent file buffer, we're done */
-  free(file_buffer_solvent);
-
   /* Initialize the atom number */
   universe->atom_nb = (universe->substrate_atom_nb) * (universe->copy_nb);
 
@@ -209,6 +242,12 @@ universe_t *universe_init(universe_t *universe, const args_t *args)
     }
   }
 
+  /* Fill the rest of the universe with the solvent */
+  if (universe_solvate(universe, args) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
   /* Apply initial velocities */
   if (universe_setvelocity(universe) == NULL)
   {
@@ -222,7 +261,6 @@ universe_t *universe_populate(universe_t *universe)
 {
   size_t i;
   size_t ii;
-  size_t iii;
   vec3_t pos_offset;
   atom_t *reference;
   atom_t *duplicate;
@@ -240,44 +278,14 @@ universe_t *universe_populate(universe_t *universe)
       reference = &(universe->substrate_atom[ii]);
       duplicate = &(universe->atom[(i*(universe->substrate_atom_nb)) + ii]);
 
-      duplicate->element = reference->element;
-      duplicate->charge = reference->charge;
-      duplicate->epsilon = reference->epsilon;
-      duplicate->sigma = reference->sigma;
-
-      duplicate->bond_nb = reference->bond_nb;
-
-      duplicate->vel.x = reference->vel.x;
-      duplicate->vel.y = reference->vel.y;
-      duplicate->vel.z = reference->vel.z;
-
-      duplicate->acc.x = reference->acc.x;
-      duplicate->acc.y = reference->acc.y;
-      duplicate->acc.z = reference->acc.z;
-
-      duplicate->frc.x = reference->frc.x;
-      duplicate->frc.y = reference->frc.y;
-      duplicate->frc.z = reference->frc.z;
-
-      /* Load the atom's location */
-      vec3_add(&(duplicate->pos), &(reference->pos), &pos_offset);
-
-      /* Allocate memory for the bond information */
-      if ((duplicate->bond = malloc(sizeof(uint64_t)*(reference->bond_nb))) == NULL)
-      {
-        return (retstr(NULL, TEXT_UNIVERSE_POPULATE_FAILURE, __FILE__, __LINE__));
-      }
-      if ((duplicate->bond_strength = malloc(sizeof(double)*(reference->bond_nb))) == NULL)
+      /* Copy the atom and its bonds */
+      if (atom_duplicate(duplicate, reference, i*(universe->substrate_atom_nb)) == NULL)
       {
         return (retstr(NULL, TEXT_UNIVERSE_POPULATE_FAILURE, __FILE__, __LINE__));
       }
 
-      /* Load the bond information */
-      for (iii=0; iii<(duplicate->bond_nb); ++iii)
-      {
-        duplicate->bond[iii] = reference->bond[iii] + (i*(universe->substrate_atom_nb));
-        duplicate->bond_strength[iii] = reference->bond_strength[iii];
-      }
+      /* Load the atom's location */
+      vec3_add(&(duplicate->pos), &(reference->pos), &pos_offset);
     }
   }
 
@@ -317,12 +325,24 @@ void universe_clean(universe_t *universe)
 {
   size_t i;
 
+  /* The last checkpoint is saved, then the frames still in the ring, before the atoms, the model and the output file they read are gone */
+  universe_checkpoint_clean(universe);
+  universe_writer_clean(universe);
+  universe_live_clean(universe);
+  universe_streams_clean(universe);
+
   /* Clean each atom in the reference system */
   for (i=0; i<(universe->substrate_atom_nb); ++i)
   {
     atom_clean(&(universe->substrate_atom[i]));
   }
 
+  /* Clean each atom in the solvent */
+  for (i=0; i<(universe->solvent_atom_nb); ++i)
+  {
+    atom_clean(&(universe->solvent_atom[i]));
+  }
+
   /* Clean each atom in the universe */
   for (i=0; i<(universe->atom_nb); ++i)
   {
@@ -350,49 +370,205 @@ void universe_clean(universe_t *universe)
   free(universe->meta_solvent_comment);
   free(universe->solvent_atom);
   free(universe->atom);
+  free(universe->rng);
+  free(universe->constraint);
+  free(universe->cluster);
+  free(universe->settle);
+  free(universe->constraint_ref);
+  free(universe->watchdog.atom);
+  free(universe->watchdog.rng);
+  free(universe->watchdog.stream);
+  free(universe->output_buffer);
+  free(universe->output_frame);
+  free(universe->output_ref);
+  free(universe->output_quant);
+  free(universe->output_chunk_len);
 }
 
 /* Main loop of the simulator. Iterates until the target time is reached */
 int universe_simulate(universe_t *universe, const args_t *args)
 {
-  uint64_t frame_nb; /* Used for frameskipping */
-  uint64_t frame_max;
+  double frame_interval; /* (s) Time between two saved frames */
+  double timestep;       /* (s) Timestep of the current iteration */
+  uint64_t seed;         /* Seed of the first Langevin random stream */
+  size_t i;              /* Iterator */
+
+  /* The frames are saved every frameskip+1 steps of --dt, whatever the timestep actually is */
+  frame_interval = (args->frameskip + 1)*(args->timestep);
+
+  /*
+   * The Langevin thermostat draws its noise from one random stream per thread.
+   * They are seeded from --srand rather than rand(), whose state depends on
+   * whether the potential reduction ran or was read from the cache
+   */
+  if (args->langevin > 0.0)
+  {
+    if ((universe->rng = malloc(sizeof(rng_t)*omp_get_max_threads())) == NULL)
+    {
+      return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+    }
+
+    seed = args->srand_seed;
+    for (i=0; i<(size_t)omp_get_max_threads(); ++i)
+    {
+      rng_seed(&(universe->rng[i]), seed + i);
+    }
+  }
+
+  /* The starting positions and velocities must follow the constraints */
+  if (args->shake || args->settle)
+  {
+    if (universe_constraint_init(universe, args) == NULL || universe_constrain_vel(universe) == NULL)
+    {
+      return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+    }
+  }
+
+  /* The first half kick needs the forces at the starting positions, and the watchdog their energy */
+  if (universe_update_frc(universe, args, ((args->berendsen > 0.0) ? UPDATE_FRC_VIRIAL : 0) | ((args->respa > 1) ? UPDATE_FRC_SLOW : 0)
+                                          | ((args->watchdog > 0) ? UPDATE_FRC_POTENTIAL | UPDATE_FRC_WATCHDOG : 0)) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The adaptive timestep starts from the forces at the starting positions */
+  if (universe_timestep_init(universe, args) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The Nose-Hoover chain acts before the first half kick */
+  if (args->nose_hoover > 0.0 && universe_nhc_init(universe, args) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* A restarted run goes on from the checkpoint, its forces and thermostat included */
+  if (args->path_restart != ARGS_PATH_RESTART_DEFAULT && universe_checkpoint_resume(universe, args) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* A binary trajectory starts with what its frames need to be read, a restarted one already has it */
+  if (args->path_restart == ARGS_PATH_RESTART_DEFAULT && universe_traj_header(universe, args) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+  if (args->path_restart != ARGS_PATH_RESTART_DEFAULT && universe_traj_resume(universe, args) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* With --async, the frames are saved while the simulation goes on */
+  if (universe_writer_init(universe, args) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* With --live, the frames are also published to other processes */
+  if (args->path_live != ARGS_PATH_LIVE_DEFAULT && universe_live_init(universe, args) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The output streams start where the run does, a restarted one included */
+  if (args->stream_nb > 0 && universe_streams_init(universe, args) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The watchdog compares its samples with the starting state */
+  if (args->watchdog > 0 && universe_watchdog_init(universe, args) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Checkpoints are copied between two steps, and saved while the simulation goes on */
+  if (args->path_checkpoint != ARGS_PATH_CHECKPOINT_DEFAULT && universe_checkpoint_init(universe, args) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* The job can be asked to stop from now on */
+  stop_catch();
 
-  frame_max = (args->max_time / args->timestep);
   /* Tell the user the simulation is starting */
   puts(TEXT_SIMSTART);
 
   /* While we haven't reached the target time, we iterate the universe */
-  frame_nb = 0;
   while (universe->time < args->max_time)
   {
-    /* Print the state to the .xyz file, if required */
-    if (!frame_nb)
+    /* Print the state to the .xyz file, if this step is the closest one to the next frame */
+    if (universe->time >= universe->frame_time - 0.5*(universe->timestep))
     {
-      if (universe_printstate(universe) == NULL)
+      if (universe_printstate(universe, args) == NULL)
       {
         return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
       }
-      frame_nb = (args->frameskip);
+
+      while (universe->frame_time <= universe->time + 0.5*(universe->timestep))
+      {
+        universe->frame_time += frame_interval;
+      }
     }
-    else
-      --frame_nb;
 
-    /* Iterate */
-    if (universe_iterate(universe, args) == NULL)
+    /* Save to the output streams whose turn it is */
+    if (universe->stream_nb > 0 && universe_streams_write(universe, args) == NULL)
     {
       return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
     }
 
-    printf(TEXT_UNIVERSE_SIMULATE_SUCCESS, universe->iterations + 1, frame_max, (double) 100 * (universe->iterations + 1) / frame_max);
-    fflush(stdout);
+    /* Iterate, the timestep being picked for the next step */
+    timestep = universe->timestep;
+    if (universe_iterate(universe, args) == NULL)
+    {
+      return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+    }
 
-    universe->time += args->timestep;
+    universe->time += timestep;
     ++(universe->iterations);
+
+    /* Stop, or go back a few steps, if the universe blew up */
+    if (universe->watchdog.sampled && universe_watchdog_check(universe, args) == NULL)
+    {
+      return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+    }
+
+    /* Take a checkpoint every args->checkpoint_interval steps */
+    if (args->path_checkpoint != ARGS_PATH_CHECKPOINT_DEFAULT && universe->iterations % args->checkpoint_interval == 0
+        && universe_checkpoint_save(universe, args) == NULL)
+    {
+      return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+    }
+
+    /* Stop between two r-RESPA steps if the job is about to be killed, leaving a checkpoint to resume from */
+    if (universe->iterations % args->respa == 0 && stop_requested(args))
+    {
+      printf("\n");
+      printf(TEXT_UNIVERSE_SIMULATE_STOP, universe->iterations, universe->time);
+      if (args->path_checkpoint != ARGS_PATH_CHECKPOINT_DEFAULT
+          && (universe_checkpoint_sync(universe) == NULL
+              || universe_checkpoint_save(universe, args) == NULL
+              || universe_checkpoint_sync(universe) == NULL))
+      {
+        return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+      }
+      break;
+    }
+
+    /* The number of iterations left is estimated from the current timestep */
+    printf(TEXT_UNIVERSE_SIMULATE_SUCCESS, universe->iterations, universe->iterations + (uint64_t)ceil((args->max_time - universe->time)/(universe->timestep) - 1E-6), 100*(universe->time)/(args->max_time));
+    fflush(stdout);
   }
 
   printf("\n");
 
+  /* Wait for the last frames to be saved */
+  if (universe_writer_sync(universe) == NULL)
+  {
+    return (retstri(EXIT_FAILURE, TEXT_UNIVERSE_SIMULATE_FAILURE, __FILE__, __LINE__));
+  }
+
   /* End of simulation */
   puts(TEXT_SIMEND);
   universe_clean(universe);
@@ -400,144 +576,314 @@ int universe_simulate(universe_t *universe, const args_t *args)
   return (EXIT_SUCCESS);
 }
 
-universe_t *universe_iterate(universe_t *universe, const args_t *args)
+/*
+ * Update the force and acceleration vectors of every atom and, as requested
+ * (UPDATE_FRC_*), the potential energy and the virial tensor of the universe
+ * in the same pass
+ */
+universe_t *universe_update_frc(universe_t *universe, const args_t *args, const uint8_t request)
 {
-  size_t i; /* Iterator */
+  size_t i;              /* Iterator */
+  double frc_max;        /* (N2) Largest squared force */
+  uint64_t nonfinite_nb; /* Atoms whose position or force isn't finite */
+  vec3_t frc;            /* (N) Force on a single atom, whatever the r-RESPA split */
   int err = 0;
-  
-  /* We update the position vector first, as part of the Velocity-Verley integration */
-#pragma omp parallel for 
+
+  frc_max = 0.0;
+  nonfinite_nb = 0;
+#pragma omp parallel for private(frc) reduction(max:frc_max) reduction(+:nonfinite_nb)
   for (i=0; i<(universe->atom_nb); ++i)
+  {
+    /* By numerically differentiating the potential energy... */
+    if (args->numerical == MODE_NUMERICAL)
     {
-      if (atom_update_pos(universe, args, i) == NULL)
-        {
+      if (atom_update_frc_numerical(universe, i) == NULL)
+      {
 #pragma omp atomic write
-          err = 1;
-        }
+        err = 1;
+      }
     }
-  if( 0 != err )
+
+    /* By numerically differentiating the potential energy using points in a tetrahedron... */
+    else if (args->numerical == MODE_NUMERICAL_TETRA)
     {
-      return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
+      if (atom_update_frc_numerical_tetrahedron(universe, i) == NULL)
+      {
+#pragma omp atomic write
+        err = 1;
+      }
     }
-  
-  /* We enforce the periodic boundary conditions */
-#pragma omp parallel for 
-  for (i=0; i<(universe->atom_nb); ++i)
+
+    /* Or analytically solving for force */
+    else if (atom_update_frc_analytical(universe, i, request) == NULL)
     {
-      if (atom_enforce_pbc(universe, i) == NULL)
-        {
 #pragma omp atomic write
-          err = 1;
-        }
+      err = 1;
     }
-  if( 0 != err )
+
+    /* The numerical forces don't come with the potential energy */
+    if (args->numerical != MODE_ANALYTICAL && (request & UPDATE_FRC_POTENTIAL))
     {
-      return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
+      if (potential_total(&(universe->atom[i].pot), universe, i) == NULL)
+      {
+#pragma omp atomic write
+        err = 1;
+      }
     }
-  /* Update the force vectors */
-  /* By numerically differentiating the potential energy... */
-  if (args->numerical == MODE_NUMERICAL)
+
+    /* Update the acceleration vector */
+    if (atom_update_acc(universe, i) == NULL)
     {
-#pragma omp parallel for
-      for (i=0; i<(universe->atom_nb); ++i)
-        {
-          if (atom_update_frc_numerical(universe, i) == NULL)
-            {
 #pragma omp atomic write
-              err = 1;
-            }
-        }
+      err = 1;
     }
-  if( 0 != err )
+
+    /* Look for the signs of a blow-up while the atom is at hand */
+    if (request & UPDATE_FRC_WATCHDOG)
     {
-      return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
+      vec3_add(&frc, &(universe->atom[i].frc), &(universe->atom[i].frc_slow));
+      if (!isfinite(vec3_dot(&frc, &frc)) || !isfinite(vec3_dot(&(universe->atom[i].pos), &(universe->atom[i].pos))))
+      {
+        ++nonfinite_nb;
+      }
+      else
+      {
+        frc_max = fmax(frc_max, vec3_dot(&frc, &frc));
+      }
     }
-  /* By numerically differentiating the potential energy using points in a tetrahedron... */
-  if (args->numerical == MODE_NUMERICAL_TETRA)
+  }
+  if (0 != err)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_UPDATE_FRC_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Only the potential energy of every force is the one at the current positions */
+  universe->potential_fresh = ((request & UPDATE_FRC_POTENTIAL) && !(request & UPDATE_FRC_FAST));
+
+  /* Sum the atoms' shares */
+  if (request & UPDATE_FRC_POTENTIAL)
+  {
+    universe->potential = 0.0;
+    for (i=0; i<(universe->atom_nb); ++i)
     {
-#pragma omp parallel for
-      for (i=0; i<(universe->atom_nb); ++i)
-        {
-          if (atom_update_frc_numerical_tetrahedron(universe, i) == NULL)
-            {
-#pragma omp atomic write
-              err = 1;
-            }
-        }
-      if( 0 != err )
-          {
-            return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
-          }
+      universe->potential += universe->atom[i].pot;
     }
-  
-  /* Or analytically solving for force */
-  else
+  }
+
+  if (request & UPDATE_FRC_VIRIAL)
+  {
+    mat3_zero(&(universe->virial));
+    for (i=0; i<(universe->atom_nb); ++i)
     {
-#pragma omp parallel for
-      for (i=0; i<(universe->atom_nb); ++i)
-        {
-          if (atom_update_frc_analytical(universe, i) == NULL)
-            {
-#pragma omp atomic write
-              err = 1;
-            }
-        }
-      if( 0 != err )
-        {
-          return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
-        }
+      mat3_add(&(universe->virial), &(universe->virial), &(universe->atom[i].vir));
     }
-  
-  /* Update the acceleration vectors */
-#pragma omp parallel for
+  }
+
+  if (request & UPDATE_FRC_WATCHDOG)
+  {
+    universe->watchdog.sampled = 1;
+    universe->watchdog.frc_max = sqrt(frc_max);
+    universe->watchdog.nonfinite_nb = nonfinite_nb;
+  }
+
+  return (universe);
+}
+
+/* Velocity-Verlet integration (kick-drift-kick)
+ *
+ * The acceleration left by the previous step is used for the first half kick,
+ * so the forces only need to be computed once per step.
+ * With a Langevin friction, the drift is split around a thermostat step,
+ * which gives the BAOAB scheme of Leimkuhler & Matthews (2013).
+ * With a Nose-Hoover chain, the first half kick applies the velocity scaling
+ * the chain left, and the second one sums the kinetic energy the chain needs.
+ * With r-RESPA (Tuckerman, Berne & Martyna, 1992), each step is an inner one
+ * driven by the bonded forces, and the nonbonded forces only kick the atoms
+ * at the edges of each group of args->respa steps.
+ */
+universe_t *universe_iterate(universe_t *universe, const args_t *args)
+{
+  size_t i;       /* Iterator */
+  double ek;      /* (J) Kinetic energy after the last half kick */
+  double ek_atom; /* (J) Kinetic energy of a single atom */
+  double vel_max; /* (m2.s-2) Largest squared velocity after the last half kick */
+  double acc_max; /* (m2.s-4) Largest squared acceleration after the last force update */
+  uint8_t outer_start; /* Whether this step opens an outer step */
+  uint8_t outer_end;   /* Whether this step closes an outer step */
+  uint8_t request;     /* What the force update has to compute */
+  int err = 0;
+
+  outer_start = (universe->iterations % args->respa == 0);
+  outer_end = (universe->iterations % args->respa == args->respa - 1);
+
+  /* Half kick with the previous acceleration, then drift with the half-step velocity */
+#pragma omp parallel for schedule(static) private(ek_atom)
   for (i=0; i<(universe->atom_nb); ++i)
   {
-    if (atom_update_acc(universe, i) == NULL)
+    /* The constraint solvers start from the positions before the drift */
+    if (universe->constraint_ref != NULL)
+    {
+      universe->constraint_ref[i] = universe->atom[i].pos;
+    }
+
+    if (atom_update_vel(universe, i, universe->nhc.scale, &ek_atom) == NULL)
     {
 #pragma omp atomic write
-        err = 1;
+      err = 1;
     }
-  }
-  if( 0 != err )
+
+    /* The nonbonded forces only kick the atoms when an outer step opens */
+    else if (args->respa > 1 && outer_start && atom_update_vel_slow(universe, args, i) == NULL)
     {
-      return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
+#pragma omp atomic write
+      err = 1;
     }
-  /* Update the speed vectors */
-#pragma omp parallel for
+
+    /* The thermostat needs the random stream of the calling thread */
+    else if ((args->langevin > 0.0 ? atom_update_langevin(universe, args, i, &(universe->rng[omp_get_thread_num()]))
+                                   : atom_update_pos(universe, i)) == NULL)
+    {
+#pragma omp atomic write
+      err = 1;
+    }
+
+    /* We enforce the periodic boundary conditions */
+    else if (atom_enforce_pbc(universe, i) == NULL)
+    {
+#pragma omp atomic write
+      err = 1;
+    }
+  }
+  if (0 != err)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  universe->nhc.scale = NHC_SCALE_DEFAULT;
+
+  /* Bring the atoms back onto the constraints */
+  if (universe->constraint_ref != NULL && universe_constrain_pos(universe) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Update the force and acceleration vectors at the new positions, along with the virial the barostat needs */
+  request = (args->berendsen > 0.0) ? UPDATE_FRC_VIRIAL : 0;
+  if (args->respa > 1)
+  {
+    request |= outer_end ? UPDATE_FRC_SLOW : UPDATE_FRC_FAST;
+  }
+
+  /* The watchdog samples the universe when an outer step closes, as its interval is a multiple of args->respa */
+  if (args->watchdog > 0 && (universe->iterations + 1) % args->watchdog == 0)
+  {
+    request |= UPDATE_FRC_POTENTIAL | UPDATE_FRC_WATCHDOG;
+  }
+
+  /* An energy stream saving the next step needs its potential energy */
+  if (universe->stream_nb > 0
+      && universe_streams_due(universe, args, universe->iterations + 1, universe->time + universe->timestep, OUTPUT_FORMAT_ENERGY))
+  {
+    request |= UPDATE_FRC_POTENTIAL;
+  }
+
+  if (universe_update_frc(universe, args, request) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Half kick with the new acceleration, preceded by the nonbonded one when an outer step closes */
+  ek = 0.0;
+  vel_max = 0.0;
+  acc_max = 0.0;
+#pragma omp parallel for private(ek_atom) reduction(+:ek) reduction(max:vel_max,acc_max)
   for (i=0; i<(universe->atom_nb); ++i)
   {
-    if (atom_update_vel(universe, args, i) == NULL)
+    if (args->respa > 1 && outer_end && atom_update_vel_slow(universe, args, i) == NULL)
     {
 #pragma omp atomic write
-        err = 1;
+      err = 1;
+    }
+
+    else if (atom_update_vel(universe, i, NHC_SCALE_DEFAULT, &ek_atom) == NULL)
+    {
+#pragma omp atomic write
+      err = 1;
     }
+    ek += ek_atom;
+
+    /* The adaptive timestep is picked from the fastest atoms */
+    vel_max = fmax(vel_max, vec3_dot(&(universe->atom[i].vel), &(universe->atom[i].vel)));
+    acc_max = fmax(acc_max, vec3_dot(&(universe->atom[i].acc), &(universe->atom[i].acc)));
+  }
+  if (0 != err)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
   }
-  if( 0 != err )
+
+  /* The constraints take some of the kinetic energy back */
+  if (universe->constraint_ref != NULL)
+  {
+    if (universe_constrain_vel(universe) == NULL || universe_energy_kinetic(universe, &ek) == NULL)
     {
       return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
     }
+  }
+
+  /* Close this step's thermostat half step */
+  if (args->nose_hoover > 0.0 && universe_nhc_propagate(universe, args, ek) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Relax the volume towards the target pressure, once the virial holds every force, over the whole outer step */
+  if (args->berendsen > 0.0 && (args->respa == 1 || outer_end) && universe_barostat(universe, args, ek, (args->respa)*(universe->timestep)) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
+  }
+
+  /* Pick the next timestep, which can't change within an outer step */
+  if (args->adaptive > 0.0 && (args->respa == 1 || outer_end))
+  {
+    universe_timestep_adapt(universe, args, sqrt(vel_max), sqrt(acc_max));
+  }
+
+  /* Open the next step's thermostat half step */
+  if (args->nose_hoover > 0.0 && universe_nhc_propagate(universe, args, ek) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_ITERATE_FAILURE, __FILE__, __LINE__));
+  }
+
   return (universe);
 }
 
-/* Print the system's state to the .xyz file */
-universe_t *universe_printstate(universe_t *universe)
+/* Save the system's state to the output file, as text or as a binary frame */
+universe_t *universe_printstate(universe_t *universe, const args_t *args)
 {
-  size_t i; /* Iterator */
-
-  /* Print in the .xyz */
-  fprintf(universe->file_output, "%ld\n%ld\n", universe->atom_nb, universe->iterations);
-  for (i=0; i<(universe->atom_nb); ++i)
+  if (universe_writer_push(universe, args) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_PRINTSTATE_FAILURE, __FILE__, __LINE__));
+  }
+  if (universe->live.header != LIVE_HEADER_DEFAULT)
   {
-    fprintf(universe->file_output,
-            "%s\t%lf\t%lf\t%lf\n",
-            universe->model.entry[universe->atom[i].element].symbol,
-            universe->atom[i].pos.x*1E10,
-            universe->atom[i].pos.y*1E10,
-            universe->atom[i].pos.z*1E10);
+    universe_live_publish(universe, args);
   }
+  ++(universe->output_count);
   return (universe);
 }
 
+/* Save a frame to the output file, in the output format */
+universe_t *universe_frame_write(universe_t *universe, const args_t *args, const frame_t *state)
+{
+  if (universe->output_format != OUTPUT_FORMAT_XYZ)
+  {
+    return (universe_traj_write(universe, args, state));
+  }
+
+  /* Print in the .xyz */
+  return (universe_xyz_write(universe, state));
+}
+
 /* Compute the system's total kinetic energy */
 universe_t *universe_energy_kinetic(universe_t *universe, double *energy)
 {
@@ -548,7 +894,7 @@ universe_t *universe_energy_kinetic(universe_t *universe, double *energy)
   for (i=0; i<(universe->atom_nb); ++i)
   {
     vel = vec3_mag(&(universe->atom[i].vel));
-    *energy += 0.5 * POW2(vel) * universe->model.entry[universe->atom[i].element].mass;
+    *energy += 0.5 * POW2(vel) * universe->atom[i].mass;
   }
 
   return (universe);
@@ -635,13 +981,25 @@ universe_t *universe_parameters_print(universe_t *universe, const args_t *args)
 
   puts(TEXT_INFO_SIMULATION);
   printf(TEXT_INFO_SUBSTRATE_COPIES, universe->copy_nb);
+  printf(TEXT_INFO_SOLVENT_COPIES, universe->solvent_copy_nb);
   printf(TEXT_INFO_ATOM_NB, universe->atom_nb);
   printf(TEXT_INFO_TEMPERATURE, universe->temperature);
+  printf(TEXT_INFO_LANGEVIN, args->langevin/1E12);
+  printf(TEXT_INFO_HMR, args->hmr/C_DALTON);
+  printf(TEXT_INFO_NOSE_HOOVER, args->nose_hoover/1E-12);
+  printf(TEXT_INFO_BERENDSEN, args->berendsen/1E-12);
+  printf(TEXT_INFO_RESPA, args->respa);
   printf(TEXT_INFO_PRESSURE, args->pressure/1E2);
   printf(TEXT_INFO_DENSITY, args->density/1E3);
+  printf(TEXT_INFO_SOLVENT_DENSITY, args->solvent_density/1E3);
   printf(TEXT_INFO_UNIVERSE_SIZE, universe->size);
   printf(TEXT_INFO_SIMULATION_TIME, args->max_time);
   printf(TEXT_INFO_TIMESTEP, args->timestep);
+  printf(TEXT_INFO_ADAPTIVE, args->adaptive/1E-10);
+  printf(TEXT_INFO_WATCHDOG, args->watchdog);
+  printf(TEXT_INFO_CHECKPOINT, (args->path_checkpoint == ARGS_PATH_CHECKPOINT_DEFAULT) ? 0 : args->checkpoint_interval);
+  printf(TEXT_INFO_MAX_WALLTIME, args->max_walltime);
+  printf(TEXT_INFO_STREAMS, args->stream_nb);
   printf(TEXT_INFO_FRAMESKIP, args->frameskip);
   printf(TEXT_INFO_ITERATIONS, (long)floor(args->max_time/args->timestep));
 
@@ -5,11 +5,30 @@
  *
  */
 
+#include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "util.h"
 
+/* Hashes data with the 64-bit FNV-1a function */
+uint64_t fnv1a(uint64_t hash, const void *data, const size_t len)
+{
+  size_t i;
+  const unsigned char *byte;
+
+  byte = data;
+  for (i=0; i<len; ++i)
+  {
+    hash ^= byte[i];
+    hash *= FNV1A_PRIME;
+  }
+
+  return (hash);
+}
+
 /* Prints str, with extra info (__FILE__ and __LINE__) before returning ret */
 void *retstr(void *ret, const char *str, const char *file, const int line)
 {
@@ -72,3 +91,48 @@ uint64_t line_nb(const char *str)
 
   return (count);
 }
+
+/*
+ * Writes path through fill(file, data), to path.<pid> first, then moves it
+ * in place once complete and on disk.
+ * Several processes may replace the same path at once: each writes its own
+ * file, and the last one moved in place wins.
+ */
+int file_replace(const char *path, int (*fill)(FILE *file, const void *data), const void *data)
+{
+  char *path_tmp;
+  FILE *file;
+  size_t len;
+
+  len = strlen(path) + 1 + 20 + 1;
+  if ((path_tmp = malloc(len)) == NULL)
+  {
+    return (-1);
+  }
+  snprintf(path_tmp, len, "%s.%ld", path, (long)getpid());
+
+  if ((file = fopen(path_tmp, "wb")) == NULL)
+  {
+    free(path_tmp);
+    return (-1);
+  }
+
+  if (fill(file, data))
+  {
+    fclose(file);
+    remove(path_tmp);
+    free(path_tmp);
+    return (-1);
+  }
+
+  /* A partially written file would be worse than none */
+  if (fflush(file) || fsync(fileno(file)) || fclose(file) || rename(path_tmp, path))
+  {
+    remove(path_tmp);
+    free(path_tmp);
+    return (-1);
+  }
+
+  free(path_tmp);
+  return (0);
+}
@@ -60,9 +60,13 @@ vec3_t *vec3_div(vec3_t *dest, const vec3_t *v, const double lambda)
 /* dest = v1^v2 */
 vec3_t *vec3_cross(vec3_t *dest, const vec3_t *v1, const vec3_t *v2)
 {
-  dest->x = (v1->y * v2->z) - (v1->z * v2->y);
-  dest->y = (v1->z * v2->x) - (v1->x * v2->z);
-  dest->z = (v1->x * v2->y) - (v1->y * v2->x);
+  vec3_t u;
+
+  /* dest may be one of the operands */
+  u.x = (v1->y * v2->z) - (v1->z * v2->y);
+  u.y = (v1->z * v2->x) - (v1->x * v2->z);
+  u.z = (v1->x * v2->y) - (v1->y * v2->x);
+  *dest = u;
 
   return (dest);
 }
@@ -127,15 +131,64 @@ double vec3_mag(const vec3_t *v)
 }
 
 
+/* Sets every element of the matrix to zero */
+mat3_t *mat3_zero(mat3_t *m)
+{
+  m->x0 = 0.0;
+  m->x1 = 0.0;
+  m->x2 = 0.0;
+  m->y0 = 0.0;
+  m->y1 = 0.0;
+  m->y2 = 0.0;
+  m->z0 = 0.0;
+  m->z1 = 0.0;
+  m->z2 = 0.0;
+
+  return (m);
+}
+
+/* Adds two matrices */
+mat3_t *mat3_add(mat3_t *dest, const mat3_t *m1, const mat3_t *m2)
+{
+  dest->x0 = m1->x0 + m2->x0;
+  dest->x1 = m1->x1 + m2->x1;
+  dest->x2 = m1->x2 + m2->x2;
+  dest->y0 = m1->y0 + m2->y0;
+  dest->y1 = m1->y1 + m2->y1;
+  dest->y2 = m1->y2 + m2->y2;
+  dest->z0 = m1->z0 + m2->z0;
+  dest->z1 = m1->z1 + m2->z1;
+  dest->z2 = m1->z2 + m2->z2;
+
+  return (dest);
+}
 
+/* Adds weight times the outer product of two vectors, as dest_ij += weight*u_i*v_j */
+mat3_t *mat3_add_outer(mat3_t *dest, const vec3_t *u, const vec3_t *v, const double weight)
+{
+  dest->x0 += weight*(u->x)*(v->x);
+  dest->y0 += weight*(u->x)*(v->y);
+  dest->z0 += weight*(u->x)*(v->z);
+  dest->x1 += weight*(u->y)*(v->x);
+  dest->y1 += weight*(u->y)*(v->y);
+  dest->z1 += weight*(u->y)*(v->z);
+  dest->x2 += weight*(u->z)*(v->x);
+  dest->y2 += weight*(u->z)*(v->y);
+  dest->z2 += weight*(u->z)*(v->z);
 
+  return (dest);
+}
 
 /* Apply a transformation matrix to a vector */
 mat3_t *mat3_transform_apply(mat3_t *m, vec3_t *v)
 {
-  v->x = ((m->x0)*(v->x)) + ((m->y0)*(v->y)) + ((m->z0)*(v->z));
-  v->y = ((m->x1)*(v->x)) + ((m->y1)*(v->y)) + ((m->z1)*(v->z));
-  v->z = ((m->x2)*(v->x)) + ((m->y2)*(v->y)) + ((m->z2)*(v->z));
+  vec3_t u;
+
+  /* Work on a copy, every component of the result depends on the whole vector */
+  u = *v;
+  v->x = ((m->x0)*(u.x)) + ((m->y0)*(u.y)) + ((m->z0)*(u.z));
+  v->y = ((m->x1)*(u.x)) + ((m->y1)*(u.y)) + ((m->z1)*(u.z));
+  v->z = ((m->x2)*(u.x)) + ((m->y2)*(u.y)) + ((m->z2)*(u.z));
 
   return (m);
 }
@@ -148,8 +201,8 @@ mat3_t *mat3_transform_gen_rot(mat3_t *m, vec3_t *axis, const double angle)
   m->x2=(((axis->x) * (axis->z)) * (1-cos(angle))) - ((axis->y)*sin(angle));
 
   m->y0=(((axis->y) * (axis->x)) * (1-cos(angle))) - ((axis->z)*sin(angle));
-  m->x1=(((axis->y) * (axis->y)) * (1-cos(angle))) +            cos(angle);
-  m->x2=(((axis->y) * (axis->z)) * (1-cos(angle))) + ((axis->x)*sin(angle));
+  m->y1=(((axis->y) * (axis->y)) * (1-cos(angle))) +            cos(angle);
+  m->y2=(((axis->y) * (axis->z)) * (1-cos(angle))) + ((axis->x)*sin(angle));
 
   m->z0=(((axis->z) * (axis->x)) * (1-cos(angle))) + ((axis->y)*sin(angle));
   m->z1=(((axis->z) * (axis->y)) * (1-cos(angle))) - ((axis->x)*sin(angle));
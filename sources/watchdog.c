@@ -0,0 +1,224 @@
+/*
+ * watchdog.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "config.h"
+#include "args.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+
+/*
+ * A run that blows up first shows huge forces, then positions and forces that
+ * aren't finite anymore. Every args->watchdog steps, the force update of the
+ * closing step finds the largest force and counts the atoms that went wrong
+ * as it goes (UPDATE_FRC_WATCHDOG), along with the potential energy, so the
+ * watchdog itself only has to compare the total energy with the last good
+ * sample's.
+ * With --rollback, a run that went wrong is taken back to the last good
+ * sample with half the timestep, and the frames saved since are cut off the
+ * output file, once the writer is done with them, and off the streams' files.
+ *
+ */
+
+/* Save everything a step changes */
+static universe_t *watchdog_snapshot(universe_t *universe, const args_t *args)
+{
+  watchdog_t *watchdog;
+
+  watchdog = &(universe->watchdog);
+
+  memcpy(watchdog->atom, universe->atom, sizeof(atom_t)*(universe->atom_nb));
+  if (args->langevin > 0.0)
+  {
+    memcpy(watchdog->rng, universe->rng, sizeof(rng_t)*omp_get_max_threads());
+  }
+
+  watchdog->nhc = universe->nhc;
+  watchdog->iterations = universe->iterations;
+  watchdog->size = universe->size;
+  watchdog->time = universe->time;
+  watchdog->timestep = universe->timestep;
+  watchdog->frame_time = universe->frame_time;
+  watchdog->potential = universe->potential;
+  watchdog->virial = universe->virial;
+  watchdog->output_count = universe->output_count;
+
+  /* The frames saved after this one may have to be cut off */
+  if (universe_writer_sync(universe) == NULL
+      || fflush(universe->file_output) || (watchdog->output_pos = ftell(universe->file_output)) < 0
+      || (universe->stream_nb > 0 && universe_streams_mark(universe, watchdog->stream) == NULL))
+  {
+    return (NULL);
+  }
+
+  return (universe);
+}
+
+/* Take the universe back to the snapshot */
+static universe_t *watchdog_restore(universe_t *universe, const args_t *args)
+{
+  watchdog_t *watchdog;
+
+  watchdog = &(universe->watchdog);
+
+  /* The writer must be done with the frames before they are cut off */
+  if (universe_writer_sync(universe) == NULL)
+  {
+    return (NULL);
+  }
+
+  memcpy(universe->atom, watchdog->atom, sizeof(atom_t)*(universe->atom_nb));
+  if (args->langevin > 0.0)
+  {
+    memcpy(universe->rng, watchdog->rng, sizeof(rng_t)*omp_get_max_threads());
+  }
+
+  universe->nhc = watchdog->nhc;
+  universe->iterations = watchdog->iterations;
+  universe->size = watchdog->size;
+  universe->time = watchdog->time;
+  universe->timestep = watchdog->timestep;
+  universe->frame_time = watchdog->frame_time;
+  universe->potential = watchdog->potential;
+  universe->potential_fresh = 0;
+  universe->virial = watchdog->virial;
+  universe->output_count = watchdog->output_count;
+
+  /* The compressed frames the next one would be coded against are cut off */
+  universe->output_frame_nb = 0;
+
+  if (fflush(universe->file_output)
+      || ftruncate(fileno(universe->file_output), watchdog->output_pos)
+      || fseek(universe->file_output, watchdog->output_pos, SEEK_SET)
+      || (universe->stream_nb > 0 && universe_streams_rewind(universe, watchdog->stream) == NULL))
+  {
+    return (NULL);
+  }
+
+  return (universe);
+}
+
+/* Check the starting state, and take the first snapshot */
+universe_t *universe_watchdog_init(universe_t *universe, const args_t *args)
+{
+  watchdog_t *watchdog;
+
+  watchdog = &(universe->watchdog);
+
+  /* The starting forces were sampled, but may be huge until the universe settles */
+  watchdog->sampled = 0;
+  if (watchdog->nonfinite_nb > 0)
+  {
+    printf(TEXT_UNIVERSE_WATCHDOG_TRIGGERED, universe->iterations, universe->time, watchdog->nonfinite_nb, watchdog->frc_max, 0.0, 0.0);
+    return (retstr(NULL, TEXT_UNIVERSE_WATCHDOG_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (universe_energy_kinetic(universe, &(watchdog->ek)) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_WATCHDOG_INIT_FAILURE, __FILE__, __LINE__));
+  }
+  watchdog->energy = watchdog->ek + 0.5*(universe->potential);
+
+  /* Only a rollback needs the snapshot */
+  if (!(args->rollback))
+  {
+    return (universe);
+  }
+
+  if ((watchdog->atom = malloc(sizeof(atom_t)*(universe->atom_nb))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_WATCHDOG_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (args->langevin > 0.0 && (watchdog->rng = malloc(sizeof(rng_t)*omp_get_max_threads())) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_WATCHDOG_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (universe->stream_nb > 0 && (watchdog->stream = malloc(sizeof(stream_mark_t)*(universe->stream_nb))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_WATCHDOG_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (watchdog_snapshot(universe, args) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_WATCHDOG_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
+
+/*
+ * Check the sample the last force update took. The universe is returned as is
+ * if it looks sane, and taken back to the last good sample if it doesn't and
+ * a rollback is allowed. Otherwise, NULL is returned.
+ */
+universe_t *universe_watchdog_check(universe_t *universe, const args_t *args)
+{
+  watchdog_t *watchdog;
+  double ek;       /* (J) Kinetic energy */
+  double energy;   /* (J) Total energy */
+  double drift;    /* (J) Change of the total energy since the last good sample */
+  double timestep; /* (s) Timestep that let the universe blow up */
+
+  watchdog = &(universe->watchdog);
+  watchdog->sampled = 0;
+
+  if (universe_energy_kinetic(universe, &ek) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_WATCHDOG_CHECK_FAILURE, __FILE__, __LINE__));
+  }
+  energy = ek + 0.5*(universe->potential);
+  drift = energy - watchdog->energy;
+
+  /*
+   * The thermostats and the barostat exchange energy with the outside, so the
+   * drift is only held against the kinetic energy, which a blow-up dwarfs
+   */
+  if (watchdog->nonfinite_nb == 0 && isfinite(energy)
+      && watchdog->frc_max < WATCHDOG_FRC_MAX
+      && fabs(drift) <= WATCHDOG_DRIFT_MAX*fmax(ek, watchdog->ek))
+  {
+    watchdog->energy = energy;
+    watchdog->ek = ek;
+
+    if (args->rollback && watchdog_snapshot(universe, args) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_WATCHDOG_CHECK_FAILURE, __FILE__, __LINE__));
+    }
+
+    return (universe);
+  }
+
+  printf("\n");
+  printf(TEXT_UNIVERSE_WATCHDOG_TRIGGERED, universe->iterations, universe->time, watchdog->nonfinite_nb, watchdog->frc_max, drift, ek);
+
+  /* Try again from the last good sample, with half the timestep, unless it's already too small */
+  timestep = fmin(universe->timestep, watchdog->timestep);
+  if (!(args->rollback) || 0.5*timestep < ldexp(args->timestep, -(int)WATCHDOG_ROLLBACK_MAX))
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_WATCHDOG_CHECK_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (watchdog_restore(universe, args) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_WATCHDOG_CHECK_FAILURE, __FILE__, __LINE__));
+  }
+  universe->timestep = 0.5*timestep;
+
+  printf(TEXT_UNIVERSE_WATCHDOG_ROLLBACK, universe->iterations, universe->time, universe->timestep);
+
+  return (universe);
+}
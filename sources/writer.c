@@ -0,0 +1,235 @@
+/*
+ * writer.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <omp.h>
+
+#include "config.h"
+#include "args.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+#include "vec3.h"
+
+/*
+ * The simulation copies each frame into the slot at head, and the writer saves
+ * the one at tail, both counters only growing. A slot is free again once its
+ * frame is saved, so the simulation never touches a frame being written, and
+ * the writer never touches a frame being copied. Only the counters are shared,
+ * under the mutex. A checkpoint being saved waits for the writer too, so every
+ * frame saved wakes up whoever waits.
+ *
+ */
+
+/* Save the frames of the ring as they come, until told to stop */
+static void *writer_main(void *data)
+{
+  universe_t *universe;
+  writer_t *writer;
+  frame_t *state;
+
+  universe = (universe_t*)data;
+  writer = &(universe->writer);
+
+  /* The simulation's threads are busy, so the frames are saved by this one alone */
+  omp_set_num_threads(1);
+
+  pthread_mutex_lock(&(writer->mutex));
+  while (1)
+  {
+    while (writer->tail == writer->head && !(writer->stop))
+    {
+      pthread_cond_wait(&(writer->filled), &(writer->mutex));
+    }
+
+    /* Only stop once every frame is saved */
+    if (writer->tail == writer->head)
+    {
+      break;
+    }
+
+    state = &(writer->slot[writer->tail % writer->slot_nb]);
+    pthread_mutex_unlock(&(writer->mutex));
+
+    if (universe_frame_write(universe, writer->args, state) == NULL)
+    {
+      pthread_mutex_lock(&(writer->mutex));
+      writer->err = 1;
+      pthread_cond_broadcast(&(writer->freed));
+      break;
+    }
+
+    pthread_mutex_lock(&(writer->mutex));
+    ++(writer->tail);
+    pthread_cond_broadcast(&(writer->freed));
+  }
+  pthread_mutex_unlock(&(writer->mutex));
+
+  return (NULL);
+}
+
+/* Allocate the ring, and start the writer with --async */
+universe_t *universe_writer_init(universe_t *universe, const args_t *args)
+{
+  writer_t *writer;
+  size_t i; /* Iterator */
+
+  writer = &(universe->writer);
+  writer->args = args;
+  writer->slot_nb = (args->async) ? WRITER_SLOT_NB : 1;
+
+  if ((writer->slot = calloc(writer->slot_nb, sizeof(frame_t))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_WRITER_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  for (i=0; i<(writer->slot_nb); ++i)
+  {
+    if ((writer->slot[i].pos = malloc(sizeof(vec3_t)*(universe->atom_nb))) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_WRITER_INIT_FAILURE, __FILE__, __LINE__));
+    }
+  }
+
+  if (pthread_mutex_init(&(writer->mutex), NULL)
+      || pthread_cond_init(&(writer->filled), NULL)
+      || pthread_cond_init(&(writer->freed), NULL))
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_WRITER_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  if (args->async)
+  {
+    if (pthread_create(&(writer->thread), NULL, writer_main, universe))
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_WRITER_INIT_FAILURE, __FILE__, __LINE__));
+    }
+    writer->running = 1;
+  }
+
+  return (universe);
+}
+
+/* Copy the current state into the ring, waiting for a free slot if needed */
+universe_t *universe_writer_push(universe_t *universe, const args_t *args)
+{
+  writer_t *writer;
+  frame_t *state;
+  size_t i; /* Iterator */
+
+  writer = &(universe->writer);
+
+  pthread_mutex_lock(&(writer->mutex));
+  while (writer->head - writer->tail == writer->slot_nb && !(writer->err))
+  {
+    pthread_cond_wait(&(writer->freed), &(writer->mutex));
+  }
+  if (writer->err)
+  {
+    pthread_mutex_unlock(&(writer->mutex));
+    return (retstr(NULL, TEXT_UNIVERSE_WRITER_PUSH_FAILURE, __FILE__, __LINE__));
+  }
+  pthread_mutex_unlock(&(writer->mutex));
+
+  /* The positions are spread over the atoms, so they are gathered one by one */
+  state = &(writer->slot[writer->head % writer->slot_nb]);
+  state->iterations = universe->iterations;
+  state->time = universe->time;
+  state->size = universe->size;
+#pragma omp parallel for
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    state->pos[i] = universe->atom[i].pos;
+  }
+
+  /* Without a writer, the frame is saved at once */
+  if (!(writer->running))
+  {
+    if (universe_frame_write(universe, args, state) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_WRITER_PUSH_FAILURE, __FILE__, __LINE__));
+    }
+    return (universe);
+  }
+
+  pthread_mutex_lock(&(writer->mutex));
+  ++(writer->head);
+  pthread_cond_signal(&(writer->filled));
+  pthread_mutex_unlock(&(writer->mutex));
+
+  return (universe);
+}
+
+/* Wait for every frame of the ring to be saved */
+universe_t *universe_writer_sync(universe_t *universe)
+{
+  writer_t *writer;
+  uint8_t err;
+
+  writer = &(universe->writer);
+
+  if (!(writer->running))
+  {
+    return (universe);
+  }
+
+  pthread_mutex_lock(&(writer->mutex));
+  while (writer->tail != writer->head && !(writer->err))
+  {
+    pthread_cond_wait(&(writer->freed), &(writer->mutex));
+  }
+  err = writer->err;
+  pthread_mutex_unlock(&(writer->mutex));
+
+  if (err)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_WRITER_SYNC_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
+
+/* Stop the writer once the ring is empty, and free the ring */
+universe_t *universe_writer_clean(universe_t *universe)
+{
+  writer_t *writer;
+  size_t i; /* Iterator */
+
+  writer = &(universe->writer);
+
+  if (writer->slot == NULL)
+  {
+    return (universe);
+  }
+
+  if (writer->running)
+  {
+    pthread_mutex_lock(&(writer->mutex));
+    writer->stop = 1;
+    pthread_cond_signal(&(writer->filled));
+    pthread_mutex_unlock(&(writer->mutex));
+
+    pthread_join(writer->thread, NULL);
+    writer->running = 0;
+  }
+
+  pthread_mutex_destroy(&(writer->mutex));
+  pthread_cond_destroy(&(writer->filled));
+  pthread_cond_destroy(&(writer->freed));
+
+  for (i=0; i<(writer->slot_nb); ++i)
+  {
+    free(writer->slot[i].pos);
+  }
+  free(writer->slot);
+  writer->slot = NULL;
+
+  return (universe);
+}
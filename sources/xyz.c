@@ -0,0 +1,251 @@
+/*
+ * xyz.c
+ *
+ * Licensed under GPLv3 license
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "args.h"
+#include "text.h"
+#include "universe.h"
+#include "util.h"
+
+/*
+ * A frame of the .xyz file is formatted in chunks of XYZ_CHUNK_ATOM_NB atoms,
+ * each of them in parallel into its own part of a single buffer, large enough
+ * for the longest lines. The chunks are then moved next to each other, and the
+ * frame is written with a single call.
+ * The coordinates are printed from integers, as "%lf" would: the value in
+ * millionths of Å is rounded, which gives the same digits unless it lies too
+ * close to halfway between two integers for the rounding of the product to be
+ * trusted, in which case printf decides. A frame holding a coordinate that
+ * isn't finite or is too large to be printed that way is printed entirely
+ * with printf.
+ *
+ */
+
+/* Returns the length of the longest line of a frame */
+static size_t xyz_line_max(const universe_t *universe)
+{
+  size_t i;   /* Iterator */
+  size_t len; /* Length of the longest symbol */
+
+  len = 0;
+  for (i=0; i<(universe->model.entry_nb); ++i)
+  {
+    if (strlen(universe->model.entry[i].symbol) > len)
+    {
+      len = strlen(universe->model.entry[i].symbol);
+    }
+  }
+
+  /* The symbol, then a tab and a coordinate three times, and the line break */
+  return (len + 3*(XYZ_COORD_LEN_MAX + 1) + 1);
+}
+
+/*
+ * Print a coordinate (Å) as "%lf" would, and return its length. The value has
+ * to be finite and smaller than XYZ_COORD_MAX.
+ */
+static size_t xyz_coord(char *buffer, const double value)
+{
+  double scaled;   /* Value in millionths, as rounded by the product */
+  double frac;     /* Fractional part of the scaled value */
+  uint64_t n;      /* Value in millionths, rounded */
+  uint64_t whole;  /* Integral part of the value */
+  char digits[32]; /* Integral digits from the lowest, or printf's output */
+  size_t len;
+  size_t i;        /* Iterator */
+
+  scaled = fabs(value)*1E6;
+  n = (uint64_t)scaled;
+  frac = scaled - (double)n;
+
+  /* The product was rounded by half an ulp at most, which may decide a tie */
+  if (fabs(frac - 0.5) <= ldexp(scaled, -50))
+  {
+    len = (size_t)snprintf(digits, sizeof(digits), "%lf", value);
+    memcpy(buffer, digits, len);
+    return (len);
+  }
+  if (frac > 0.5)
+  {
+    ++n;
+  }
+
+  /* printf keeps the sign of the values rounded to zero, and of -0.0 */
+  len = 0;
+  if (signbit(value))
+  {
+    buffer[len++] = '-';
+  }
+
+  whole = n/1000000;
+  n %= 1000000;
+  i = 0;
+  do
+  {
+    digits[i++] = (char)('0' + whole%10);
+    whole /= 10;
+  } while (whole > 0);
+  while (i > 0)
+  {
+    buffer[len++] = digits[--i];
+  }
+
+  buffer[len++] = '.';
+  for (i=6; i>0; --i)
+  {
+    buffer[len + i - 1] = (char)('0' + n%10);
+    n /= 10;
+  }
+
+  return (len + 6);
+}
+
+/* Print a frame with printf, whatever its coordinates */
+static universe_t *xyz_write_slow(universe_t *universe, const frame_t *state)
+{
+  size_t i; /* Iterator */
+
+  fprintf(universe->file_output, "%ld\n%ld\n", universe->atom_nb, state->iterations);
+  for (i=0; i<(universe->atom_nb); ++i)
+  {
+    fprintf(universe->file_output,
+            "%s\t%lf\t%lf\t%lf\n",
+            universe->model.entry[universe->atom[i].element].symbol,
+            state->pos[i].x*1E10,
+            state->pos[i].y*1E10,
+            state->pos[i].z*1E10);
+  }
+
+  if (ferror(universe->file_output))
+  {
+    return (NULL);
+  }
+
+  return (universe);
+}
+
+/* Allocate the buffer the frames are formatted in */
+universe_t *universe_xyz_init(universe_t *universe)
+{
+  size_t chunk_nb; /* Number of chunks in a frame */
+
+  chunk_nb = (universe->atom_nb + XYZ_CHUNK_ATOM_NB - 1)/XYZ_CHUNK_ATOM_NB;
+
+  if ((universe->output_frame = malloc(XYZ_HEADER_LEN_MAX + (universe->atom_nb)*xyz_line_max(universe))) == NULL
+      || (universe->output_chunk_len = malloc(sizeof(size_t)*(chunk_nb + 1))) == NULL)
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_XYZ_INIT_FAILURE, __FILE__, __LINE__));
+  }
+
+  return (universe);
+}
+
+/* Write a frame to the .xyz file */
+universe_t *universe_xyz_write(universe_t *universe, const frame_t *state)
+{
+  size_t c;        /* Iterator over the chunks */
+  size_t chunk_nb; /* Number of chunks in a frame */
+  size_t line_max; /* Length of the longest line */
+  size_t len;      /* Length of the frame */
+  ssize_t written;
+  char *text;
+  int slow = 0;
+
+  text = universe->output_frame;
+  line_max = xyz_line_max(universe);
+  chunk_nb = (universe->atom_nb + XYZ_CHUNK_ATOM_NB - 1)/XYZ_CHUNK_ATOM_NB;
+
+  /* Each chunk is formatted where it would start if every line were the longest */
+#pragma omp parallel for schedule(dynamic)
+  for (c=0; c<chunk_nb; ++c)
+  {
+    size_t i;
+    size_t end;
+    size_t chunk_len;
+    char *line;
+    const char *symbol;
+
+    line = text + XYZ_HEADER_LEN_MAX + c*XYZ_CHUNK_ATOM_NB*line_max;
+    end = (c + 1)*XYZ_CHUNK_ATOM_NB;
+    if (end > universe->atom_nb)
+    {
+      end = universe->atom_nb;
+    }
+
+    chunk_len = 0;
+    for (i=c*XYZ_CHUNK_ATOM_NB; i<end; ++i)
+    {
+      const double coord[3] = {state->pos[i].x*1E10, state->pos[i].y*1E10, state->pos[i].z*1E10};
+
+      if (!(fabs(coord[0]) < XYZ_COORD_MAX && fabs(coord[1]) < XYZ_COORD_MAX && fabs(coord[2]) < XYZ_COORD_MAX))
+      {
+#pragma omp atomic write
+        slow = 1;
+        break;
+      }
+
+      symbol = universe->model.entry[universe->atom[i].element].symbol;
+      memcpy(line + chunk_len, symbol, strlen(symbol));
+      chunk_len += strlen(symbol);
+      line[chunk_len++] = '\t';
+      chunk_len += xyz_coord(line + chunk_len, coord[0]);
+      line[chunk_len++] = '\t';
+      chunk_len += xyz_coord(line + chunk_len, coord[1]);
+      line[chunk_len++] = '\t';
+      chunk_len += xyz_coord(line + chunk_len, coord[2]);
+      line[chunk_len++] = '\n';
+    }
+    universe->output_chunk_len[c] = chunk_len;
+  }
+
+  if (slow)
+  {
+    if (xyz_write_slow(universe, state) == NULL)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_XYZ_WRITE_FAILURE, __FILE__, __LINE__));
+    }
+    return (universe);
+  }
+
+  /* The header goes right before the first chunk, and the others follow it */
+  len = (size_t)snprintf(text, XYZ_HEADER_LEN_MAX, "%ld\n%ld\n", universe->atom_nb, state->iterations);
+  for (c=0; c<chunk_nb; ++c)
+  {
+    memmove(text + len, text + XYZ_HEADER_LEN_MAX + c*XYZ_CHUNK_ATOM_NB*line_max, universe->output_chunk_len[c]);
+    len += universe->output_chunk_len[c];
+  }
+
+  /* Nothing else goes through the stream, which the watchdog still uses to seek */
+  if (fflush(universe->file_output))
+  {
+    return (retstr(NULL, TEXT_UNIVERSE_XYZ_WRITE_FAILURE, __FILE__, __LINE__));
+  }
+  while (len > 0)
+  {
+    written = write(fileno(universe->file_output), text, len);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written < 0)
+    {
+      return (retstr(NULL, TEXT_UNIVERSE_XYZ_WRITE_FAILURE, __FILE__, __LINE__));
+    }
+    text += written;
+    len -= (size_t)written;
+  }
+
+  return (universe);
+}
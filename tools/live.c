@@ -0,0 +1,175 @@
+/*
+ * live.c
+ *
+ * Licensed under GPLv3 license
+ *
+ * Reference reader of the frames SENPAI publishes with --live (see
+ * Documentation/sxl-format.txt). It attaches to the shared memory object,
+ * and prints each frame it gets to the standard output as an .xyz frame,
+ * until the simulation is over or enough frames were printed:
+ *   senpai_live NAME [FRAMES]
+ * Frames overwritten before they could be read are left out.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "live.h"
+
+#define LIVE_READER_POLL_NS ((long)10000000) /* Time between two looks at the head (ns) */
+
+/* Copy frame n, or return -1 if it was overwritten before it could be */
+static int live_read(const live_header_t *header, const uint64_t n, live_slot_t *frame, void *coord)
+{
+  const live_slot_t *slot;
+  uint64_t sequence;
+
+  slot = LIVE_SLOT(header, n);
+
+  sequence = __atomic_load_n(&(slot->sequence), __ATOMIC_ACQUIRE);
+  if (sequence != 2*n + 2)
+  {
+    return (-1);
+  }
+
+  memcpy(frame, slot, sizeof(live_slot_t));
+  memcpy(coord, slot + 1, 3*(header->atom_nb)*(header->coord_size));
+
+  /* The frame is whole if the slot wasn't touched while it was copied */
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&(slot->sequence), __ATOMIC_RELAXED) != sequence)
+  {
+    return (-1);
+  }
+
+  return (0);
+}
+
+/* Print a frame as an .xyz frame */
+static void live_print(const live_header_t *header, const live_slot_t *frame, const void *coord)
+{
+  const char *symbol;
+  const uint32_t *element;
+  size_t i;
+  double x;
+  double y;
+  double z;
+
+  symbol = (const char*)header + sizeof(live_header_t);
+  element = (const uint32_t*)(symbol + (TRAJ_SYMBOL_LEN*(header->entry_nb) + 7)/8*8);
+
+  printf("%ld\n%ld\n", header->atom_nb, frame->iterations);
+  for (i=0; i<(header->atom_nb); ++i)
+  {
+    if (header->coord_size == sizeof(double))
+    {
+      x = ((const double*)coord)[3*i];
+      y = ((const double*)coord)[3*i+1];
+      z = ((const double*)coord)[3*i+2];
+    }
+    else
+    {
+      x = ((const float*)coord)[3*i];
+      y = ((const float*)coord)[3*i+1];
+      z = ((const float*)coord)[3*i+2];
+    }
+    printf("%.*s\t%lf\t%lf\t%lf\n", (int)TRAJ_SYMBOL_LEN, symbol + TRAJ_SYMBOL_LEN*element[i], x, y, z);
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+  const struct timespec poll = {0, LIVE_READER_POLL_NS};
+  struct stat st;
+  live_header_t *header;
+  live_slot_t frame;
+  void *coord;
+  uint64_t next;   /* Next frame to print */
+  uint64_t head;   /* Frames published so far */
+  uint64_t printed;
+  uint64_t max;    /* Frames to print, 0 for all of them */
+  int fd;
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: %s NAME [FRAMES]\n", argv[0]);
+    return (EXIT_FAILURE);
+  }
+  max = (argc > 2) ? strtoull(argv[2], NULL, 10) : 0;
+
+  if ((fd = shm_open(argv[1], O_RDONLY, 0)) < 0 || fstat(fd, &st) || (size_t)st.st_size < sizeof(live_header_t))
+  {
+    fprintf(stderr, "%s: Failed to open the shared memory object %s\n", argv[0], argv[1]);
+    return (EXIT_FAILURE);
+  }
+  if ((header = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    fprintf(stderr, "%s: Failed to map the shared memory object %s\n", argv[0], argv[1]);
+    return (EXIT_FAILURE);
+  }
+  close(fd);
+
+  /* The simulation writes the magic once everything else is there */
+  while (memcmp(header->magic, LIVE_MAGIC, sizeof(LIVE_MAGIC)))
+  {
+    nanosleep(&poll, NULL);
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+  if (header->version != LIVE_VERSION
+      || header->byte_order != 0x0102030405060708
+      || header->slot_offset + (header->slot_nb)*(header->slot_size) > (uint64_t)st.st_size
+      || (coord = malloc(3*(header->atom_nb)*(header->coord_size))) == NULL)
+  {
+    fprintf(stderr, "%s: %s wasn't published by this version of SENPAI\n", argv[0], argv[1]);
+    return (EXIT_FAILURE);
+  }
+
+  /* Start from the last whole frame */
+  head = __atomic_load_n(&(header->head), __ATOMIC_ACQUIRE);
+  next = (head > 0) ? head - 1 : 0;
+  printed = 0;
+
+  while (max == 0 || printed < max)
+  {
+    head = __atomic_load_n(&(header->head), __ATOMIC_ACQUIRE);
+
+    if (next == head)
+    {
+      if (__atomic_load_n(&(header->ended), __ATOMIC_ACQUIRE))
+      {
+        break;
+      }
+      nanosleep(&poll, NULL);
+      continue;
+    }
+
+    /* The frames the ring no longer holds are left out */
+    if (head - next > header->slot_nb)
+    {
+      next = head - header->slot_nb;
+    }
+
+    if (live_read(header, next, &frame, coord) == 0)
+    {
+      live_print(header, &frame, coord);
+      ++printed;
+    }
+    ++next;
+  }
+
+  free(coord);
+  munmap(header, (size_t)st.st_size);
+
+  return (EXIT_SUCCESS);
+}